@@ -0,0 +1,288 @@
+#include "AssetPack.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vks {
+
+// a match length byte of 255 is the densest LZ4 gets, tokens, offsets and literals all expand less
+const uint64_t kMaxLZ4ExpansionRatio = 255;
+
+AssetPack::~AssetPack() {
+  Close();
+}
+
+bool AssetPack::Open(const std::string &path) {
+
+  Close();
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr) {
+    CloseHandle(file);
+    return false;
+  }
+
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (view == nullptr) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+
+  fileHandle_ = file;
+  mappingHandle_ = mapping;
+  mappedData_ = static_cast<const char*>(view);
+  mappedSize_ = static_cast<size_t>(fileSize.QuadPart);
+#else
+  int file = open(path.c_str(), O_RDONLY);
+  if (file < 0) {
+    return false;
+  }
+
+  struct stat fileStat;
+  if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0) {
+    close(file);
+    return false;
+  }
+
+  void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+  // the mapping keeps the file alive
+  close(file);
+
+  if (view == MAP_FAILED) {
+    return false;
+  }
+
+  mappedData_ = static_cast<const char*>(view);
+  mappedSize_ = static_cast<size_t>(fileStat.st_size);
+#endif
+
+  if (!validate()) {
+    Close();
+    return false;
+  }
+
+  decompressed_.resize(header_->entryCount);
+
+  return true;
+}
+
+void AssetPack::Close() {
+
+  if (mappedData_ != nullptr) {
+#ifdef _WIN32
+    UnmapViewOfFile(mappedData_);
+    CloseHandle(static_cast<HANDLE>(mappingHandle_));
+    CloseHandle(static_cast<HANDLE>(fileHandle_));
+    mappingHandle_ = nullptr;
+    fileHandle_ = nullptr;
+#else
+    munmap(const_cast<char*>(mappedData_), mappedSize_);
+#endif
+  }
+
+  mappedData_ = nullptr;
+  mappedSize_ = 0;
+  header_ = nullptr;
+  entries_ = nullptr;
+  nameTable_ = nullptr;
+  decompressed_.clear();
+}
+
+bool AssetPack::Find(const std::string &name, AssetView &output) {
+
+  const AssetPackEntry* entry = findEntry(name);
+  if (entry == nullptr) {
+    return false;
+  }
+
+  if (entry->compression == kAssetPackUncompressed) {
+    output.data = mappedData_ + entry->offset;
+    output.size = static_cast<size_t>(entry->size);
+    return true;
+  }
+
+  size_t index = static_cast<size_t>(entry - entries_);
+  std::lock_guard<std::mutex> lock(decompressedMutex_);
+
+  if (decompressed_[index] == nullptr) {
+
+    size_t size = static_cast<size_t>(entry->size);
+    std::unique_ptr<uint32_t[]> buffer(new (std::nothrow) uint32_t[(size + sizeof(uint32_t) - 1) / sizeof(uint32_t)]);
+    if (buffer == nullptr) {
+      return false;
+    }
+
+    if (!DecompressLZ4Block(
+      reinterpret_cast<const uint8_t*>(mappedData_ + entry->offset),
+      static_cast<size_t>(entry->storedSize),
+      reinterpret_cast<uint8_t*>(buffer.get()),
+      size)) {
+      return false;
+    }
+
+    decompressed_[index] = std::move(buffer);
+  }
+
+  output.data = decompressed_[index].get();
+  output.size = static_cast<size_t>(entry->size);
+  return true;
+}
+
+bool AssetPack::validate() {
+
+  if (mappedSize_ < sizeof(AssetPackHeader)) {
+    return false;
+  }
+
+  const AssetPackHeader* header = reinterpret_cast<const AssetPackHeader*>(mappedData_);
+  if (header->magic != kAssetPackMagic || header->version != kAssetPackVersion) {
+    return false;
+  }
+
+  // alignment has to be a power of two of at least 4 so SPIR-V can be used in place
+  if (header->alignment < 4 || (header->alignment & (header->alignment - 1)) != 0) {
+    return false;
+  }
+
+  uint64_t tocEnd = sizeof(AssetPackHeader) + uint64_t(header->entryCount) * sizeof(AssetPackEntry);
+  if (tocEnd > mappedSize_ || header->nameTableOffset < tocEnd ||
+      header->nameTableOffset > mappedSize_ || header->nameTableSize > mappedSize_ - header->nameTableOffset) {
+    return false;
+  }
+
+  const AssetPackEntry* entries = reinterpret_cast<const AssetPackEntry*>(mappedData_ + sizeof(AssetPackHeader));
+  for (uint32_t i = 0; i < header->entryCount; ++i) {
+    const AssetPackEntry &entry = entries[i];
+
+    if (entry.offset % header->alignment != 0 || entry.offset > mappedSize_ || entry.storedSize > mappedSize_ - entry.offset) {
+      return false;
+    }
+
+    if (uint64_t(entry.nameOffset) + entry.nameLength > header->nameTableSize) {
+      return false;
+    }
+
+    if (entry.compression == kAssetPackUncompressed) {
+      if (entry.storedSize != entry.size) return false;
+    }
+    else if (entry.compression == kAssetPackLZ4Block) {
+      // every LZ4 input byte produces at most 255 output bytes, anything claiming more is corrupt and would have
+      // Find allocate whatever size the entry says
+      if (entry.size > entry.storedSize * kMaxLZ4ExpansionRatio) return false;
+    }
+    else {
+      return false;
+    }
+  }
+
+  header_ = header;
+  entries_ = entries;
+  nameTable_ = mappedData_ + header->nameTableOffset;
+
+  return true;
+}
+
+const AssetPackEntry* AssetPack::findEntry(const std::string &name) const {
+
+  if (entries_ == nullptr) {
+    return nullptr;
+  }
+
+  const auto compare = [&](const AssetPackEntry &entry, const std::string &key) -> bool {
+    size_t length = std::min<size_t>(entry.nameLength, key.size());
+    int order = memcmp(nameTable_ + entry.nameOffset, key.data(), length);
+    return order < 0 || (order == 0 && entry.nameLength < key.size());
+  };
+
+  const AssetPackEntry* end = entries_ + header_->entryCount;
+  const AssetPackEntry* entry = std::lower_bound(entries_, end, name, compare);
+
+  if (entry == end || entry->nameLength != name.size() || memcmp(nameTable_ + entry->nameOffset, name.data(), name.size()) != 0) {
+    return nullptr;
+  }
+
+  return entry;
+}
+
+bool DecompressLZ4Block(const uint8_t* input, size_t inputSize, uint8_t* output, size_t outputSize) {
+
+  const uint8_t* inputEnd = input + inputSize;
+  size_t written = 0;
+
+  // lengths of 15 continue in following bytes, each 255 means keep reading
+  const auto readLength = [&](size_t length, size_t &output) -> bool {
+    if (length == 15) {
+      uint8_t byte;
+      do {
+        if (input >= inputEnd) return false;
+        byte = *input++;
+        length += byte;
+      } while (byte == 255);
+    }
+    output = length;
+    return true;
+  };
+
+  while (input < inputEnd) {
+    uint8_t token = *input++;
+
+    size_t literalLength;
+    if (!readLength(token >> 4, literalLength)) return false;
+    if (literalLength > size_t(inputEnd - input) || literalLength > outputSize - written) return false;
+
+    memcpy(output + written, input, literalLength);
+    input += literalLength;
+    written += literalLength;
+
+    // the last sequence has literals only
+    if (input == inputEnd) {
+      break;
+    }
+
+    if (inputEnd - input < 2) return false;
+    size_t offset = size_t(input[0]) | (size_t(input[1]) << 8);
+    input += 2;
+    if (offset == 0 || offset > written) return false;
+
+    size_t matchLength;
+    if (!readLength(token & 0x0f, matchLength)) return false;
+    matchLength += 4;
+    if (matchLength > outputSize - written) return false;
+
+    // byte by byte since a match may overlap the bytes it is producing
+    const uint8_t* match = output + written - offset;
+    for (size_t i = 0; i < matchLength; ++i) {
+      output[written + i] = match[i];
+    }
+    written += matchLength;
+  }
+
+  return written == outputSize;
+}
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace vks {
+
+// File layout, all little endian, written by ProcessAssets.py --pack:
+//   AssetPackHeader
+//   AssetPackEntry[entryCount], sorted by name
+//   name table, names are not null terminated
+//   entry data, every entry starts at a multiple of alignment
+const uint32_t kAssetPackMagic = 0x41534b56; // "VKSA"
+const uint32_t kAssetPackVersion = 1;
+
+enum AssetPackCompression {
+  kAssetPackUncompressed = 0,
+  // LZ4 block format, without the frame
+  kAssetPackLZ4Block = 1,
+};
+
+struct AssetPackHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t entryCount;
+  uint32_t alignment;
+  uint64_t nameTableOffset;
+  uint64_t nameTableSize;
+};
+
+struct AssetPackEntry {
+  uint64_t offset;
+  uint64_t storedSize;
+  uint64_t size;
+  uint32_t nameOffset;
+  uint32_t nameLength;
+  uint32_t compression;
+  uint32_t reserved;
+};
+
+// Points into the mapped pack, or into a decompressed copy owned by the pack.
+// Either way data is at least 4 byte aligned and lives until the pack is closed.
+struct AssetView {
+  const void* data = nullptr;
+  size_t size = 0;
+};
+
+// Read only asset archive mapped into memory. Uncompressed entries are handed out straight from the mapping,
+// compressed ones are decompressed on first access and kept. Find is thread safe.
+class AssetPack {
+  public:
+    ~AssetPack();
+
+    // returns false if the file is missing or malformed
+    bool Open(const std::string &path);
+    void Close();
+
+    bool IsOpen() const { return mappedData_ != nullptr; }
+
+    // returns false if there is no such entry or it fails to decompress
+    bool Find(const std::string &name, AssetView &output);
+
+  private:
+    bool validate();
+    const AssetPackEntry* findEntry(const std::string &name) const;
+
+    const char* mappedData_ = nullptr;
+    size_t mappedSize_ = 0;
+#ifdef _WIN32
+    void* fileHandle_ = nullptr;
+    void* mappingHandle_ = nullptr;
+#endif
+
+    const AssetPackHeader* header_ = nullptr;
+    const AssetPackEntry* entries_ = nullptr;
+    const char* nameTable_ = nullptr;
+
+    std::mutex decompressedMutex_;
+    // indexed like entries_, uint32_t storage keeps SPIR-V aligned
+    std::vector<std::unique_ptr<uint32_t[]>> decompressed_;
+};
+
+// Decompresses one LZ4 block. Returns false on malformed input or if it doesn't decompress to exactly outputSize bytes.
+bool DecompressLZ4Block(const uint8_t* input, size_t inputSize, uint8_t* output, size_t outputSize);
+
+}
@@ -0,0 +1,53 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+layout(set = 0, binding = 0) uniform FrameUniforms {
+    // xy offset, zw scale applied on top of the object transform
+    vec4 view;
+} frame;
+
+struct SceneObject {
+    // xyz center, w radius
+    vec4 sphere;
+    // xy offset, zw scale
+    vec4 transform;
+    vec4 tint;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer Objects {
+    SceneObject objects[];
+};
+
+// written by cull.comp, one entry per instance
+layout(std430, set = 1, binding = 1) readonly buffer VisibleObjects {
+    uint visibleIds[];
+};
+
+layout(location = 0) out vec3 fragColor;
+
+// indexed by the quad's index buffer
+vec2 positions[4] = vec2[](
+    vec2(-0.5, -0.5),
+    vec2(0.5, -0.5),
+    vec2(0.5, 0.5),
+    vec2(-0.5, 0.5)
+);
+
+vec3 colors[4] = vec3[](
+    vec3(1.0, 0.0, 0.0),
+    vec3(0.0, 1.0, 0.0),
+    vec3(0.0, 0.0, 1.0),
+    vec3(1.0, 1.0, 1.0)
+);
+
+void main() {
+    SceneObject object = objects[visibleIds[gl_InstanceIndex]];
+
+    vec2 position = positions[gl_VertexIndex] * object.transform.zw + object.transform.xy;
+    gl_Position = vec4(position * frame.view.zw + frame.view.xy, 0.0, 1.0);
+    fragColor = colors[gl_VertexIndex] * object.tint.rgb;
+}
@@ -5,6 +5,19 @@ out gl_PerVertex {
     vec4 gl_Position;
 };
 
+// once per frame, picked out of the frame uniform ring with a dynamic offset
+layout(set = 0, binding = 0) uniform FrameUniforms {
+    // xy offset, zw scale applied on top of the draw transform
+    vec4 view;
+} frame;
+
+// one per draw, filled from the draw list
+layout(push_constant) uniform DrawConstants {
+    // xy offset, zw scale
+    vec4 transform;
+    vec4 tint;
+} draw;
+
 layout(location = 0) out vec3 fragColor;
 
 vec2 positions[3] = vec2[](
@@ -20,6 +33,7 @@ vec3 colors[3] = vec3[](
 );
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
-}
\ No newline at end of file
+    vec2 position = positions[gl_VertexIndex] * draw.transform.zw + draw.transform.xy;
+    gl_Position = vec4(position * frame.view.zw + frame.view.xy, 0.0, 1.0);
+    fragColor = colors[gl_VertexIndex] * draw.tint.rgb;
+}
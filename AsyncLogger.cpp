@@ -0,0 +1,259 @@
+#include "AsyncLogger.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace vks {
+
+const uint32_t AsyncLogger::kDefaultCapacity;
+const size_t AsyncLogger::kMaxMessageLength;
+const uint32_t AsyncLogger::kDefaultRepeatLimit;
+
+namespace {
+
+const char kTruncationMark[] = " [...]";
+const size_t kTruncationMarkLength = sizeof(kTruncationMark) - 1;
+
+// how long the writer sleeps when the ring is empty, also bounds the latency of a message
+const std::chrono::milliseconds kWriterIdleInterval(1);
+const std::chrono::seconds kRepeatWindow(1);
+
+}
+
+LogLine::~LogLine() {
+  if (enabled_) {
+    logger_.Log(severity_, stream_.str());
+  }
+}
+
+AsyncLogger::~AsyncLogger() {
+  Stop();
+}
+
+void AsyncLogger::Start(std::ostream &out, std::ostream &errorOut, uint32_t capacity) {
+
+  uint64_t slotCount = 1;
+  while (slotCount < std::max(capacity, 2u)) {
+    slotCount *= 2;
+  }
+
+  slots_.reset(new Slot[slotCount]);
+  mask_ = slotCount - 1;
+  for (uint64_t i = 0; i < slotCount; ++i) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  enqueuePosition_.store(0, std::memory_order_relaxed);
+  dequeuePosition_ = 0;
+  writtenPosition_ = 0;
+
+  out_ = &out;
+  errorOut_ = &errorOut;
+  windowStart_ = Clock::now();
+
+  running_.store(true, std::memory_order_release);
+  writer_ = std::thread(&AsyncLogger::writerLoop, this);
+}
+
+void AsyncLogger::Stop() {
+
+  if (!writer_.joinable()) {
+    return;
+  }
+
+  running_.store(false, std::memory_order_release);
+  writer_.join();
+}
+
+bool AsyncLogger::Log(LogSeverity severity, const char* message, size_t length) {
+
+  if (!IsEnabled(severity) || !running_.load(std::memory_order_acquire)) {
+    return false;
+  }
+
+  // a slot is free for position p once its sequence is p, the producer that wins the position owns it
+  Slot* slot;
+  uint64_t position = enqueuePosition_.load(std::memory_order_relaxed);
+  for (;;) {
+    slot = &slots_[position & mask_];
+    const uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+    const int64_t difference = static_cast<int64_t>(sequence) - static_cast<int64_t>(position);
+
+    if (difference == 0) {
+      if (enqueuePosition_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    }
+    else if (difference < 0) {
+      // the writer hasn't caught up, rather lose the message than wait for it
+      droppedCount_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    else {
+      position = enqueuePosition_.load(std::memory_order_relaxed);
+    }
+  }
+
+  slot->severity = severity;
+  if (length <= kMaxMessageLength) {
+    slot->length = static_cast<uint32_t>(length);
+    memcpy(slot->text, message, length);
+  }
+  else {
+    // make the cut visible, the end of a message tends to be the part worth reading
+    slot->length = static_cast<uint32_t>(kMaxMessageLength);
+    memcpy(slot->text, message, kMaxMessageLength - kTruncationMarkLength);
+    memcpy(slot->text + kMaxMessageLength - kTruncationMarkLength, kTruncationMark, kTruncationMarkLength);
+  }
+  slot->sequence.store(position + 1, std::memory_order_release);
+  return true;
+}
+
+void AsyncLogger::Flush() {
+
+  if (!writer_.joinable()) {
+    return;
+  }
+
+  const uint64_t target = enqueuePosition_.load(std::memory_order_acquire);
+
+  flushWaiters_.fetch_add(1, std::memory_order_relaxed);
+  {
+    std::unique_lock<std::mutex> lock(flushMutex_);
+    flushCondition_.wait(lock, [&]() { return writtenPosition_ >= target; });
+  }
+  flushWaiters_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void AsyncLogger::writerLoop() {
+
+  for (;;) {
+    // read before draining, so nothing logged before Stop can be missed
+    const bool stopping = !running_.load(std::memory_order_acquire);
+    const uint32_t drainedCount = drain();
+
+    const Clock::time_point now = Clock::now();
+    const bool windowEnded = now - windowStart_ >= kRepeatWindow;
+    if (windowEnded) {
+      flushRepeats();
+      flushSuppressed();
+      windowStart_ = now;
+    }
+
+    // the ring is empty up to messages whose producer is still copying them in
+    const bool idle = drainedCount == 0 && dequeuePosition_ == enqueuePosition_.load(std::memory_order_acquire);
+    if (stopping && idle) {
+      flushRepeats();
+      flushSuppressed();
+    }
+
+    const bool flushing = flushWaiters_.load(std::memory_order_relaxed) > 0 || stopping;
+    if (flushing) {
+      flushRepeats();
+    }
+
+    // whatever left the ring reaches the file now, a crash shouldn't lose it in the stream's buffer
+    if (drainedCount > 0 || windowEnded || flushing) {
+      out_->flush();
+      errorOut_->flush();
+    }
+
+    // after every batch, a Flush mustn't wait for other threads to stop logging once its messages are out
+    {
+      std::lock_guard<std::mutex> lock(flushMutex_);
+      writtenPosition_ = dequeuePosition_;
+    }
+    flushCondition_.notify_all();
+
+    if (stopping && idle) {
+      return;
+    }
+    if (drainedCount == 0) {
+      std::this_thread::sleep_for(kWriterIdleInterval);
+    }
+  }
+}
+
+uint32_t AsyncLogger::drain() {
+
+  uint32_t drainedCount = 0;
+  for (;;) {
+    Slot &slot = slots_[dequeuePosition_ & mask_];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeuePosition_ + 1) {
+      break;
+    }
+
+    writeMessage(slot.severity, slot.text, slot.length);
+
+    // hands the slot back to producers for the next lap around the ring
+    slot.sequence.store(dequeuePosition_ + mask_ + 1, std::memory_order_release);
+    ++dequeuePosition_;
+    ++drainedCount;
+  }
+
+  return drainedCount;
+}
+
+void AsyncLogger::writeMessage(LogSeverity severity, const char* text, size_t length) {
+
+  if (severity == lastSeverity_ && lastMessage_.size() == length && memcmp(lastMessage_.data(), text, length) == 0) {
+    if (lastSuppressed_) {
+      RepeatCounter &counter = repeatCounters_[lastMessage_];
+      counter.suppressed++;
+      counter.severity = severity;
+    }
+    else {
+      ++lastRepeats_;
+    }
+    return;
+  }
+
+  flushRepeats();
+  lastMessage_.assign(text, length);
+  lastSeverity_ = severity;
+  lastSuppressed_ = false;
+
+  const uint32_t repeatLimit = repeatLimit_.load(std::memory_order_relaxed);
+  if (repeatLimit > 0) {
+    RepeatCounter &counter = repeatCounters_[lastMessage_];
+    if (counter.count++ >= repeatLimit) {
+      counter.suppressed++;
+      counter.severity = severity;
+      lastSuppressed_ = true;
+      return;
+    }
+  }
+
+  writeLine(severity, lastMessage_);
+}
+
+void AsyncLogger::writeLine(LogSeverity severity, const std::string &line) {
+  std::ostream &stream = severity >= kWarningLogSeverity ? *errorOut_ : *out_;
+  stream << line << '\n';
+}
+
+void AsyncLogger::flushRepeats() {
+
+  if (lastRepeats_ > 0) {
+    writeLine(lastSeverity_, "  (last message repeated " + std::to_string(lastRepeats_) + " times)");
+    lastRepeats_ = 0;
+  }
+}
+
+void AsyncLogger::flushSuppressed() {
+
+  for (const auto &entry : repeatCounters_) {
+    if (entry.second.suppressed > 0) {
+      writeLine(entry.second.severity, "  (suppressed " + std::to_string(entry.second.suppressed) + " more of: " + entry.first.substr(0, 80) + ")");
+    }
+  }
+  repeatCounters_.clear();
+
+  // reported once per window like the suppressed messages, a flood would otherwise add a line per drain
+  const uint64_t droppedCount = droppedCount_.load(std::memory_order_relaxed);
+  if (droppedCount != reportedDroppedCount_) {
+    writeLine(kWarningLogSeverity, "dropped " + std::to_string(droppedCount - reportedDroppedCount_) + " log messages, the log ring was full");
+    reportedDroppedCount_ = droppedCount;
+  }
+}
+
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace vks {
+
+enum LogSeverity {
+  kDebugLogSeverity = 0,
+  kInfoLogSeverity,
+  kWarningLogSeverity,
+  kErrorLogSeverity,
+};
+
+class AsyncLogger;
+
+// Formats a message with operator<< and logs it when it goes out of scope, e.g. logger.Write(kErrorLogSeverity) << x;
+// Severities below the logger's minimum skip the formatting.
+class LogLine {
+  public:
+    LogLine(AsyncLogger &logger, LogSeverity severity, bool enabled) : logger_(logger), severity_(severity), enabled_(enabled) {}
+    LogLine(LogLine &&other)
+      : logger_(other.logger_), severity_(other.severity_), enabled_(other.enabled_), stream_(std::move(other.stream_)) {
+      other.enabled_ = false;
+    }
+    ~LogLine();
+
+    template<typename T>
+    LogLine &operator<<(const T &value) {
+      if (enabled_) {
+        stream_ << value;
+      }
+      return *this;
+    }
+
+  private:
+    AsyncLogger &logger_;
+    LogSeverity severity_;
+    bool enabled_;
+    std::ostringstream stream_;
+};
+
+// Log messages go into a bounded lock-free ring (Vyukov's MPMC queue, used with a single consumer) and a background
+// thread writes them out, so logging from the render thread or from inside a driver callback never waits on a lock
+// or on the console. When the ring is full messages are dropped and counted instead.
+//
+// The writer thread collapses consecutive identical messages into a repeat count and lets each distinct message
+// through at most repeatLimit times per second, validation layers tend to report the same problem every frame.
+// Suppressed and dropped messages are summed up once per second. The streams are flushed after every batch
+// the writer takes out of the ring.
+// Info and debug go to out, warnings and errors to errorOut, both have to outlive Stop.
+// Log is thread safe, Start, Stop and Flush are meant to be called by the thread that owns the logger.
+class AsyncLogger {
+  public:
+    // 2 MiB of slots, each one large enough for a validation message with its VUID and spec text
+    static const uint32_t kDefaultCapacity = 1024;
+    // longer messages are cut off and end in kTruncationMark
+    static const size_t kMaxMessageLength = 2048;
+    static const uint32_t kDefaultRepeatLimit = 5;
+
+    ~AsyncLogger();
+
+    // capacity is rounded up to a power of two
+    void Start(std::ostream &out, std::ostream &errorOut, uint32_t capacity = kDefaultCapacity);
+    // writes out everything logged before the call and joins the writer thread
+    void Stop();
+
+    void SetMinSeverity(LogSeverity severity) { minSeverity_.store(severity, std::memory_order_relaxed); }
+    bool IsEnabled(LogSeverity severity) const { return severity >= minSeverity_.load(std::memory_order_relaxed); }
+    // 0 disables rate limiting, only the writer thread reads it
+    void SetRepeatLimit(uint32_t messagesPerSecond) { repeatLimit_.store(messagesPerSecond, std::memory_order_relaxed); }
+
+    // never blocks, returns false if the message was filtered, dropped or the logger isn't running
+    bool Log(LogSeverity severity, const char* message, size_t length);
+    bool Log(LogSeverity severity, const std::string &message) { return Log(severity, message.data(), message.size()); }
+    LogLine Write(LogSeverity severity) { return LogLine(*this, severity, IsEnabled(severity)); }
+
+    // blocks until everything logged before the call is written, e.g. before printing a report straight to out
+    void Flush();
+
+    uint64_t GetDroppedCount() const { return droppedCount_.load(std::memory_order_relaxed); }
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Slot {
+      std::atomic<uint64_t> sequence;
+      LogSeverity severity;
+      uint32_t length;
+      char text[kMaxMessageLength];
+    };
+
+    // how often a distinct message was seen in the current rate limit window
+    struct RepeatCounter {
+      uint32_t count = 0;
+      uint32_t suppressed = 0;
+      LogSeverity severity = kInfoLogSeverity;
+    };
+
+    void writerLoop();
+    // returns how many messages were taken out of the ring
+    uint32_t drain();
+    void writeMessage(LogSeverity severity, const char* text, size_t length);
+    void writeLine(LogSeverity severity, const std::string &line);
+    void flushRepeats();
+    void flushSuppressed();
+
+    std::unique_ptr<Slot[]> slots_;
+    uint64_t mask_ = 0;
+    alignas(64) std::atomic<uint64_t> enqueuePosition_{ 0 };
+    alignas(64) uint64_t dequeuePosition_ = 0;
+
+    std::atomic<int> minSeverity_{ kInfoLogSeverity };
+    std::atomic<uint32_t> repeatLimit_{ kDefaultRepeatLimit };
+    std::atomic<uint64_t> droppedCount_{ 0 };
+    std::atomic<bool> running_{ false };
+
+    std::ostream* out_ = nullptr;
+    std::ostream* errorOut_ = nullptr;
+    std::thread writer_;
+
+    // only touched by the writer thread
+    std::string lastMessage_;
+    LogSeverity lastSeverity_ = kInfoLogSeverity;
+    uint32_t lastRepeats_ = 0;
+    // the last message hit the repeat limit, so its repeats count as suppressed
+    bool lastSuppressed_ = false;
+    std::unordered_map<std::string, RepeatCounter> repeatCounters_;
+    Clock::time_point windowStart_;
+    uint64_t reportedDroppedCount_ = 0;
+
+    std::mutex flushMutex_;
+    std::condition_variable flushCondition_;
+    std::atomic<uint32_t> flushWaiters_{ 0 };
+    uint64_t writtenPosition_ = 0;
+};
+
+}
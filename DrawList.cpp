@@ -0,0 +1,41 @@
+#include "DrawList.h"
+
+#include <cstring>
+
+namespace vks {
+
+static_assert(sizeof(DrawTransform) == 4 * sizeof(float), "DrawTransform has to match the flat float layout");
+
+void DrawList::Clear() {
+  transforms_.clear();
+  materialIds_.clear();
+}
+
+void DrawList::Reserve(uint32_t count) {
+  transforms_.reserve(count);
+  materialIds_.reserve(count);
+}
+
+uint32_t DrawList::Add(const DrawTransform &transform, uint32_t materialId) {
+  transforms_.push_back(transform);
+  materialIds_.push_back(materialId);
+  return static_cast<uint32_t>(transforms_.size() - 1);
+}
+
+void DrawList::Assign(const float* transforms, const uint32_t* materialIds, uint32_t count) {
+  // resize keeps the capacity from previous frames, so steady state frames don't allocate
+  transforms_.resize(count);
+  materialIds_.resize(count);
+
+  if (count > 0) {
+    memcpy(transforms_.data(), transforms, count * sizeof(DrawTransform));
+    memcpy(materialIds_.data(), materialIds, count * sizeof(uint32_t));
+  }
+}
+
+void DrawList::Resize(uint32_t count) {
+  transforms_.resize(count);
+  materialIds_.resize(count);
+}
+
+}
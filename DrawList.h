@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace vks {
+
+// 2D placement of one draw, laid out exactly like the transform push constant
+struct DrawTransform {
+  float offsetX;
+  float offsetY;
+  float scaleX;
+  float scaleY;
+};
+
+// Flat list of everything drawn in a frame, struct of arrays so producers can fill it with memcpy
+// sized copies and the recorder walks it linearly. Scripts fill it in one call per frame through Assign
+// instead of crossing into the engine once per object.
+class DrawList {
+  public:
+    void Clear();
+    void Reserve(uint32_t count);
+
+    // per object path, returns the draw index
+    uint32_t Add(const DrawTransform &transform, uint32_t materialId);
+
+    // replaces the whole list, transforms holds 4 floats per draw in DrawTransform order
+    void Assign(const float* transforms, const uint32_t* materialIds, uint32_t count);
+    // for producers that fill the list in parallel through the Mutable pointers
+    void Resize(uint32_t count);
+
+    uint32_t Size() const { return static_cast<uint32_t>(transforms_.size()); }
+    const DrawTransform* Transforms() const { return transforms_.data(); }
+    const uint32_t* MaterialIds() const { return materialIds_.data(); }
+    DrawTransform* MutableTransforms() { return transforms_.data(); }
+    uint32_t* MutableMaterialIds() { return materialIds_.data(); }
+
+  private:
+    std::vector<DrawTransform> transforms_;
+    std::vector<uint32_t> materialIds_;
+};
+
+}
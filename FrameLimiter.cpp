@@ -0,0 +1,86 @@
+#include "FrameLimiter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <mmsystem.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "winmm.lib")
+#endif
+#endif
+
+namespace vks {
+
+// longest stretch spent yielding before a deadline
+const double kMaxSpinSeconds = 0.002;
+
+FrameLimiter::~FrameLimiter() {
+  setHighTimerResolution(false);
+}
+
+void FrameLimiter::SetTargetRate(double framesPerSecond) {
+  period_ = framesPerSecond > 0.0 ?
+    std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond)) :
+    Clock::duration::zero();
+  started_ = false;
+  setHighTimerResolution(IsEnabled());
+}
+
+void FrameLimiter::Wait() {
+
+  if (!IsEnabled()) return;
+
+  Clock::time_point now = Clock::now();
+  if (!started_ || now - nextDeadline_ > period_) {
+    started_ = true;
+    nextDeadline_ = now + period_;
+    return;
+  }
+
+  const double spinSeconds = std::min(sleepEstimate_, kMaxSpinSeconds);
+  while (std::chrono::duration<double>(nextDeadline_ - Clock::now()).count() > spinSeconds) {
+    sleepStep();
+  }
+  while (Clock::now() < nextDeadline_) {
+    std::this_thread::yield();
+  }
+
+  nextDeadline_ += period_;
+}
+
+void FrameLimiter::sleepStep() {
+
+  const Clock::time_point start = Clock::now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  const double observed = std::chrono::duration<double>(Clock::now() - start).count();
+
+  // Welford's update, sleeping on until the mean plus one deviation left is short enough to spin out
+  ++sleepCount_;
+  const double delta = observed - sleepMean_;
+  sleepMean_ += delta / sleepCount_;
+  sleepM2_ += delta * (observed - sleepMean_);
+  sleepEstimate_ = sleepMean_ + std::sqrt(sleepM2_ / (sleepCount_ - 1));
+}
+
+void FrameLimiter::setHighTimerResolution(bool high) {
+
+  if (high == highTimerResolution_) return;
+  highTimerResolution_ = high;
+
+#ifdef _WIN32
+  // process wide on older Windows versions, every timeBeginPeriod needs its timeEndPeriod
+  if (high) {
+    timeBeginPeriod(1);
+  }
+  else {
+    timeEndPeriod(1);
+  }
+#endif
+}
+
+}
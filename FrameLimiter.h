@@ -0,0 +1,46 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace vks {
+
+// Paces a loop to a fixed rate. OS sleeps overshoot by up to a scheduler tick, so it sleeps in short steps
+// while the remaining time is above the overshoot it measured so far, and spins for the rest, at most
+// kMaxSpinSeconds: with a coarse timer a frame rather comes late than burns a core. On Windows the system
+// timer resolution is raised to 1 ms while the limiter is enabled, the default 15.6 ms tick would make
+// every 1 ms sleep take a whole tick.
+//
+// Deadlines advance by whole periods, so a frame that finished early makes up for one that finished late,
+// a loop that fell behind by more than a period starts over instead of running uncapped to catch up.
+// Not thread safe, meant to be driven by the render thread.
+class FrameLimiter {
+  public:
+    ~FrameLimiter();
+
+    // 0 disables the limiter
+    void SetTargetRate(double framesPerSecond);
+    bool IsEnabled() const { return period_.count() > 0; }
+
+    // blocks until the next frame is due
+    void Wait();
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    void sleepStep();
+    void setHighTimerResolution(bool high);
+
+    Clock::duration period_ = Clock::duration::zero();
+    Clock::time_point nextDeadline_;
+    bool started_ = false;
+    bool highTimerResolution_ = false;
+
+    // running mean and variance of how long a short sleep really takes, in seconds
+    double sleepEstimate_ = 0.005;
+    double sleepMean_ = 0.005;
+    double sleepM2_ = 0.0;
+    uint64_t sleepCount_ = 1;
+};
+
+}
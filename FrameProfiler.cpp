@@ -0,0 +1,247 @@
+#include "FrameProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+namespace vks {
+
+// caps the trace at a few ten MB, long sessions only keep their beginning
+const size_t kMaxFrameProfilerTraceEvents = 1 << 20;
+
+const char* frameProfilerScopeName(FrameProfilerScope scope) {
+  switch (scope) {
+    case kFrameCpuScope: return "Frame";
+    case kFenceWaitCpuScope: return "Fence Wait";
+    case kAcquireCpuScope: return "Acquire";
+    case kRecordCpuScope: return "Record";
+    case kSubmitCpuScope: return "Submit";
+    case kPresentCpuScope: return "Present";
+    case kFrameGpuScope: return "GPU Frame";
+    default: return "Unknown";
+  }
+}
+
+VkResult FrameProfiler::Init(
+  VkPhysicalDevice physicalDevice,
+  VkDevice device,
+  uint32_t queueFamilyIndex,
+  uint32_t frameSlotCount,
+  uint32_t historySize,
+  bool recordTrace,
+  const VkAllocationCallbacks* allocationCallbacks) {
+
+  device_ = device;
+  allocationCallbacks_ = allocationCallbacks;
+  historySize_ = std::max(historySize, 1u);
+  recordTrace_ = recordTrace;
+  initTime_ = Clock::now();
+
+  for (auto &history : history_) {
+    history.assign(historySize_, 0.0);
+  }
+
+  slotSubmitMicroseconds_.assign(frameSlotCount, 0.0);
+  slotHasGpuQueries_.assign(frameSlotCount, false);
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+  uint32_t timestampValidBits = queueFamilyIndex < queueFamilyCount ? queueFamilies[queueFamilyIndex].timestampValidBits : 0;
+
+  if (timestampValidBits > 0 && properties.limits.timestampPeriod > 0.0f) {
+
+    timestampPeriodNanoseconds_ = properties.limits.timestampPeriod;
+    timestampMask_ = timestampValidBits >= 64 ? ~uint64_t(0) : (uint64_t(1) << timestampValidBits) - 1;
+
+    VkQueryPoolCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    createInfo.queryCount = frameSlotCount * 2;
+
+    VkResult result;
+    if ((result = vkCreateQueryPool(device_, &createInfo, allocationCallbacks_, &queryPool_)) != VK_SUCCESS) {
+      queryPool_ = VK_NULL_HANDLE;
+      return result;
+    }
+  }
+
+  enabled_ = true;
+  return VK_SUCCESS;
+}
+
+void FrameProfiler::Destroy() {
+  if (queryPool_ != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(device_, queryPool_, allocationCallbacks_);
+    queryPool_ = VK_NULL_HANDLE;
+  }
+
+  enabled_ = false;
+}
+
+void FrameProfiler::BeginFrame(uint32_t frameSlot) {
+  if (!enabled_) return;
+
+  Clock::time_point now = Clock::now();
+
+  // a frame lasts until the next one starts, so time spent outside drawing (event polling) is counted too
+  if (frameStarted_) {
+    double start = microsecondsSinceInit(frameStart_);
+    addSample(kFrameCpuScope, start, microsecondsSinceInit(now) - start);
+  }
+
+  frameSlot_ = frameSlot;
+  frameStart_ = now;
+  frameStarted_ = true;
+}
+
+void FrameProfiler::BeginCpuScope(FrameProfilerScope scope) {
+  if (!enabled_) return;
+
+  scopeStarts_[scope] = Clock::now();
+}
+
+void FrameProfiler::EndCpuScope(FrameProfilerScope scope) {
+  if (!enabled_) return;
+
+  double start = microsecondsSinceInit(scopeStarts_[scope]);
+  double end = microsecondsSinceInit(Clock::now());
+  addSample(scope, start, end - start);
+
+  if (scope == kSubmitCpuScope) {
+    slotSubmitMicroseconds_[frameSlot_] = end;
+  }
+}
+
+void FrameProfiler::ResolveGpuScopes() {
+  if (!enabled_ || queryPool_ == VK_NULL_HANDLE || !slotHasGpuQueries_[frameSlot_]) return;
+
+  slotHasGpuQueries_[frameSlot_] = false;
+
+  // no VK_QUERY_RESULT_WAIT_BIT, the fence already signaled, and if the frame never got submitted we skip it
+  uint64_t timestamps[2];
+  VkResult result = vkGetQueryPoolResults(
+    device_, queryPool_, frameSlot_ * 2, 2,
+    sizeof(timestamps), timestamps, sizeof(uint64_t),
+    VK_QUERY_RESULT_64_BIT);
+
+  if (result != VK_SUCCESS) {
+    return;
+  }
+
+  uint64_t ticks = (timestamps[1] - timestamps[0]) & timestampMask_;
+  double durationMicroseconds = static_cast<double>(ticks) * timestampPeriodNanoseconds_ / 1000.0;
+  addSample(kFrameGpuScope, slotSubmitMicroseconds_[frameSlot_], durationMicroseconds);
+}
+
+void FrameProfiler::WriteGpuFrameBegin(VkCommandBuffer commandBuffer) {
+  if (!enabled_ || queryPool_ == VK_NULL_HANDLE) return;
+
+  vkCmdResetQueryPool(commandBuffer, queryPool_, frameSlot_ * 2, 2);
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool_, frameSlot_ * 2);
+}
+
+void FrameProfiler::WriteGpuFrameEnd(VkCommandBuffer commandBuffer) {
+  if (!enabled_ || queryPool_ == VK_NULL_HANDLE) return;
+
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool_, frameSlot_ * 2 + 1);
+  slotHasGpuQueries_[frameSlot_] = true;
+}
+
+FrameProfilerSummary FrameProfiler::GetSummary(FrameProfilerScope scope) const {
+  FrameProfilerSummary summary;
+  summary.sampleCount = historyCount_[scope];
+
+  if (summary.sampleCount == 0) {
+    return summary;
+  }
+
+  std::vector<double> samples(history_[scope].begin(), history_[scope].begin() + summary.sampleCount);
+
+  double total = 0.0;
+  for (double sample : samples) {
+    total += sample;
+  }
+
+  size_t p99Index = static_cast<size_t>(std::ceil(samples.size() * 0.99)) - 1;
+  std::nth_element(samples.begin(), samples.begin() + p99Index, samples.end());
+
+  summary.minMilliseconds = *std::min_element(samples.begin(), samples.end());
+  summary.avgMilliseconds = total / samples.size();
+  summary.p99Milliseconds = samples[p99Index];
+
+  return summary;
+}
+
+void FrameProfiler::PrintSummary(std::ostream &stream) const {
+  if (!enabled_) return;
+
+  stream << "Frame profile over the last " << historyCount_[kFrameCpuScope] << " frames (min / avg / p99 ms):\n";
+
+  for (uint32_t i = 0; i < kFrameProfilerScopeCount; ++i) {
+    FrameProfilerScope scope = static_cast<FrameProfilerScope>(i);
+    FrameProfilerSummary summary = GetSummary(scope);
+
+    if (summary.sampleCount == 0) {
+      continue;
+    }
+
+    stream << "\t" << frameProfilerScopeName(scope) << ": "
+      << summary.minMilliseconds << " / "
+      << summary.avgMilliseconds << " / "
+      << summary.p99Milliseconds << "\n";
+  }
+
+  if (queryPool_ == VK_NULL_HANDLE) {
+    stream << "\tGPU timestamps are not supported by this queue\n";
+  }
+
+  stream.flush();
+}
+
+bool FrameProfiler::WriteChromeTrace(const std::string &path) const {
+  if (!enabled_ || !recordTrace_) return false;
+
+  std::ofstream file(path, std::ios::trunc);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  // thread 0 is the render thread, thread 1 the GPU queue
+  file << "{\"traceEvents\":[\n";
+  file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+  file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,\"args\":{\"name\":\"GPU\"}}";
+
+  for (const TraceEvent &event : traceEvents_) {
+    file << ",\n{\"name\":\"" << frameProfilerScopeName(event.scope)
+      << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << (event.scope == kFrameGpuScope ? 1 : 0)
+      << ",\"ts\":" << event.startMicroseconds
+      << ",\"dur\":" << event.durationMicroseconds << "}";
+  }
+
+  file << "\n]}\n";
+
+  return file.good();
+}
+
+double FrameProfiler::microsecondsSinceInit(Clock::time_point time) const {
+  return std::chrono::duration<double, std::micro>(time - initTime_).count();
+}
+
+void FrameProfiler::addSample(FrameProfilerScope scope, double startMicroseconds, double durationMicroseconds) {
+
+  history_[scope][historyNext_[scope]] = durationMicroseconds / 1000.0;
+  historyNext_[scope] = (historyNext_[scope] + 1) % historySize_;
+  historyCount_[scope] = std::min(historyCount_[scope] + 1, historySize_);
+
+  if (recordTrace_ && traceEvents_.size() < kMaxFrameProfilerTraceEvents) {
+    traceEvents_.push_back({ scope, startMicroseconds, durationMicroseconds });
+  }
+}
+
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <vulkan\vulkan.hpp>
+
+namespace vks {
+
+enum FrameProfilerScope {
+  // CPU time from the start of one frame to the start of the next
+  kFrameCpuScope = 0,
+  // CPU blocked on the frame slot fence
+  kFenceWaitCpuScope,
+  kAcquireCpuScope,
+  kRecordCpuScope,
+  kSubmitCpuScope,
+  kPresentCpuScope,
+  // GPU time between the first and last command of the frame's primary command buffer
+  kFrameGpuScope,
+  kFrameProfilerScopeCount,
+};
+
+struct FrameProfilerSummary {
+  uint32_t sampleCount = 0;
+  double minMilliseconds = 0.0;
+  double avgMilliseconds = 0.0;
+  double p99Milliseconds = 0.0;
+};
+
+// Per frame CPU and GPU timings kept in ring buffers of the last historySize frames,
+// optionally also kept as a full trace that can be dumped as Chrome trace_event JSON.
+// Until Init succeeds every method returns immediately, so an unused profiler costs a branch per call.
+// Not thread safe, meant to be driven by the render thread only.
+class FrameProfiler {
+  public:
+    // GPU scopes are skipped if the queue family has no timestampValidBits
+    VkResult Init(
+      VkPhysicalDevice physicalDevice,
+      VkDevice device,
+      uint32_t queueFamilyIndex,
+      uint32_t frameSlotCount,
+      uint32_t historySize,
+      bool recordTrace,
+      const VkAllocationCallbacks* allocationCallbacks = nullptr);
+    void Destroy();
+
+    bool IsEnabled() const { return enabled_; }
+    bool HasGpuTimestamps() const { return queryPool_ != VK_NULL_HANDLE; }
+
+    // starts the frame using frameSlot, and closes the previous frame's kFrameCpuScope
+    void BeginFrame(uint32_t frameSlot);
+
+    void BeginCpuScope(FrameProfilerScope scope);
+    void EndCpuScope(FrameProfilerScope scope);
+
+    // reads back the GPU timestamps this frame slot wrote last time, call once the slot's fence signaled
+    void ResolveGpuScopes();
+    // record into the frame's primary command buffer, outside of any render pass
+    void WriteGpuFrameBegin(VkCommandBuffer commandBuffer);
+    void WriteGpuFrameEnd(VkCommandBuffer commandBuffer);
+
+    // min, avg and p99 over the frames still in the ring buffer
+    FrameProfilerSummary GetSummary(FrameProfilerScope scope) const;
+    void PrintSummary(std::ostream &stream) const;
+
+    // returns false if tracing was off or the file couldn't be written
+    bool WriteChromeTrace(const std::string &path) const;
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct TraceEvent {
+      FrameProfilerScope scope;
+      double startMicroseconds;
+      double durationMicroseconds;
+    };
+
+    double microsecondsSinceInit(Clock::time_point time) const;
+    void addSample(FrameProfilerScope scope, double startMicroseconds, double durationMicroseconds);
+
+    bool enabled_ = false;
+    bool recordTrace_ = false;
+    Clock::time_point initTime_;
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    const VkAllocationCallbacks* allocationCallbacks_ = nullptr;
+    // two timestamps per frame slot
+    VkQueryPool queryPool_ = VK_NULL_HANDLE;
+    double timestampPeriodNanoseconds_ = 1.0;
+    uint64_t timestampMask_ = 0;
+
+    uint32_t frameSlot_ = 0;
+    bool frameStarted_ = false;
+    Clock::time_point frameStart_;
+    Clock::time_point scopeStarts_[kFrameProfilerScopeCount];
+    // the two clocks aren't calibrated against each other, so GPU scopes are traced starting at their frame's submit
+    std::vector<double> slotSubmitMicroseconds_;
+    std::vector<bool> slotHasGpuQueries_;
+
+    uint32_t historySize_ = 0;
+    std::vector<double> history_[kFrameProfilerScopeCount];
+    uint32_t historyCount_[kFrameProfilerScopeCount] = {};
+    uint32_t historyNext_[kFrameProfilerScopeCount] = {};
+
+    std::vector<TraceEvent> traceEvents_;
+};
+
+}
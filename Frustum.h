@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cmath>
+
+namespace vks {
+
+// Six planes with inward facing, normalized normals. A point p is inside when
+// dot(plane.xyz, p) + plane.w >= 0 holds for every plane, a sphere when it holds for -radius.
+struct Frustum {
+  float planes[6][4];
+};
+
+// The volume the view transform of the shaders maps into clip space: x and y end up in [-1, 1]
+// after scaling by view.zw and offsetting by view.xy, z is passed through and has to be in [nearZ, farZ].
+inline Frustum MakeViewFrustum(const float view[4], float nearZ, float farZ) {
+
+  const float offsetX = view[0];
+  const float offsetY = view[1];
+  const float scaleX = std::fabs(view[2]) > 0.0f ? view[2] : 1.0f;
+  const float scaleY = std::fabs(view[3]) > 0.0f ? view[3] : 1.0f;
+
+  // x * scale + offset >= -1 and <= 1, divided by |scale| so the normals stay unit length
+  const float invScaleX = 1.0f / std::fabs(scaleX);
+  const float invScaleY = 1.0f / std::fabs(scaleY);
+
+  Frustum frustum = { {
+    { scaleX * invScaleX, 0.0f, 0.0f, (offsetX + 1.0f) * invScaleX },
+    { -scaleX * invScaleX, 0.0f, 0.0f, (1.0f - offsetX) * invScaleX },
+    { 0.0f, scaleY * invScaleY, 0.0f, (offsetY + 1.0f) * invScaleY },
+    { 0.0f, -scaleY * invScaleY, 0.0f, (1.0f - offsetY) * invScaleY },
+    { 0.0f, 0.0f, 1.0f, -nearZ },
+    { 0.0f, 0.0f, -1.0f, farZ },
+  } };
+
+  return frustum;
+}
+
+}
@@ -0,0 +1,713 @@
+#include "FrustumCulling.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define VKS_CULLING_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC compiles intrinsics for any instruction set without extra flags
+#define VKS_TARGET_AVX2
+#else
+#define VKS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace vks {
+
+void CullingBounds::Clear() {
+  for (auto* component : { &centerX_, &centerY_, &centerZ_, &radius_, &minX_, &minY_, &minZ_, &maxX_, &maxY_, &maxZ_ }) {
+    component->clear();
+  }
+}
+
+void CullingBounds::Reserve(uint32_t count) {
+  for (auto* component : { &centerX_, &centerY_, &centerZ_, &radius_, &minX_, &minY_, &minZ_, &maxX_, &maxY_, &maxZ_ }) {
+    component->reserve(count);
+  }
+}
+
+uint32_t CullingBounds::Add(const float center[3], float radius, const float boundsMin[3], const float boundsMax[3]) {
+  centerX_.push_back(center[0]);
+  centerY_.push_back(center[1]);
+  centerZ_.push_back(center[2]);
+  radius_.push_back(radius);
+  minX_.push_back(boundsMin[0]);
+  minY_.push_back(boundsMin[1]);
+  minZ_.push_back(boundsMin[2]);
+  maxX_.push_back(boundsMax[0]);
+  maxY_.push_back(boundsMax[1]);
+  maxZ_.push_back(boundsMax[2]);
+  return Size() - 1;
+}
+
+void CullingBounds::Resize(uint32_t count) {
+  for (auto* component : { &centerX_, &centerY_, &centerZ_, &radius_, &minX_, &minY_, &minZ_, &maxX_, &maxY_, &maxZ_ }) {
+    component->resize(count);
+  }
+}
+
+// The box kernels test the corner furthest along each plane normal, that choice only depends on
+// the plane, so it is made once per plane by picking the min or max arrays.
+struct BoxPlaneCorners {
+  const float* x;
+  const float* y;
+  const float* z;
+};
+
+void pickBoxPlaneCorners(const Frustum &frustum, const CullingBounds &bounds, BoxPlaneCorners corners[6]) {
+  for (int p = 0; p < 6; ++p) {
+    corners[p].x = frustum.planes[p][0] >= 0.0f ? bounds.MaxX() : bounds.MinX();
+    corners[p].y = frustum.planes[p][1] >= 0.0f ? bounds.MaxY() : bounds.MinY();
+    corners[p].z = frustum.planes[p][2] >= 0.0f ? bounds.MaxZ() : bounds.MinZ();
+  }
+}
+
+// The corner of a rectangle furthest along a plane's normal is its center plus |normal.xy| times its half size, so
+// the rectangle kernels test dot(plane.xy, center) + dot(|plane.xy| / 2, |size|) + plane.w per plane.
+// Planes whose normal has no xy part give the same distance for every rectangle on z = 0, they are decided here.
+// The sides of a view frustum only depend on x or on y, those planes get a test with half the work.
+struct RectPlanes {
+  // planes with y = 0 and with x = 0: x or y, |x| / 2 or |y| / 2, w
+  float xPlanes[6][3];
+  float yPlanes[6][3];
+  uint32_t xCount;
+  uint32_t yCount;
+  // the rest: x, y, |x| / 2, |y| / 2, w
+  float planes[6][5];
+  uint32_t count;
+  bool rejectsAll;
+};
+
+RectPlanes prepareRectPlanes(const Frustum &frustum) {
+
+  RectPlanes output = {};
+  for (int p = 0; p < 6; ++p) {
+    const float* plane = frustum.planes[p];
+    if (plane[0] == 0.0f && plane[1] == 0.0f) {
+      output.rejectsAll = output.rejectsAll || !(plane[3] >= 0.0f);
+    }
+    else if (plane[1] == 0.0f) {
+      float* xPlane = output.xPlanes[output.xCount++];
+      xPlane[0] = plane[0];
+      xPlane[1] = 0.5f * std::fabs(plane[0]);
+      xPlane[2] = plane[3];
+    }
+    else if (plane[0] == 0.0f) {
+      float* yPlane = output.yPlanes[output.yCount++];
+      yPlane[0] = plane[1];
+      yPlane[1] = 0.5f * std::fabs(plane[1]);
+      yPlane[2] = plane[3];
+    }
+    else {
+      float* rectPlane = output.planes[output.count++];
+      rectPlane[0] = plane[0];
+      rectPlane[1] = plane[1];
+      rectPlane[2] = 0.5f * std::fabs(plane[0]);
+      rectPlane[3] = 0.5f * std::fabs(plane[1]);
+      rectPlane[4] = plane[3];
+    }
+  }
+
+  return output;
+}
+
+// shared by the scalar path and the tails of the SIMD paths
+uint32_t cullSpheresScalar(const Frustum &frustum, const CullingBounds &bounds, uint32_t first, uint32_t* visible, uint32_t visibleCount) {
+
+  const float* centerX = bounds.CenterX();
+  const float* centerY = bounds.CenterY();
+  const float* centerZ = bounds.CenterZ();
+  const float* radius = bounds.Radius();
+
+  const uint32_t count = bounds.Size();
+  for (uint32_t i = first; i < count; ++i) {
+    const float negativeRadius = -radius[i];
+
+    bool inside = true;
+    for (int p = 0; p < 6; ++p) {
+      const float* plane = frustum.planes[p];
+      float distance = plane[0] * centerX[i];
+      distance = distance + plane[1] * centerY[i];
+      distance = distance + plane[2] * centerZ[i];
+      distance = distance + plane[3];
+      inside = inside && distance >= negativeRadius;
+    }
+
+    visible[visibleCount] = i;
+    visibleCount += inside ? 1 : 0;
+  }
+
+  return visibleCount;
+}
+
+uint32_t cullBoxesScalar(const Frustum &frustum, const CullingBounds &bounds, uint32_t first, uint32_t* visible, uint32_t visibleCount) {
+
+  BoxPlaneCorners corners[6];
+  pickBoxPlaneCorners(frustum, bounds, corners);
+
+  const uint32_t count = bounds.Size();
+  for (uint32_t i = first; i < count; ++i) {
+
+    bool inside = true;
+    for (int p = 0; p < 6; ++p) {
+      const float* plane = frustum.planes[p];
+      float distance = plane[0] * corners[p].x[i];
+      distance = distance + plane[1] * corners[p].y[i];
+      distance = distance + plane[2] * corners[p].z[i];
+      distance = distance + plane[3];
+      inside = inside && distance >= 0.0f;
+    }
+
+    visible[visibleCount] = i;
+    visibleCount += inside ? 1 : 0;
+  }
+
+  return visibleCount;
+}
+
+uint32_t cullRectsScalar(const RectPlanes &planes, const CullingRects &rects, uint32_t first, uint32_t end, uint32_t* visible, uint32_t visibleCount) {
+
+  for (uint32_t i = first; i < end; ++i) {
+    const float centerX = rects.centerX[i];
+    const float centerY = rects.centerY[i];
+    const float sizeX = std::fabs(rects.sizeX[i]);
+    const float sizeY = std::fabs(rects.sizeY[i]);
+
+    bool inside = true;
+    for (uint32_t p = 0; p < planes.xCount; ++p) {
+      const float* plane = planes.xPlanes[p];
+      float distance = plane[0] * centerX;
+      distance = distance + plane[1] * sizeX;
+      distance = distance + plane[2];
+      inside = inside && distance >= 0.0f;
+    }
+    for (uint32_t p = 0; p < planes.yCount; ++p) {
+      const float* plane = planes.yPlanes[p];
+      float distance = plane[0] * centerY;
+      distance = distance + plane[1] * sizeY;
+      distance = distance + plane[2];
+      inside = inside && distance >= 0.0f;
+    }
+    for (uint32_t p = 0; p < planes.count; ++p) {
+      const float* plane = planes.planes[p];
+      float distance = plane[0] * centerX;
+      distance = distance + plane[1] * centerY;
+      distance = distance + plane[2] * sizeX;
+      distance = distance + plane[3] * sizeY;
+      distance = distance + plane[4];
+      inside = inside && distance >= 0.0f;
+    }
+
+    visible[visibleCount] = i;
+    visibleCount += inside ? 1 : 0;
+  }
+
+  return visibleCount;
+}
+
+#ifdef VKS_CULLING_X86
+
+// Lane indices of the set bits of every 8 bit visibility mask, packed to the front. Which objects are visible is
+// close to random, so a branch per visible object would mispredict all the time, instead the kernels add the first
+// object's index to a row of this table, store all of it and only advance by the number of visible lanes.
+struct VisibleLaneTable {
+  alignas(32) uint32_t lanes[256][8];
+  uint8_t counts[256];
+
+  VisibleLaneTable() {
+    for (uint32_t mask = 0; mask < 256; ++mask) {
+      uint32_t count = 0;
+      for (uint32_t lane = 0; lane < 8; ++lane) {
+        if (mask & (1u << lane)) {
+          lanes[mask][count++] = lane;
+        }
+      }
+      for (uint32_t unused = count; unused < 8; ++unused) {
+        lanes[mask][unused] = 0;
+      }
+      counts[mask] = static_cast<uint8_t>(count);
+    }
+  }
+};
+
+const VisibleLaneTable &getVisibleLaneTable() {
+  static const VisibleLaneTable table;
+  return table;
+}
+
+// Appends first + the index of every set bit of mask. Always writes 4 entries, which never passes the end of
+// visible since there is room for every object handed to the kernel.
+inline uint32_t appendVisibleMask(const VisibleLaneTable &table, uint32_t mask, uint32_t first, uint32_t* visible, uint32_t visibleCount) {
+  const __m128i lanes = _mm_load_si128(reinterpret_cast<const __m128i*>(table.lanes[mask]));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(visible + visibleCount), _mm_add_epi32(_mm_set1_epi32(static_cast<int>(first)), lanes));
+  return visibleCount + table.counts[mask];
+}
+
+uint32_t cullSpheresSSE(const Frustum &frustum, const CullingBounds &bounds, uint32_t* visible) {
+
+  __m128 planes[6][4];
+  for (int p = 0; p < 6; ++p) {
+    for (int c = 0; c < 4; ++c) {
+      planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+    }
+  }
+
+  const __m128 signBit = _mm_set1_ps(-0.0f);
+  const uint32_t simdCount = bounds.Size() & ~3u;
+  const VisibleLaneTable &laneTable = getVisibleLaneTable();
+  uint32_t visibleCount = 0;
+
+  for (uint32_t i = 0; i < simdCount; i += 4) {
+    const __m128 centerX = _mm_loadu_ps(bounds.CenterX() + i);
+    const __m128 centerY = _mm_loadu_ps(bounds.CenterY() + i);
+    const __m128 centerZ = _mm_loadu_ps(bounds.CenterZ() + i);
+    const __m128 negativeRadius = _mm_xor_ps(_mm_loadu_ps(bounds.Radius() + i), signBit);
+
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int p = 0; p < 6; ++p) {
+      __m128 distance = _mm_mul_ps(planes[p][0], centerX);
+      distance = _mm_add_ps(distance, _mm_mul_ps(planes[p][1], centerY));
+      distance = _mm_add_ps(distance, _mm_mul_ps(planes[p][2], centerZ));
+      distance = _mm_add_ps(distance, planes[p][3]);
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+    }
+
+    visibleCount = appendVisibleMask(laneTable, static_cast<uint32_t>(_mm_movemask_ps(inside)), i, visible, visibleCount);
+  }
+
+  return cullSpheresScalar(frustum, bounds, simdCount, visible, visibleCount);
+}
+
+uint32_t cullBoxesSSE(const Frustum &frustum, const CullingBounds &bounds, uint32_t* visible) {
+
+  BoxPlaneCorners corners[6];
+  pickBoxPlaneCorners(frustum, bounds, corners);
+
+  __m128 planes[6][4];
+  for (int p = 0; p < 6; ++p) {
+    for (int c = 0; c < 4; ++c) {
+      planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+    }
+  }
+
+  const __m128 zero = _mm_setzero_ps();
+  const uint32_t simdCount = bounds.Size() & ~3u;
+  const VisibleLaneTable &laneTable = getVisibleLaneTable();
+  uint32_t visibleCount = 0;
+
+  for (uint32_t i = 0; i < simdCount; i += 4) {
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int p = 0; p < 6; ++p) {
+      __m128 distance = _mm_mul_ps(planes[p][0], _mm_loadu_ps(corners[p].x + i));
+      distance = _mm_add_ps(distance, _mm_mul_ps(planes[p][1], _mm_loadu_ps(corners[p].y + i)));
+      distance = _mm_add_ps(distance, _mm_mul_ps(planes[p][2], _mm_loadu_ps(corners[p].z + i)));
+      distance = _mm_add_ps(distance, planes[p][3]);
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+    }
+
+    visibleCount = appendVisibleMask(laneTable, static_cast<uint32_t>(_mm_movemask_ps(inside)), i, visible, visibleCount);
+  }
+
+  return cullBoxesScalar(frustum, bounds, simdCount, visible, visibleCount);
+}
+
+uint32_t cullRectsSSE(const RectPlanes &rectPlanes, const CullingRects &rects, uint32_t first, uint32_t end, uint32_t* visible) {
+
+  __m128 xPlanes[6][3];
+  __m128 yPlanes[6][3];
+  __m128 planes[6][5];
+  for (uint32_t p = 0; p < rectPlanes.xCount; ++p) {
+    for (int c = 0; c < 3; ++c) {
+      xPlanes[p][c] = _mm_set1_ps(rectPlanes.xPlanes[p][c]);
+    }
+  }
+  for (uint32_t p = 0; p < rectPlanes.yCount; ++p) {
+    for (int c = 0; c < 3; ++c) {
+      yPlanes[p][c] = _mm_set1_ps(rectPlanes.yPlanes[p][c]);
+    }
+  }
+  for (uint32_t p = 0; p < rectPlanes.count; ++p) {
+    for (int c = 0; c < 5; ++c) {
+      planes[p][c] = _mm_set1_ps(rectPlanes.planes[p][c]);
+    }
+  }
+
+  const __m128 signBit = _mm_set1_ps(-0.0f);
+  const __m128 zero = _mm_setzero_ps();
+  const uint32_t simdEnd = first + ((end - first) & ~3u);
+  const VisibleLaneTable &laneTable = getVisibleLaneTable();
+  uint32_t visibleCount = 0;
+
+  for (uint32_t i = first; i < simdEnd; i += 4) {
+    const __m128 centerX = _mm_loadu_ps(rects.centerX + i);
+    const __m128 centerY = _mm_loadu_ps(rects.centerY + i);
+    const __m128 sizeX = _mm_andnot_ps(signBit, _mm_loadu_ps(rects.sizeX + i));
+    const __m128 sizeY = _mm_andnot_ps(signBit, _mm_loadu_ps(rects.sizeY + i));
+
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (uint32_t p = 0; p < rectPlanes.xCount; ++p) {
+      __m128 distance = _mm_mul_ps(xPlanes[p][0], centerX);
+      distance = _mm_add_ps(distance, _mm_mul_ps(xPlanes[p][1], sizeX));
+      distance = _mm_add_ps(distance, xPlanes[p][2]);
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+    }
+    for (uint32_t p = 0; p < rectPlanes.yCount; ++p) {
+      __m128 distance = _mm_mul_ps(yPlanes[p][0], centerY);
+      distance = _mm_add_ps(distance, _mm_mul_ps(yPlanes[p][1], sizeY));
+      distance = _mm_add_ps(distance, yPlanes[p][2]);
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+    }
+    for (uint32_t p = 0; p < rectPlanes.count; ++p) {
+      __m128 distance = _mm_mul_ps(planes[p][0], centerX);
+      distance = _mm_add_ps(distance, _mm_mul_ps(planes[p][1], centerY));
+      distance = _mm_add_ps(distance, _mm_mul_ps(planes[p][2], sizeX));
+      distance = _mm_add_ps(distance, _mm_mul_ps(planes[p][3], sizeY));
+      distance = _mm_add_ps(distance, planes[p][4]);
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+    }
+
+    visibleCount = appendVisibleMask(laneTable, static_cast<uint32_t>(_mm_movemask_ps(inside)), i, visible, visibleCount);
+  }
+
+  return cullRectsScalar(rectPlanes, rects, simdEnd, end, visible, visibleCount);
+}
+
+// same for 8 lanes, always writes 8 entries
+VKS_TARGET_AVX2 inline uint32_t appendVisibleMask8(const VisibleLaneTable &table, uint32_t mask, uint32_t first, uint32_t* visible, uint32_t visibleCount) {
+  const __m256i lanes = _mm256_load_si256(reinterpret_cast<const __m256i*>(table.lanes[mask]));
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(visible + visibleCount), _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(first)), lanes));
+  return visibleCount + table.counts[mask];
+}
+
+// no FMA on purpose, fused results would differ from the other paths in the last bit
+VKS_TARGET_AVX2 uint32_t cullSpheresAVX2(const Frustum &frustum, const CullingBounds &bounds, uint32_t* visible) {
+
+  __m256 planes[6][4];
+  for (int p = 0; p < 6; ++p) {
+    for (int c = 0; c < 4; ++c) {
+      planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+    }
+  }
+
+  const __m256 signBit = _mm256_set1_ps(-0.0f);
+  const uint32_t simdCount = bounds.Size() & ~7u;
+  const VisibleLaneTable &laneTable = getVisibleLaneTable();
+  uint32_t visibleCount = 0;
+
+  for (uint32_t i = 0; i < simdCount; i += 8) {
+    const __m256 centerX = _mm256_loadu_ps(bounds.CenterX() + i);
+    const __m256 centerY = _mm256_loadu_ps(bounds.CenterY() + i);
+    const __m256 centerZ = _mm256_loadu_ps(bounds.CenterZ() + i);
+    const __m256 negativeRadius = _mm256_xor_ps(_mm256_loadu_ps(bounds.Radius() + i), signBit);
+
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int p = 0; p < 6; ++p) {
+      __m256 distance = _mm256_mul_ps(planes[p][0], centerX);
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(planes[p][1], centerY));
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(planes[p][2], centerZ));
+      distance = _mm256_add_ps(distance, planes[p][3]);
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+    }
+
+    visibleCount = appendVisibleMask8(laneTable, static_cast<uint32_t>(_mm256_movemask_ps(inside)), i, visible, visibleCount);
+  }
+
+  return cullSpheresScalar(frustum, bounds, simdCount, visible, visibleCount);
+}
+
+VKS_TARGET_AVX2 uint32_t cullBoxesAVX2(const Frustum &frustum, const CullingBounds &bounds, uint32_t* visible) {
+
+  BoxPlaneCorners corners[6];
+  pickBoxPlaneCorners(frustum, bounds, corners);
+
+  __m256 planes[6][4];
+  for (int p = 0; p < 6; ++p) {
+    for (int c = 0; c < 4; ++c) {
+      planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+    }
+  }
+
+  const __m256 zero = _mm256_setzero_ps();
+  const uint32_t simdCount = bounds.Size() & ~7u;
+  const VisibleLaneTable &laneTable = getVisibleLaneTable();
+  uint32_t visibleCount = 0;
+
+  for (uint32_t i = 0; i < simdCount; i += 8) {
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int p = 0; p < 6; ++p) {
+      __m256 distance = _mm256_mul_ps(planes[p][0], _mm256_loadu_ps(corners[p].x + i));
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(planes[p][1], _mm256_loadu_ps(corners[p].y + i)));
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(planes[p][2], _mm256_loadu_ps(corners[p].z + i)));
+      distance = _mm256_add_ps(distance, planes[p][3]);
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+    }
+
+    visibleCount = appendVisibleMask8(laneTable, static_cast<uint32_t>(_mm256_movemask_ps(inside)), i, visible, visibleCount);
+  }
+
+  return cullBoxesScalar(frustum, bounds, simdCount, visible, visibleCount);
+}
+
+VKS_TARGET_AVX2 uint32_t cullRectsAVX2(const RectPlanes &rectPlanes, const CullingRects &rects, uint32_t first, uint32_t end, uint32_t* visible) {
+
+  __m256 xPlanes[6][3];
+  __m256 yPlanes[6][3];
+  __m256 planes[6][5];
+  for (uint32_t p = 0; p < rectPlanes.xCount; ++p) {
+    for (int c = 0; c < 3; ++c) {
+      xPlanes[p][c] = _mm256_set1_ps(rectPlanes.xPlanes[p][c]);
+    }
+  }
+  for (uint32_t p = 0; p < rectPlanes.yCount; ++p) {
+    for (int c = 0; c < 3; ++c) {
+      yPlanes[p][c] = _mm256_set1_ps(rectPlanes.yPlanes[p][c]);
+    }
+  }
+  for (uint32_t p = 0; p < rectPlanes.count; ++p) {
+    for (int c = 0; c < 5; ++c) {
+      planes[p][c] = _mm256_set1_ps(rectPlanes.planes[p][c]);
+    }
+  }
+
+  const __m256 signBit = _mm256_set1_ps(-0.0f);
+  const __m256 zero = _mm256_setzero_ps();
+  const uint32_t simdEnd = first + ((end - first) & ~7u);
+  const VisibleLaneTable &laneTable = getVisibleLaneTable();
+  uint32_t visibleCount = 0;
+
+  for (uint32_t i = first; i < simdEnd; i += 8) {
+    const __m256 centerX = _mm256_loadu_ps(rects.centerX + i);
+    const __m256 centerY = _mm256_loadu_ps(rects.centerY + i);
+    const __m256 sizeX = _mm256_andnot_ps(signBit, _mm256_loadu_ps(rects.sizeX + i));
+    const __m256 sizeY = _mm256_andnot_ps(signBit, _mm256_loadu_ps(rects.sizeY + i));
+
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (uint32_t p = 0; p < rectPlanes.xCount; ++p) {
+      __m256 distance = _mm256_mul_ps(xPlanes[p][0], centerX);
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(xPlanes[p][1], sizeX));
+      distance = _mm256_add_ps(distance, xPlanes[p][2]);
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+    }
+    for (uint32_t p = 0; p < rectPlanes.yCount; ++p) {
+      __m256 distance = _mm256_mul_ps(yPlanes[p][0], centerY);
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(yPlanes[p][1], sizeY));
+      distance = _mm256_add_ps(distance, yPlanes[p][2]);
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+    }
+    for (uint32_t p = 0; p < rectPlanes.count; ++p) {
+      __m256 distance = _mm256_mul_ps(planes[p][0], centerX);
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(planes[p][1], centerY));
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(planes[p][2], sizeX));
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(planes[p][3], sizeY));
+      distance = _mm256_add_ps(distance, planes[p][4]);
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+    }
+
+    visibleCount = appendVisibleMask8(laneTable, static_cast<uint32_t>(_mm256_movemask_ps(inside)), i, visible, visibleCount);
+  }
+
+  return cullRectsScalar(rectPlanes, rects, simdEnd, end, visible, visibleCount);
+}
+
+bool detectAVX2() {
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) return false;
+
+  // the OS has to save the upper halves of the ymm registers on context switches
+  __cpuid(info, 1);
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool avx = (info[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) return false;
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  // also checks that the OS enabled the ymm state
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+bool IsCullingPathSupported(CullingPath path) {
+  switch (path) {
+    case kScalarCulling:
+      return true;
+#ifdef VKS_CULLING_X86
+    case kSSECulling:
+      return true;
+    case kAVX2Culling: {
+      static const bool supported = detectAVX2();
+      return supported;
+    }
+#endif
+    default:
+      return false;
+  }
+}
+
+CullingPath GetFastestCullingPath() {
+  if (IsCullingPathSupported(kAVX2Culling)) return kAVX2Culling;
+  if (IsCullingPathSupported(kSSECulling)) return kSSECulling;
+  return kScalarCulling;
+}
+
+const char* GetCullingPathName(CullingPath path) {
+  switch (path) {
+    case kScalarCulling: return "scalar";
+    case kSSECulling: return "SSE";
+    case kAVX2Culling: return "AVX2";
+    default: return "unknown";
+  }
+}
+
+uint32_t CullSpheres(const Frustum &frustum, const CullingBounds &bounds, uint32_t* visible, CullingPath path) {
+#ifdef VKS_CULLING_X86
+  if (path == kAVX2Culling && IsCullingPathSupported(kAVX2Culling)) {
+    return cullSpheresAVX2(frustum, bounds, visible);
+  }
+  if (path == kSSECulling) {
+    return cullSpheresSSE(frustum, bounds, visible);
+  }
+#endif
+  return cullSpheresScalar(frustum, bounds, 0, visible, 0);
+}
+
+uint32_t CullBoxes(const Frustum &frustum, const CullingBounds &bounds, uint32_t* visible, CullingPath path) {
+#ifdef VKS_CULLING_X86
+  if (path == kAVX2Culling && IsCullingPathSupported(kAVX2Culling)) {
+    return cullBoxesAVX2(frustum, bounds, visible);
+  }
+  if (path == kSSECulling) {
+    return cullBoxesSSE(frustum, bounds, visible);
+  }
+#endif
+  return cullBoxesScalar(frustum, bounds, 0, visible, 0);
+}
+
+uint32_t CullRects(const Frustum &frustum, const CullingRects &rects, uint32_t first, uint32_t end, uint32_t* visible, CullingPath path) {
+
+  const RectPlanes planes = prepareRectPlanes(frustum);
+  if (planes.rejectsAll || first >= end) {
+    return 0;
+  }
+
+#ifdef VKS_CULLING_X86
+  if (path == kAVX2Culling && IsCullingPathSupported(kAVX2Culling)) {
+    return cullRectsAVX2(planes, rects, first, end, visible);
+  }
+  if (path == kSSECulling) {
+    return cullRectsSSE(planes, rects, first, end, visible);
+  }
+#endif
+  return cullRectsScalar(planes, rects, first, end, visible, 0);
+}
+
+bool RunFrustumCullingBenchmark(uint32_t objectCount, uint32_t iterationCount) {
+
+  std::vector<uint32_t> objectCounts;
+  if (objectCount > 0) {
+    objectCounts.push_back(objectCount);
+  }
+  else {
+    objectCounts = { 100000, 1000000 };
+  }
+
+  // xorshift, the same scene on every run
+  uint32_t state = 1;
+  const auto random = [&](float low, float high) -> float {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return low + (high - low) * (static_cast<float>(state >> 8) / static_cast<float>(1 << 24));
+  };
+
+  // a panned and zoomed out view, so the frustum cuts through the scene on every side
+  const float view[4] = { 0.3f, -0.2f, 0.6f, 0.6f };
+  const Frustum frustum = MakeViewFrustum(view, 0.0f, 1.0f);
+
+  bool success = true;
+  for (uint32_t count : objectCounts) {
+
+    CullingBounds bounds;
+    bounds.Reserve(count);
+    // the same objects flattened onto z = 0, as a scene's transform columns would hold them
+    std::vector<float> rectColumns[4];
+    for (uint32_t i = 0; i < count; ++i) {
+      float center[3] = { random(-4.0f, 4.0f), random(-4.0f, 4.0f), random(-0.5f, 1.5f) };
+      float halfExtent = random(0.001f, 0.05f);
+      float boundsMin[3] = { center[0] - halfExtent, center[1] - halfExtent, center[2] - halfExtent };
+      float boundsMax[3] = { center[0] + halfExtent, center[1] + halfExtent, center[2] + halfExtent };
+      bounds.Add(center, halfExtent * 1.7320508f, boundsMin, boundsMax);
+
+      rectColumns[0].push_back(center[0]);
+      rectColumns[1].push_back(center[1]);
+      // every other one mirrored, like a flipped transform
+      rectColumns[2].push_back(i % 2 ? 2.0f * halfExtent : -2.0f * halfExtent);
+      rectColumns[3].push_back(2.0f * halfExtent);
+    }
+    const CullingRects rects = { rectColumns[0].data(), rectColumns[1].data(), rectColumns[2].data(), rectColumns[3].data() };
+
+    std::vector<uint32_t> expected[3];
+    for (auto &shapeExpected : expected) {
+      shapeExpected.resize(count);
+    }
+    expected[0].resize(CullSpheres(frustum, bounds, expected[0].data(), kScalarCulling));
+    expected[1].resize(CullBoxes(frustum, bounds, expected[1].data(), kScalarCulling));
+    expected[2].resize(CullRects(frustum, rects, 0, count, expected[2].data(), kScalarCulling));
+
+    std::vector<uint32_t> visible(count);
+    for (int path = 0; path < kCullingPathCount; ++path) {
+      const CullingPath cullingPath = static_cast<CullingPath>(path);
+      if (!IsCullingPathSupported(cullingPath)) {
+        std::cout << "Frustum culling " << GetCullingPathName(cullingPath) << ": not supported on this CPU" << std::endl;
+        continue;
+      }
+
+      for (int shape = 0; shape < 3; ++shape) {
+        const char* shapeNames[3] = { " spheres", " boxes", " rects" };
+        const auto cull = [&]() -> uint32_t {
+          switch (shape) {
+            case 0: return CullSpheres(frustum, bounds, visible.data(), cullingPath);
+            case 1: return CullBoxes(frustum, bounds, visible.data(), cullingPath);
+            default: return CullRects(frustum, rects, 0, count, visible.data(), cullingPath);
+          }
+        };
+
+        // untimed, also the result that is checked
+        uint32_t visibleCount = cull();
+        const std::vector<uint32_t> &shapeExpected = expected[shape];
+        if (visibleCount != shapeExpected.size() || !std::equal(shapeExpected.begin(), shapeExpected.end(), visible.begin())) {
+          std::cerr << "Frustum culling " << GetCullingPathName(cullingPath) << shapeNames[shape]
+            << " disagrees with the scalar path on " << count << " objects: "
+            << visibleCount << " visible instead of " << shapeExpected.size() << std::endl;
+          success = false;
+          continue;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t iteration = 0; iteration < iterationCount; ++iteration) {
+          visibleCount = cull();
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        double milliseconds = std::chrono::duration<double, std::milli>(end - start).count() / std::max(iterationCount, 1u);
+        std::cout << "Frustum culling " << GetCullingPathName(cullingPath) << shapeNames[shape] << ": "
+          << count << " objects, " << visibleCount << " visible, "
+          << milliseconds << " ms, " << (count / 1000.0) / std::max(milliseconds, 1e-6) << " M objects/s" << std::endl;
+      }
+    }
+  }
+
+  return success;
+}
+
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Frustum.h"
+
+namespace vks {
+
+enum CullingPath {
+  kScalarCulling = 0,
+  // 4 objects per iteration, always available on x86-64
+  kSSECulling,
+  // 8 objects per iteration, picked at runtime when the CPU and OS support it
+  kAVX2Culling,
+  kCullingPathCount,
+};
+
+// Bounding spheres and axis aligned boxes of every object, one array per component
+// so the SIMD kernels load 4 or 8 objects of the same component at once.
+class CullingBounds {
+  public:
+    void Clear();
+    void Reserve(uint32_t count);
+
+    // returns the object index
+    uint32_t Add(const float center[3], float radius, const float boundsMin[3], const float boundsMax[3]);
+    // for producers that fill the arrays in parallel through Set
+    void Resize(uint32_t count);
+    void Set(uint32_t index, const float center[3], float radius, const float boundsMin[3], const float boundsMax[3]) {
+      centerX_[index] = center[0];
+      centerY_[index] = center[1];
+      centerZ_[index] = center[2];
+      radius_[index] = radius;
+      minX_[index] = boundsMin[0];
+      minY_[index] = boundsMin[1];
+      minZ_[index] = boundsMin[2];
+      maxX_[index] = boundsMax[0];
+      maxY_[index] = boundsMax[1];
+      maxZ_[index] = boundsMax[2];
+    }
+
+    uint32_t Size() const { return static_cast<uint32_t>(radius_.size()); }
+
+    const float* CenterX() const { return centerX_.data(); }
+    const float* CenterY() const { return centerY_.data(); }
+    const float* CenterZ() const { return centerZ_.data(); }
+    const float* Radius() const { return radius_.data(); }
+    const float* MinX() const { return minX_.data(); }
+    const float* MinY() const { return minY_.data(); }
+    const float* MinZ() const { return minZ_.data(); }
+    const float* MaxX() const { return maxX_.data(); }
+    const float* MaxY() const { return maxY_.data(); }
+    const float* MaxZ() const { return maxZ_.data(); }
+
+  private:
+    std::vector<float> centerX_;
+    std::vector<float> centerY_;
+    std::vector<float> centerZ_;
+    std::vector<float> radius_;
+    std::vector<float> minX_;
+    std::vector<float> minY_;
+    std::vector<float> minZ_;
+    std::vector<float> maxX_;
+    std::vector<float> maxY_;
+    std::vector<float> maxZ_;
+};
+
+// Rectangles in the z = 0 plane, like the draws' [-0.5, 0.5] triangles under a DrawTransform: centered on
+// (centerX, centerY) and sizeX by sizeY large, negative sizes are mirrored. Points into arrays owned by the caller,
+// e.g. a scene's transform columns, so there are no bounds to keep up to date.
+struct CullingRects {
+  const float* centerX;
+  const float* centerY;
+  const float* sizeX;
+  const float* sizeY;
+};
+
+// the widest path this CPU supports, checked once
+CullingPath GetFastestCullingPath();
+bool IsCullingPathSupported(CullingPath path);
+const char* GetCullingPathName(CullingPath path);
+
+// Write the indices of the objects intersecting the frustum to visible in increasing order and return how many there are.
+// visible needs room for bounds.Size() entries. Every path does the same float operations in the same order,
+// so they agree exactly. Unsupported paths fall back to the scalar one.
+uint32_t CullSpheres(const Frustum &frustum, const CullingBounds &bounds, uint32_t* visible, CullingPath path);
+uint32_t CullBoxes(const Frustum &frustum, const CullingBounds &bounds, uint32_t* visible, CullingPath path);
+// Same for the rectangles [first, end), visible needs room for end - first entries and gets absolute indices.
+// Tests the corners CullBoxes would test on the rectangles' boxes, but reads 4 arrays instead of 6 and decides
+// the planes parallel to z = 0 once instead of per object.
+uint32_t CullRects(const Frustum &frustum, const CullingRects &rects, uint32_t first, uint32_t end, uint32_t* visible, CullingPath path);
+
+// Times every supported path on random bounds, 100k and 1M objects unless objectCount is given,
+// and checks that they all produce the scalar result. Returns false on a mismatch.
+bool RunFrustumCullingBenchmark(uint32_t objectCount, uint32_t iterationCount);
+
+}
@@ -1,4 +1,4 @@
-mkdir Assets
-C:/VulkanSDK/1.0.57.0/Bin32/glslangValidator.exe -V AssetsSource\test.vert -o Assets\test.vert.spv
-C:/VulkanSDK/1.0.57.0/Bin32/glslangValidator.exe -V AssetsSource\test.frag -o Assets\test.frag.spv
-pause
\ No newline at end of file
+@echo off
+rem compiles AssetsSource to Assets and packs it, see ProcessAssets.py --help for options
+python "%~dp0ProcessAssets.py" --pack "%~dp0Assets.pack" %*
+pause
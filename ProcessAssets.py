@@ -0,0 +1,361 @@
+#!/usr/bin/env python3
+"""Compiles the GLSL shaders in AssetsSource to SPIR-V in Assets.
+
+Shaders are compiled in parallel, and a shader is only recompiled when the hash of its
+source, everything it includes, the compiler and the compiler options changed.
+A dependency manifest listing every shader's includes is written next to the outputs.
+With --pack everything in the output directory is also packed into one archive that
+the engine memory maps, see AssetPack.h for the layout.
+"""
+
+import argparse
+import concurrent.futures
+import hashlib
+import json
+import os
+import re
+import shutil
+import struct
+import subprocess
+import sys
+
+SHADER_EXTENSIONS = (".vert", ".frag", ".comp", ".geom", ".tesc", ".tese")
+CACHE_FILE_NAME = ".shader_cache.json"
+MANIFEST_FILE_NAME = "shader_dependencies.json"
+# bump when the cache or manifest layout changes
+CACHE_VERSION = 1
+
+INCLUDE_PATTERN = re.compile(r'^\s*#\s*include\s+[<"]([^>"]+)[>"]', re.MULTILINE)
+
+# must match AssetPack.h
+PACK_MAGIC = 0x41534b56
+PACK_VERSION = 1
+PACK_ALIGNMENT = 16
+PACK_UNCOMPRESSED = 0
+PACK_LZ4_BLOCK = 1
+PACK_HEADER = struct.Struct("<IIIIQQ")
+PACK_ENTRY = struct.Struct("<QQQIIII")
+# compressed entries are only kept if they save at least this much
+PACK_MIN_COMPRESSION_RATIO = 0.9
+
+
+def find_compiler(requested):
+    if requested:
+        return requested
+
+    candidates = []
+    sdk = os.environ.get("VULKAN_SDK")
+    if sdk:
+        for bin_dir in ("Bin", "bin", "Bin32"):
+            candidates.append(os.path.join(sdk, bin_dir, "glslangValidator"))
+            candidates.append(os.path.join(sdk, bin_dir, "glslangValidator.exe"))
+
+    for candidate in candidates:
+        if os.path.isfile(candidate):
+            return candidate
+
+    return shutil.which("glslangValidator")
+
+
+def compiler_identity(compiler):
+    """Version output of the compiler, so upgrading it invalidates the cache."""
+    try:
+        result = subprocess.run([compiler, "--version"], stdout=subprocess.PIPE, stderr=subprocess.STDOUT, timeout=30)
+        return result.stdout.decode("utf-8", "replace")
+    except (OSError, subprocess.SubprocessError):
+        return compiler
+
+
+def resolve_include(name, including_dir, include_dirs):
+    for directory in [including_dir] + include_dirs:
+        path = os.path.normpath(os.path.join(directory, name))
+        if os.path.isfile(path):
+            return path
+    return None
+
+
+def collect_dependencies(source, include_dirs):
+    """Returns the source followed by every file it transitively includes, each once, in a stable order.
+    Includes that can't be found are left to the compiler to report."""
+    ordered = []
+    seen = set()
+    pending = [source]
+
+    while pending:
+        path = pending.pop()
+        if path in seen:
+            continue
+        seen.add(path)
+        ordered.append(path)
+
+        with open(path, "r", encoding="utf-8", errors="replace") as file:
+            text = file.read()
+
+        includes = []
+        for name in INCLUDE_PATTERN.findall(text):
+            resolved = resolve_include(name, os.path.dirname(path), include_dirs)
+            if resolved is not None:
+                includes.append(resolved)
+
+        # reversed so the stack pops them in file order
+        pending.extend(reversed(includes))
+
+    return ordered
+
+
+def hash_shader(dependencies, compiler_id, options):
+    digest = hashlib.sha256()
+    digest.update(compiler_id.encode("utf-8"))
+    digest.update("\0".join(options).encode("utf-8"))
+    for path in dependencies:
+        digest.update(b"\0")
+        digest.update(os.path.basename(path).encode("utf-8"))
+        with open(path, "rb") as file:
+            digest.update(file.read())
+    return digest.hexdigest()
+
+
+def compile_shader(compiler, options, source, output):
+    temporary_output = output + ".tmp"
+    command = [compiler] + options + [source, "-o", temporary_output]
+    result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+
+    if result.returncode != 0:
+        if os.path.exists(temporary_output):
+            os.remove(temporary_output)
+        return False, result.stdout.decode("utf-8", "replace")
+
+    os.replace(temporary_output, output)
+    return True, ""
+
+
+def lz4_compress_block(data):
+    """Greedy LZ4 block compressor, slow but simple, the decompressor is DecompressLZ4Block."""
+    size = len(data)
+    output = bytearray()
+
+    def write_length(length):
+        length -= 15
+        while length >= 255:
+            output.append(255)
+            length -= 255
+        output.append(length)
+
+    def write_sequence(literals, offset, match_length):
+        literal_length = len(literals)
+        token = min(literal_length, 15) << 4
+        if offset:
+            token |= min(match_length - 4, 15)
+        output.append(token)
+        if literal_length >= 15:
+            write_length(literal_length)
+        output.extend(literals)
+        if offset:
+            output.extend(struct.pack("<H", offset))
+            if match_length - 4 >= 15:
+                write_length(match_length - 4)
+
+    # the format requires the last 5 bytes to be literals and the last match to start 12 bytes before the end
+    match_limit = size - 12
+    last_literals = size - 5
+    table = {}
+    anchor = 0
+    position = 0
+
+    while position < match_limit:
+        key = data[position:position + 4]
+        candidate = table.get(key)
+        table[key] = position
+
+        if candidate is None or position - candidate > 0xFFFF:
+            position += 1
+            continue
+
+        match_length = 4
+        while position + match_length < last_literals and data[candidate + match_length] == data[position + match_length]:
+            match_length += 1
+
+        write_sequence(data[anchor:position], position - candidate, match_length)
+        position += match_length
+        anchor = position
+
+    write_sequence(data[anchor:], 0, 0)
+    return bytes(output)
+
+
+def write_pack(path, files, compress):
+    """files maps entry names to paths, names are stored sorted so the engine can binary search them."""
+    names = sorted(files)
+    encoded_names = [name.encode("utf-8") for name in names]
+
+    entries = []
+    blobs = []
+    for name in names:
+        with open(files[name], "rb") as file:
+            data = file.read()
+
+        compression = PACK_UNCOMPRESSED
+        stored = data
+        if compress and data:
+            compressed = lz4_compress_block(data)
+            if len(compressed) <= len(data) * PACK_MIN_COMPRESSION_RATIO:
+                compression = PACK_LZ4_BLOCK
+                stored = compressed
+
+        entries.append((len(stored), len(data), compression))
+        blobs.append(stored)
+
+    name_table_offset = PACK_HEADER.size + PACK_ENTRY.size * len(names)
+    name_table = b"".join(encoded_names)
+
+    def align(offset):
+        return (offset + PACK_ALIGNMENT - 1) // PACK_ALIGNMENT * PACK_ALIGNMENT
+
+    body = bytearray()
+    toc = bytearray()
+    offset = align(name_table_offset + len(name_table))
+    name_offset = 0
+    for encoded_name, (stored_size, size, compression), blob in zip(encoded_names, entries, blobs):
+        toc.extend(PACK_ENTRY.pack(offset, stored_size, size, name_offset, len(encoded_name), compression, 0))
+        name_offset += len(encoded_name)
+
+        body.extend(blob)
+        padding = align(offset + stored_size) - (offset + stored_size)
+        body.extend(b"\0" * padding)
+        offset += stored_size + padding
+
+    header = PACK_HEADER.pack(PACK_MAGIC, PACK_VERSION, len(names), PACK_ALIGNMENT, name_table_offset, len(name_table))
+    prefix = header + bytes(toc) + name_table
+    prefix += b"\0" * (align(len(prefix)) - len(prefix))
+
+    temporary_path = path + ".tmp"
+    with open(temporary_path, "wb") as file:
+        file.write(prefix)
+        file.write(body)
+    os.replace(temporary_path, path)
+
+    stored_bytes = sum(entry[0] for entry in entries)
+    raw_bytes = sum(entry[1] for entry in entries)
+    print("Packed {} files into {}, {} of {} bytes after compression".format(len(names), path, stored_bytes, raw_bytes))
+
+
+def load_json(path):
+    try:
+        with open(path, "r", encoding="utf-8") as file:
+            return json.load(file)
+    except (OSError, ValueError):
+        return None
+
+
+def write_json(path, value):
+    temporary_path = path + ".tmp"
+    with open(temporary_path, "w", encoding="utf-8") as file:
+        json.dump(value, file, indent=2, sort_keys=True)
+        file.write("\n")
+    os.replace(temporary_path, path)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    root = os.path.dirname(os.path.abspath(__file__))
+    parser.add_argument("--source", default=os.path.join(root, "AssetsSource"), help="directory with the GLSL sources")
+    parser.add_argument("--output", default=os.path.join(root, "Assets"), help="directory the SPIR-V is written to")
+    parser.add_argument("--compiler", help="glslangValidator to use, found through VULKAN_SDK or PATH by default")
+    parser.add_argument("-I", "--include", action="append", default=[], dest="include_dirs", help="additional include directory")
+    parser.add_argument("-j", "--jobs", type=int, default=os.cpu_count() or 1, help="number of shaders compiled in parallel")
+    parser.add_argument("--force", action="store_true", help="ignore the cache and recompile everything")
+    parser.add_argument("--pack", help="also write every file in the output directory into this asset pack")
+    parser.add_argument("--compress", action="store_true", help="LZ4 compress pack entries where it pays off")
+    args = parser.parse_args()
+
+    compiler = find_compiler(args.compiler)
+    if compiler is None:
+        print("glslangValidator not found, set VULKAN_SDK, add it to PATH or pass --compiler", file=sys.stderr)
+        return 1
+
+    source_dir = os.path.abspath(args.source)
+    output_dir = os.path.abspath(args.output)
+    include_dirs = [os.path.abspath(directory) for directory in args.include_dirs]
+    os.makedirs(output_dir, exist_ok=True)
+
+    options = ["-V"] + ["-I" + directory for directory in include_dirs]
+    compiler_id = compiler_identity(compiler)
+
+    cache_path = os.path.join(output_dir, CACHE_FILE_NAME)
+    cache = load_json(cache_path)
+    if args.force or not isinstance(cache, dict) or cache.get("version") != CACHE_VERSION:
+        cache = {"version": CACHE_VERSION, "shaders": {}}
+
+    sources = []
+    for directory, _, files in os.walk(source_dir):
+        for name in sorted(files):
+            if name.endswith(SHADER_EXTENSIONS):
+                sources.append(os.path.join(directory, name))
+    sources.sort()
+
+    manifest = {}
+    new_cache_entries = {}
+    jobs = []
+
+    for source in sources:
+        relative_source = os.path.relpath(source, source_dir)
+        output = os.path.join(output_dir, relative_source + ".spv")
+        relative_output = os.path.relpath(output, output_dir).replace(os.sep, "/")
+
+        dependencies = collect_dependencies(source, include_dirs)
+        shader_hash = hash_shader(dependencies, compiler_id, options)
+
+        manifest[relative_output] = {
+            "source": os.path.relpath(source, root).replace(os.sep, "/"),
+            "includes": [os.path.relpath(path, root).replace(os.sep, "/") for path in dependencies[1:]],
+            "hash": shader_hash,
+        }
+
+        if cache["shaders"].get(relative_output) == shader_hash and os.path.isfile(output):
+            new_cache_entries[relative_output] = shader_hash
+            continue
+
+        os.makedirs(os.path.dirname(output), exist_ok=True)
+        jobs.append((relative_source, relative_output, output, source, shader_hash))
+
+    failures = 0
+    with concurrent.futures.ThreadPoolExecutor(max_workers=max(args.jobs, 1)) as executor:
+        futures = {
+            executor.submit(compile_shader, compiler, options, source, output): (relative_source, relative_output, shader_hash)
+            for relative_source, relative_output, output, source, shader_hash in jobs
+        }
+
+        for future in concurrent.futures.as_completed(futures):
+            relative_source, relative_output, shader_hash = futures[future]
+            success, log = future.result()
+            if success:
+                new_cache_entries[relative_output] = shader_hash
+                print("Compiled " + relative_source)
+            else:
+                failures += 1
+                print("Failed to compile " + relative_source + ":\n" + log, file=sys.stderr)
+
+    # failed shaders stay out of the cache so they are retried next time
+    cache["shaders"] = new_cache_entries
+    write_json(cache_path, cache)
+    write_json(os.path.join(output_dir, MANIFEST_FILE_NAME), {"version": CACHE_VERSION, "shaders": manifest})
+
+    print("{} shaders, {} compiled, {} up to date, {} failed".format(
+        len(sources), len(jobs) - failures, len(sources) - len(jobs), failures))
+
+    if args.pack and not failures:
+        pack_path = os.path.abspath(args.pack)
+        files = {}
+        for directory, _, names in os.walk(output_dir):
+            for name in names:
+                path = os.path.join(directory, name)
+                if name in (CACHE_FILE_NAME, MANIFEST_FILE_NAME) or name.endswith(".tmp") or path == pack_path:
+                    continue
+                files[os.path.relpath(path, output_dir).replace(os.sep, "/")] = path
+        write_pack(pack_path, files, args.compress)
+
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,352 @@
+#include "Scene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(_M_X64)
+// always there on x86-64, no runtime check needed
+#define VKS_SCENE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace vks {
+
+const uint32_t Scene::kChunkSize;
+const uint32_t Scene::kDeadSlot;
+
+void Scene::Reserve(uint32_t count) {
+  slotRows_.reserve(count);
+  slotGenerations_.reserve(count);
+  rowSlots_.reserve(count);
+  for (auto* column : { &offsetX_, &offsetY_, &scaleX_, &scaleY_, &velocityX_, &velocityY_ }) {
+    column->reserve(count);
+  }
+  materialIds_.reserve(count);
+}
+
+void Scene::Clear() {
+  // generations survive so old handles stay dead
+  for (uint32_t slot = 0; slot < slotRows_.size(); ++slot) {
+    if (slotRows_[slot] != kDeadSlot) {
+      slotRows_[slot] = kDeadSlot;
+      slotGenerations_[slot]++;
+      freeSlots_.push_back(slot);
+    }
+  }
+
+  rowSlots_.clear();
+  for (auto* column : { &offsetX_, &offsetY_, &scaleX_, &scaleY_, &velocityX_, &velocityY_ }) {
+    column->clear();
+  }
+  materialIds_.clear();
+}
+
+SceneEntity Scene::CreateEntity(const DrawTransform &transform, uint32_t materialId) {
+
+  uint32_t slot;
+  if (!freeSlots_.empty()) {
+    slot = freeSlots_.back();
+    freeSlots_.pop_back();
+  }
+  else {
+    slot = static_cast<uint32_t>(slotRows_.size());
+    slotRows_.push_back(kDeadSlot);
+    slotGenerations_.push_back(0);
+  }
+
+  const uint32_t row = Size();
+  slotRows_[slot] = row;
+  rowSlots_.push_back(slot);
+
+  offsetX_.push_back(transform.offsetX);
+  offsetY_.push_back(transform.offsetY);
+  scaleX_.push_back(transform.scaleX);
+  scaleY_.push_back(transform.scaleY);
+  velocityX_.push_back(0.0f);
+  velocityY_.push_back(0.0f);
+  materialIds_.push_back(materialId);
+
+  return { slot, slotGenerations_[slot] };
+}
+
+bool Scene::DestroyEntity(SceneEntity entity) {
+
+  if (!IsAlive(entity)) {
+    return false;
+  }
+
+  const uint32_t row = slotRows_[entity.slot];
+  const uint32_t lastRow = Size() - 1;
+
+  // move the last row into the hole, only its slot has to learn about it
+  if (row != lastRow) {
+    const uint32_t movedSlot = rowSlots_[lastRow];
+    rowSlots_[row] = movedSlot;
+    slotRows_[movedSlot] = row;
+
+    offsetX_[row] = offsetX_[lastRow];
+    offsetY_[row] = offsetY_[lastRow];
+    scaleX_[row] = scaleX_[lastRow];
+    scaleY_[row] = scaleY_[lastRow];
+    velocityX_[row] = velocityX_[lastRow];
+    velocityY_[row] = velocityY_[lastRow];
+    materialIds_[row] = materialIds_[lastRow];
+  }
+
+  rowSlots_.pop_back();
+  for (auto* column : { &offsetX_, &offsetY_, &scaleX_, &scaleY_, &velocityX_, &velocityY_ }) {
+    column->pop_back();
+  }
+  materialIds_.pop_back();
+
+  slotRows_[entity.slot] = kDeadSlot;
+  slotGenerations_[entity.slot]++;
+  freeSlots_.push_back(entity.slot);
+
+  return true;
+}
+
+bool Scene::IsAlive(SceneEntity entity) const {
+  return entity.slot < slotRows_.size() &&
+    slotRows_[entity.slot] != kDeadSlot &&
+    slotGenerations_[entity.slot] == entity.generation;
+}
+
+void Scene::SetTransform(SceneEntity entity, const DrawTransform &transform) {
+  const uint32_t row = slotRows_[entity.slot];
+  offsetX_[row] = transform.offsetX;
+  offsetY_[row] = transform.offsetY;
+  scaleX_[row] = transform.scaleX;
+  scaleY_[row] = transform.scaleY;
+}
+
+DrawTransform Scene::GetTransform(SceneEntity entity) const {
+  const uint32_t row = slotRows_[entity.slot];
+  return { offsetX_[row], offsetY_[row], scaleX_[row], scaleY_[row] };
+}
+
+void Scene::SetVelocity(SceneEntity entity, float velocityX, float velocityY) {
+  const uint32_t row = slotRows_[entity.slot];
+  velocityX_[row] = velocityX;
+  velocityY_[row] = velocityY;
+}
+
+void Scene::SetMaterial(SceneEntity entity, uint32_t materialId) {
+  materialIds_[slotRows_[entity.slot]] = materialId;
+}
+
+template<typename F>
+void Scene::forEachChunk(uint32_t rowCount, WorkerPool* workers, const F &func) const {
+
+  const uint32_t chunkCount = (rowCount + kChunkSize - 1) / kChunkSize;
+  if (workers == nullptr || chunkCount <= 1) {
+    func(0u, rowCount);
+    return;
+  }
+
+  workers->ParallelFor(chunkCount, [&](uint32_t chunk, uint32_t) {
+    const uint32_t firstRow = chunk * kChunkSize;
+    func(firstRow, std::min(firstRow + kChunkSize, rowCount));
+  });
+}
+
+void Scene::UpdateTransforms(float deltaSeconds, float worldExtent, WorkerPool* workers) {
+
+  float* offsetX = offsetX_.data();
+  float* offsetY = offsetY_.data();
+  const float* velocityX = velocityX_.data();
+  const float* velocityY = velocityY_.data();
+  const float worldSize = 2.0f * worldExtent;
+
+  forEachChunk(Size(), workers, [&](uint32_t firstRow, uint32_t endRow) {
+    uint32_t row = firstRow;
+
+#ifdef VKS_SCENE_SSE2
+    // compilers won't turn the selects below into SIMD on their own since float compares can trap
+    const __m128 delta = _mm_set1_ps(deltaSeconds);
+    const __m128 upper = _mm_set1_ps(worldExtent);
+    const __m128 lower = _mm_set1_ps(-worldExtent);
+    const __m128 size = _mm_set1_ps(worldSize);
+    for (; row + 4 <= endRow; row += 4) {
+      __m128 x = _mm_add_ps(_mm_loadu_ps(offsetX + row), _mm_mul_ps(_mm_loadu_ps(velocityX + row), delta));
+      __m128 y = _mm_add_ps(_mm_loadu_ps(offsetY + row), _mm_mul_ps(_mm_loadu_ps(velocityY + row), delta));
+
+      x = _mm_sub_ps(x, _mm_and_ps(_mm_cmpgt_ps(x, upper), size));
+      x = _mm_add_ps(x, _mm_and_ps(_mm_cmplt_ps(x, lower), size));
+      y = _mm_sub_ps(y, _mm_and_ps(_mm_cmpgt_ps(y, upper), size));
+      y = _mm_add_ps(y, _mm_and_ps(_mm_cmplt_ps(y, lower), size));
+
+      _mm_storeu_ps(offsetX + row, x);
+      _mm_storeu_ps(offsetY + row, y);
+    }
+#endif
+
+    for (; row < endRow; ++row) {
+      float x = offsetX[row] + velocityX[row] * deltaSeconds;
+      float y = offsetY[row] + velocityY[row] * deltaSeconds;
+
+      x = x > worldExtent ? x - worldSize : x;
+      x = x < -worldExtent ? x + worldSize : x;
+      y = y > worldExtent ? y - worldSize : y;
+      y = y < -worldExtent ? y + worldSize : y;
+
+      offsetX[row] = x;
+      offsetY[row] = y;
+    }
+  });
+}
+
+void Scene::Cull(const Frustum &frustum, CullingPath path, std::vector<uint32_t> &visibleRows, WorkerPool* workers) const {
+
+  // the triangle spans [-0.5, 0.5] before scaling, so the scale is the size of its bounding rectangle
+  const CullingRects rects = { offsetX_.data(), offsetY_.data(), scaleX_.data(), scaleY_.data() };
+  const uint32_t rowCount = Size();
+  visibleRows.resize(rowCount);
+
+  // every chunk writes its visible rows to the start of its own range, which are then moved together in order
+  std::vector<uint32_t> chunkVisibleCounts((rowCount + kChunkSize - 1) / kChunkSize);
+  forEachChunk(rowCount, workers, [&](uint32_t firstRow, uint32_t endRow) {
+    chunkVisibleCounts[firstRow / kChunkSize] = CullRects(frustum, rects, firstRow, endRow, visibleRows.data() + firstRow, path);
+  });
+
+  uint32_t visibleCount = 0;
+  for (uint32_t chunk = 0; chunk < chunkVisibleCounts.size(); ++chunk) {
+    const uint32_t firstRow = chunk * kChunkSize;
+    if (firstRow != visibleCount) {
+      memmove(visibleRows.data() + visibleCount, visibleRows.data() + firstRow, chunkVisibleCounts[chunk] * sizeof(uint32_t));
+    }
+    visibleCount += chunkVisibleCounts[chunk];
+  }
+
+  visibleRows.resize(visibleCount);
+}
+
+void Scene::BuildDrawList(const std::vector<uint32_t> &rows, DrawList &drawList, WorkerPool* workers) const {
+
+  const uint32_t drawCount = static_cast<uint32_t>(rows.size());
+  drawList.Resize(drawCount);
+
+  DrawTransform* transforms = drawList.MutableTransforms();
+  uint32_t* materialIds = drawList.MutableMaterialIds();
+
+  forEachChunk(drawCount, workers, [&](uint32_t firstDraw, uint32_t endDraw) {
+    for (uint32_t draw = firstDraw; draw < endDraw; ++draw) {
+      const uint32_t row = rows[draw];
+      transforms[draw] = { offsetX_[row], offsetY_[row], scaleX_[row], scaleY_[row] };
+      materialIds[draw] = materialIds_[row];
+    }
+  });
+}
+
+void PopulateMovingScene(Scene &scene, uint32_t entityCount, float worldExtent, uint32_t seed) {
+
+  // xorshift, the same scene on every run
+  uint32_t state = seed != 0 ? seed : 1;
+  const auto random = [&](float low, float high) -> float {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return low + (high - low) * (static_cast<float>(state >> 8) / static_cast<float>(1 << 24));
+  };
+
+  scene.Reserve(scene.Size() + entityCount);
+  for (uint32_t i = 0; i < entityCount; ++i) {
+    const float scale = random(0.01f, 0.04f);
+    SceneEntity entity = scene.CreateEntity(
+      { random(-worldExtent, worldExtent), random(-worldExtent, worldExtent), scale, scale },
+      i % 4);
+    scene.SetVelocity(entity, random(-0.2f, 0.2f), random(-0.2f, 0.2f));
+  }
+}
+
+bool RunSceneBenchmark(uint32_t entityCount, uint32_t frameCount) {
+
+  const float kWorldExtent = 2.0f;
+  const float view[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+  const Frustum frustum = MakeViewFrustum(view, 0.0f, 1.0f);
+  const CullingPath cullingPath = GetFastestCullingPath();
+
+  WorkerPool workers;
+  workers.Start(0);
+
+  bool success = true;
+  for (int threaded = 0; threaded < 2 && success; ++threaded) {
+    WorkerPool* pool = threaded ? &workers : nullptr;
+
+    Scene scene;
+    PopulateMovingScene(scene, entityCount, kWorldExtent, 1);
+
+    // the churn needs handles, populated entities are never destroyed through them but still count
+    std::vector<SceneEntity> entities;
+    const uint32_t churnCount = std::max(entityCount / 100, 1u);
+    for (uint32_t i = 0; i < churnCount; ++i) {
+      entities.push_back(scene.CreateEntity({ 0.0f, 0.0f, 0.02f, 0.02f }, i % 4));
+      scene.SetVelocity(entities.back(), 0.1f, -0.05f);
+    }
+
+    std::vector<uint32_t> visibleRows;
+    DrawList drawList;
+
+    double systemMilliseconds[3] = {};
+    const char* systemNames[3] = { "transforms", "cull", "draw list" };
+
+    for (uint32_t frame = 0; frame <= frameCount && success; ++frame) {
+
+      // churn, destroys and recreates 1% of the entities
+      for (uint32_t i = 0; i < churnCount; ++i) {
+        SceneEntity &entity = entities[i];
+        SceneEntity destroyed = entity;
+        scene.DestroyEntity(destroyed);
+        entity = scene.CreateEntity({ 0.0f, 0.0f, 0.02f, 0.02f }, frame % 4);
+        scene.SetVelocity(entity, -0.1f, 0.05f);
+
+        if (scene.IsAlive(destroyed) || !scene.IsAlive(entity)) {
+          std::cerr << "Scene benchmark: a destroyed handle still resolves or a new one doesn't" << std::endl;
+          success = false;
+          break;
+        }
+      }
+
+      auto t0 = std::chrono::high_resolution_clock::now();
+      scene.UpdateTransforms(1.0f / 60.0f, kWorldExtent, pool);
+      auto t1 = std::chrono::high_resolution_clock::now();
+      scene.Cull(frustum, cullingPath, visibleRows, pool);
+      auto t2 = std::chrono::high_resolution_clock::now();
+      scene.BuildDrawList(visibleRows, drawList, pool);
+      auto t3 = std::chrono::high_resolution_clock::now();
+
+      // frame 0 warms up caches and grows the output arrays
+      if (frame > 0) {
+        systemMilliseconds[0] += std::chrono::duration<double, std::milli>(t1 - t0).count();
+        systemMilliseconds[1] += std::chrono::duration<double, std::milli>(t2 - t1).count();
+        systemMilliseconds[2] += std::chrono::duration<double, std::milli>(t3 - t2).count();
+      }
+    }
+
+    if (scene.Size() != entityCount + churnCount) {
+      std::cerr << "Scene benchmark: ended with " << scene.Size() << " entities instead of " << entityCount + churnCount << std::endl;
+      success = false;
+    }
+
+    if (!success) {
+      break;
+    }
+
+    double totalMicroseconds = 0.0;
+    std::cout << "Scene systems, " << entityCount << " entities, "
+      << (threaded ? workers.ThreadCount() : 1) << " threads, " << visibleRows.size() << " visible:";
+    for (int system = 0; system < 3; ++system) {
+      double microseconds = 1000.0 * systemMilliseconds[system] / std::max(frameCount, 1u);
+      totalMicroseconds += microseconds;
+      std::cout << " " << systemNames[system] << " " << microseconds << " us";
+    }
+    std::cout << ", total " << totalMicroseconds << " us per frame" << std::endl;
+  }
+
+  workers.Stop();
+  return success;
+}
+
+}
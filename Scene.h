@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "DrawList.h"
+#include "Frustum.h"
+#include "FrustumCulling.h"
+#include "WorkerPool.h"
+
+namespace vks {
+
+// Stable reference to an entity. The generation changes whenever the slot is reused,
+// so handles to destroyed entities never resolve to a newer one.
+struct SceneEntity {
+  uint32_t slot;
+  uint32_t generation;
+};
+
+const SceneEntity kNullSceneEntity = { ~0u, 0 };
+
+// Sparse set entity store for everything the renderer draws. Every entity has the same components,
+// kept in dense struct of arrays columns: transform (a DrawTransform), velocity and material. World bounds aren't
+// stored, culling derives them from the transform columns it has to read anyway.
+// Handles map to dense rows through a sparse slot table, create and destroy are O(1), destroy moves
+// the last row into the hole so the columns stay tightly packed.
+//
+// The systems walk the columns linearly and split them into kChunkSize row chunks over a WorkerPool
+// when one is given. Nothing here is thread safe beyond that.
+class Scene {
+  public:
+    static const uint32_t kChunkSize = 4096;
+
+    void Reserve(uint32_t count);
+    void Clear();
+
+    SceneEntity CreateEntity(const DrawTransform &transform, uint32_t materialId);
+    // returns false if the entity was already destroyed
+    bool DestroyEntity(SceneEntity entity);
+    bool IsAlive(SceneEntity entity) const;
+
+    // entity has to be alive
+    void SetTransform(SceneEntity entity, const DrawTransform &transform);
+    DrawTransform GetTransform(SceneEntity entity) const;
+    void SetVelocity(SceneEntity entity, float velocityX, float velocityY);
+    void SetMaterial(SceneEntity entity, uint32_t materialId);
+
+    uint32_t Size() const { return static_cast<uint32_t>(rowSlots_.size()); }
+
+    // moves every entity by its velocity and wraps it around the square [-worldExtent, worldExtent]
+    void UpdateTransforms(float deltaSeconds, float worldExtent, WorkerPool* workers);
+    // writes the rows whose triangle, [-0.5, 0.5] scaled and offset by its transform, intersects frustum to visibleRows,
+    // in increasing order
+    void Cull(const Frustum &frustum, CullingPath path, std::vector<uint32_t> &visibleRows, WorkerPool* workers) const;
+    // replaces drawList with the given rows
+    void BuildDrawList(const std::vector<uint32_t> &rows, DrawList &drawList, WorkerPool* workers) const;
+
+  private:
+    static const uint32_t kDeadSlot = ~0u;
+
+    // runs func(firstRow, endRow) over chunks of rowCount rows
+    template<typename F>
+    void forEachChunk(uint32_t rowCount, WorkerPool* workers, const F &func) const;
+
+    // sparse side, indexed by slot
+    std::vector<uint32_t> slotRows_;
+    std::vector<uint32_t> slotGenerations_;
+    std::vector<uint32_t> freeSlots_;
+
+    // dense side, indexed by row
+    std::vector<uint32_t> rowSlots_;
+    std::vector<float> offsetX_;
+    std::vector<float> offsetY_;
+    std::vector<float> scaleX_;
+    std::vector<float> scaleY_;
+    std::vector<float> velocityX_;
+    std::vector<float> velocityY_;
+    std::vector<uint32_t> materialIds_;
+};
+
+// Populates a scene with entityCount moving entities and times the per frame systems single threaded and
+// on a worker pool, with 1% of the entities destroyed and recreated every frame. Also checks that handles
+// of destroyed entities stop resolving. Returns false if they don't.
+bool RunSceneBenchmark(uint32_t entityCount, uint32_t frameCount);
+
+// Deterministic field of small moving triangles over [-worldExtent, worldExtent], for demos and benchmarks.
+void PopulateMovingScene(Scene &scene, uint32_t entityCount, float worldExtent, uint32_t seed);
+
+}
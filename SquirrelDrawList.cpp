@@ -0,0 +1,213 @@
+#include "SquirrelDrawList.h"
+
+#ifdef VKS_WITH_SQUIRREL
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include <sqstdblob.h>
+
+namespace vks {
+
+SquirrelDrawListBinding &getBinding(HSQUIRRELVM vm) {
+  return *static_cast<SquirrelDrawListBinding*>(sq_getforeignptr(vm));
+}
+
+SQInteger squirrelDrawObject(HSQUIRRELVM vm) {
+  SQFloat x, y, scaleX, scaleY;
+  SQInteger materialId;
+  sq_getfloat(vm, 2, &x);
+  sq_getfloat(vm, 3, &y);
+  sq_getfloat(vm, 4, &scaleX);
+  sq_getfloat(vm, 5, &scaleY);
+  sq_getinteger(vm, 6, &materialId);
+
+  DrawTransform transform = {
+    static_cast<float>(x),
+    static_cast<float>(y),
+    static_cast<float>(scaleX),
+    static_cast<float>(scaleY)
+  };
+  getBinding(vm).drawList->Add(transform, static_cast<uint32_t>(materialId));
+
+  return 0;
+}
+
+// copies the first count numbers of the array or blob at index into output
+template<typename T>
+bool readSquirrelNumbers(HSQUIRRELVM vm, SQInteger index, SQInteger count, std::vector<T> &output) {
+
+  output.resize(static_cast<size_t>(count));
+
+  if (sq_gettype(vm, index) == OT_INSTANCE) {
+    SQUserPointer blobData;
+    if (SQ_FAILED(sqstd_getblob(vm, index, &blobData)) || sqstd_getblobsize(vm, index) < count * SQInteger(sizeof(T))) {
+      return false;
+    }
+
+    memcpy(output.data(), blobData, static_cast<size_t>(count) * sizeof(T));
+    return true;
+  }
+
+  if (sq_getsize(vm, index) < count) {
+    return false;
+  }
+
+  // walking with sq_next stays on the C side, no script code runs per element
+  SQInteger i = 0;
+  sq_pushnull(vm);
+  while (i < count && SQ_SUCCEEDED(sq_next(vm, index))) {
+    SQFloat value;
+    if (SQ_FAILED(sq_getfloat(vm, -1, &value))) {
+      sq_pop(vm, 3);
+      return false;
+    }
+    output[static_cast<size_t>(i++)] = static_cast<T>(value);
+    sq_pop(vm, 2);
+  }
+  sq_pop(vm, 1);
+
+  return true;
+}
+
+SQInteger squirrelSubmitDrawList(HSQUIRRELVM vm) {
+  SquirrelDrawListBinding &binding = getBinding(vm);
+
+  SQInteger count;
+  sq_getinteger(vm, 4, &count);
+  if (count < 0) {
+    return sq_throwerror(vm, _SC("submitDrawList: negative count"));
+  }
+
+  if (!readSquirrelNumbers(vm, 2, count * 4, binding.transformScratch)) {
+    return sq_throwerror(vm, _SC("submitDrawList: transforms must hold 4 numbers per draw"));
+  }
+
+  if (!readSquirrelNumbers(vm, 3, count, binding.materialIdScratch)) {
+    return sq_throwerror(vm, _SC("submitDrawList: materialIds must hold one integer per draw"));
+  }
+
+  binding.drawList->Assign(binding.transformScratch.data(), binding.materialIdScratch.data(), static_cast<uint32_t>(count));
+
+  return 0;
+}
+
+void registerSquirrelFunction(HSQUIRRELVM vm, const SQChar* name, SQFUNCTION function, SQInteger paramCount, const SQChar* typeMask) {
+  sq_pushstring(vm, name, -1);
+  sq_newclosure(vm, function, 0);
+  sq_setparamscheck(vm, paramCount, typeMask);
+  sq_setnativeclosurename(vm, -1, name);
+  sq_newslot(vm, -3, SQFalse);
+}
+
+void RegisterSquirrelDrawListBindings(HSQUIRRELVM vm, SquirrelDrawListBinding &binding) {
+  sq_setforeignptr(vm, &binding);
+
+  sq_pushroottable(vm);
+  sqstd_register_bloblib(vm);
+  registerSquirrelFunction(vm, _SC("drawObject"), squirrelDrawObject, 6, _SC(".nnnni"));
+  registerSquirrelFunction(vm, _SC("submitDrawList"), squirrelSubmitDrawList, 4, _SC(".a|xa|xi"));
+  sq_pop(vm, 1);
+}
+
+// same object animation in both paths, only the way it reaches the engine differs
+const SQChar* kSquirrelDrawListBenchmarkScript = _SC(
+  "function perCallFrame(objectCount, frame) {\n"
+  "  for (local i = 0; i < objectCount; i++) {\n"
+  "    local t = (i + frame) % 1000 * 0.001;\n"
+  "    drawObject(t * 2.0 - 1.0, 1.0 - t * 2.0, 0.05, 0.05, i % 4);\n"
+  "  }\n"
+  "}\n"
+  "transforms <- [];\n"
+  "materialIds <- [];\n"
+  "function batchedFrame(objectCount, frame) {\n"
+  "  transforms.resize(objectCount * 4);\n"
+  "  materialIds.resize(objectCount);\n"
+  "  for (local i = 0; i < objectCount; i++) {\n"
+  "    local t = (i + frame) % 1000 * 0.001;\n"
+  "    local base = i * 4;\n"
+  "    transforms[base] = t * 2.0 - 1.0;\n"
+  "    transforms[base + 1] = 1.0 - t * 2.0;\n"
+  "    transforms[base + 2] = 0.05;\n"
+  "    transforms[base + 3] = 0.05;\n"
+  "    materialIds[i] = i % 4;\n"
+  "  }\n"
+  "  submitDrawList(transforms, materialIds, objectCount);\n"
+  "}\n");
+
+bool callSquirrelFrameFunction(HSQUIRRELVM vm, const SQChar* name, uint32_t objectCount, uint32_t frame) {
+  SQInteger top = sq_gettop(vm);
+
+  sq_pushroottable(vm);
+  sq_pushstring(vm, name, -1);
+  bool success = SQ_SUCCEEDED(sq_get(vm, -2));
+  if (success) {
+    sq_pushroottable(vm);
+    sq_pushinteger(vm, objectCount);
+    sq_pushinteger(vm, frame);
+    success = SQ_SUCCEEDED(sq_call(vm, 3, SQFalse, SQTrue));
+  }
+
+  sq_settop(vm, top);
+  return success;
+}
+
+bool RunSquirrelDrawListBenchmark(uint32_t objectCount, uint32_t frameCount) {
+
+  DrawList drawList;
+  drawList.Reserve(objectCount);
+
+  SquirrelDrawListBinding binding;
+  binding.drawList = &drawList;
+
+  HSQUIRRELVM vm = sq_open(1024);
+  RegisterSquirrelDrawListBindings(vm, binding);
+
+  bool success = SQ_SUCCEEDED(sq_compilebuffer(vm, kSquirrelDrawListBenchmarkScript, scstrlen(kSquirrelDrawListBenchmarkScript), _SC("benchmark"), SQTrue));
+  if (success) {
+    sq_pushroottable(vm);
+    success = SQ_SUCCEEDED(sq_call(vm, 1, SQFalse, SQTrue));
+    sq_pop(vm, 1);
+  }
+
+  const SQChar* frameFunctions[] = { _SC("perCallFrame"), _SC("batchedFrame") };
+  const char* pathNames[] = { "per object calls", "batched draw list" };
+
+  for (int path = 0; path < 2 && success; ++path) {
+
+    // one untimed frame so array growth and first touch don't count
+    drawList.Clear();
+    success = callSquirrelFrameFunction(vm, frameFunctions[path], objectCount, 0);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t frame = 1; frame <= frameCount && success; ++frame) {
+      drawList.Clear();
+      success = callSquirrelFrameFunction(vm, frameFunctions[path], objectCount, frame);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    if (success && drawList.Size() != objectCount) {
+      std::cerr << "Squirrel draw list benchmark produced " << drawList.Size() << " draws instead of " << objectCount << std::endl;
+      success = false;
+    }
+
+    if (success) {
+      double frameMilliseconds = std::chrono::duration<double, std::milli>(end - start).count() / std::max(frameCount, 1u);
+      std::cout << "Squirrel " << pathNames[path] << ": " << objectCount << " objects, "
+        << frameMilliseconds << " ms per frame" << std::endl;
+    }
+  }
+
+  if (!success) {
+    std::cerr << "Squirrel draw list benchmark script failed" << std::endl;
+  }
+
+  sq_close(vm);
+  return success;
+}
+
+}
+
+#endif
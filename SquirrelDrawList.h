@@ -0,0 +1,36 @@
+#pragma once
+
+#ifdef VKS_WITH_SQUIRREL
+
+#include <cstdint>
+#include <vector>
+
+#include <squirrel.h>
+
+#include "DrawList.h"
+
+namespace vks {
+
+// what the natives reach through the VM's foreign pointer, must outlive the VM
+struct SquirrelDrawListBinding {
+  DrawList* drawList = nullptr;
+  // reused between frames so the batched path doesn't allocate
+  std::vector<float> transformScratch;
+  std::vector<uint32_t> materialIdScratch;
+};
+
+// Registers into the root table:
+//   drawObject(x, y, scaleX, scaleY, materialId)     one native call per object
+//   submitDrawList(transforms, materialIds, count)   one native call per frame, transforms holds
+//                                                    4 numbers per draw, both arrays or blobs
+// Also registers the blob library. Sets binding as the VM's foreign pointer.
+void RegisterSquirrelDrawListBindings(HSQUIRRELVM vm, SquirrelDrawListBinding &binding);
+
+// Fills a draw list with objectCount scripted objects for frameCount frames, once through
+// drawObject and once through submitDrawList, and prints the average per frame time of each.
+// Returns false if the benchmark script failed.
+bool RunSquirrelDrawListBenchmark(uint32_t objectCount, uint32_t frameCount);
+
+}
+
+#endif
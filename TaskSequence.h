@@ -1,8 +1,17 @@
 #pragma once
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
-#include <functional>
 
 namespace tsk {
 
@@ -17,18 +26,55 @@ const TaskResult kTaskSuccess = {
   true
 };
 
+struct TaskTiming {
+  int taskIndex;
+  std::string description;
+  // 0 is the calling thread
+  unsigned int threadIndex;
+  // relative to the start of the sequence
+  double startMilliseconds;
+  double durationMilliseconds;
+  bool success;
+};
+
 struct TaskSequenceResult {
   bool success;
 
   int failingTaskIndex;
   int errorCode;
   std::string errorMessage;
+
+  // one entry per task that ran, in the order they finished
+  std::vector<TaskTiming> taskTimings;
+  double totalMilliseconds;
 };
 
 const TaskSequenceResult kTaskSequenceSuccess = {
   true
 };
 
+typedef std::chrono::steady_clock TaskClock;
+
+inline double millisecondsBetween(TaskClock::time_point start, TaskClock::time_point end) {
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Where the executors report progress and failures, e.g. to hand the lines to an asynchronous logger
+// instead of writing to the console from the task threads.
+typedef std::function<void(bool isError, const std::string &message)> TaskLogFunction;
+
+// Progress lines aren't flushed one by one, the executors flush stdout once they are done. Errors flush it first,
+// so they come out after the progress that led to them.
+inline void PrintTaskLog(bool isError, const std::string &message) {
+  if (isError) {
+    std::cout.flush();
+    std::cerr << message << std::endl;
+  }
+  else {
+    std::cout << message << '\n';
+  }
+}
+
 template<typename T>
 struct Task {
   std::string description;
@@ -38,33 +84,310 @@ struct Task {
 template<typename T>
 TaskSequenceResult ExecuteTaskSequence(
   T &data,
-  std::string sequenceDescription,
-  std::vector<Task<T>> tasks
+  const std::string &sequenceDescription,
+  const std::vector<Task<T>> &tasks,
+  const TaskLogFunction &log = PrintTaskLog
 ) {
-  std::cout << "Running task sequence: " << sequenceDescription << std::endl;
+  log(false, "Running task sequence: " + sequenceDescription);
+
+  TaskSequenceResult sequenceResult = kTaskSequenceSuccess;
+  sequenceResult.taskTimings.reserve(tasks.size());
+
+  TaskClock::time_point sequenceStart = TaskClock::now();
 
   for (int i = 0; i < tasks.size(); ++i) {
-    auto task = tasks[i];
-    std::cout << "\t" << i << ". " << task.description << std::endl;
+    const Task<T> &task = tasks[i];
+    log(false, "\t" + std::to_string(i) + ". " + task.description);
+
+    TaskClock::time_point taskStart = TaskClock::now();
     TaskResult result = task.func(data);
+    TaskClock::time_point taskEnd = TaskClock::now();
+
+    sequenceResult.taskTimings.push_back({
+      i,
+      task.description,
+      0,
+      millisecondsBetween(sequenceStart, taskStart),
+      millisecondsBetween(taskStart, taskEnd),
+      result.success
+    });
+    sequenceResult.totalMilliseconds = millisecondsBetween(sequenceStart, taskEnd);
+
     if (!result.success) {
-      std::cerr
-        << "Task sequence \""
-        << sequenceDescription
-        << "\" failed on index " << i
-        << " with error code: " << result.errorCode
-        << " and error message \"" << result.errorMessage << "\"" << std::endl;
+      log(true,
+        "Task sequence \"" + sequenceDescription +
+        "\" failed on index " + std::to_string(i) +
+        " with error code: " + std::to_string(result.errorCode) +
+        " and error message \"" + result.errorMessage + "\"");
+
+      sequenceResult.success = false;
+      sequenceResult.failingTaskIndex = i;
+      sequenceResult.errorCode = result.errorCode;
+      sequenceResult.errorMessage = std::move(result.errorMessage); // we don't really use result anymore
+      return sequenceResult;
+    }
+  }
+
+  log(false, "Finished task sequence: " + sequenceDescription);
+  std::cout.flush();
+  return sequenceResult;
+}
+
+template<typename T>
+struct GraphTask {
+  std::string description;
+  std::function<TaskResult(T&)> func;
+  // indices of the tasks in the same graph that have to finish before this one starts
+  std::vector<int> dependencies;
+  // for APIs that are only allowed on the main thread, e.g. GLFW window creation
+  bool runOnCallingThread = false;
+};
+
+// Runs tasks as soon as their dependencies finished, independent tasks run concurrently.
+// The calling thread takes part in the execution, so threadCount includes it.
+// Tasks running concurrently must only touch disjoint parts of data.
+template<typename T>
+TaskSequenceResult ExecuteTaskGraph(
+  T &data,
+  const std::string &graphDescription,
+  const std::vector<GraphTask<T>> &tasks,
+  unsigned int threadCount = std::thread::hardware_concurrency(),
+  const TaskLogFunction &log = PrintTaskLog
+) {
+  log(false, "Running task graph: " + graphDescription);
+
+  const int taskCount = static_cast<int>(tasks.size());
+
+  std::vector<int> remainingDependencies(taskCount, 0);
+  std::vector<std::vector<int>> dependents(taskCount);
+
+  for (int i = 0; i < taskCount; ++i) {
+    for (int dependency : tasks[i].dependencies) {
+      if (dependency < 0 || dependency >= taskCount || dependency == i) {
+        log(true, "Task graph \"" + graphDescription + "\" has an invalid dependency on index " + std::to_string(i));
+        return {
+          false,
+          i,
+          -1,
+          "Invalid task dependency"
+        };
+      }
+
+      remainingDependencies[i]++;
+      dependents[dependency].push_back(i);
+    }
+  }
+
+  // make sure every task can eventually run, otherwise the executor would wait forever
+  {
+    std::vector<int> pending = remainingDependencies;
+    std::vector<int> ready;
+    for (int i = 0; i < taskCount; ++i) {
+      if (pending[i] == 0) ready.push_back(i);
+    }
+
+    int visited = 0;
+    while (!ready.empty()) {
+      int index = ready.back();
+      ready.pop_back();
+      visited++;
+      for (int dependent : dependents[index]) {
+        if (--pending[dependent] == 0) ready.push_back(dependent);
+      }
+    }
+
+    if (visited != taskCount) {
+      int cycleIndex = 0;
+      while (pending[cycleIndex] == 0) cycleIndex++;
+
+      log(true, "Task graph \"" + graphDescription + "\" has a dependency cycle through index " + std::to_string(cycleIndex));
       return {
         false,
-        i,
-        result.errorCode,
-        std::move(result.errorMessage) // we don't really use result anymore
+        cycleIndex,
+        -1,
+        "Task dependency cycle"
       };
     }
   }
 
-  std::cout << "Finished task sequence: " << sequenceDescription << std::endl;
-  return kTaskSequenceSuccess;
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::deque<int> readyTasks;
+  std::deque<int> readyCallingThreadTasks;
+  int completedCount = 0;
+  int runningCount = 0;
+  bool failed = false;
+  TaskSequenceResult graphResult = kTaskSequenceSuccess;
+  graphResult.taskTimings.reserve(taskCount);
+
+  TaskClock::time_point graphStart = TaskClock::now();
+
+  for (int i = 0; i < taskCount; ++i) {
+    if (remainingDependencies[i] == 0) {
+      (tasks[i].runOnCallingThread ? readyCallingThreadTasks : readyTasks).push_back(i);
+    }
+  }
+
+  const auto runTasks = [&](unsigned int threadIndex) {
+    const bool isCallingThread = threadIndex == 0;
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+      condition.wait(lock, [&]() {
+        bool finished = completedCount == taskCount || (failed && runningCount == 0);
+        return finished || (!failed && (!readyTasks.empty() || (isCallingThread && !readyCallingThreadTasks.empty())));
+      });
+
+      if (completedCount == taskCount || failed) {
+        return;
+      }
+
+      int index;
+      if (isCallingThread && !readyCallingThreadTasks.empty()) {
+        index = readyCallingThreadTasks.front();
+        readyCallingThreadTasks.pop_front();
+      }
+      else {
+        index = readyTasks.front();
+        readyTasks.pop_front();
+      }
+
+      runningCount++;
+      log(false, "\t" + std::to_string(index) + ". " + tasks[index].description);
+
+      lock.unlock();
+      TaskClock::time_point taskStart = TaskClock::now();
+      TaskResult result = tasks[index].func(data);
+      TaskClock::time_point taskEnd = TaskClock::now();
+      lock.lock();
+
+      runningCount--;
+
+      graphResult.taskTimings.push_back({
+        index,
+        tasks[index].description,
+        threadIndex,
+        millisecondsBetween(graphStart, taskStart),
+        millisecondsBetween(taskStart, taskEnd),
+        result.success
+      });
+
+      if (!result.success) {
+        // only the first failure is reported, tasks already running are allowed to finish
+        if (!failed) {
+          failed = true;
+          log(true,
+            "Task graph \"" + graphDescription +
+            "\" failed on index " + std::to_string(index) +
+            " with error code: " + std::to_string(result.errorCode) +
+            " and error message \"" + result.errorMessage + "\"");
+          graphResult.success = false;
+          graphResult.failingTaskIndex = index;
+          graphResult.errorCode = result.errorCode;
+          graphResult.errorMessage = std::move(result.errorMessage);
+        }
+      }
+      else {
+        completedCount++;
+        for (int dependent : dependents[index]) {
+          if (--remainingDependencies[dependent] == 0) {
+            (tasks[dependent].runOnCallingThread ? readyCallingThreadTasks : readyTasks).push_back(dependent);
+          }
+        }
+      }
+
+      condition.notify_all();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned int i = 1; i < std::max(threadCount, 1u); ++i) {
+    workers.emplace_back(runTasks, i);
+  }
+
+  runTasks(0);
+
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  graphResult.totalMilliseconds = millisecondsBetween(graphStart, TaskClock::now());
+
+  if (failed) {
+    return graphResult;
+  }
+
+  log(false, "Finished task graph: " + graphDescription);
+  std::cout.flush();
+  return graphResult;
+}
+
+// Prints the tasks slowest first with their share of the total wall time.
+// For graphs the shares can add up to more than 100% since tasks overlap.
+inline void PrintTaskTimingReport(const TaskSequenceResult &result, const std::string &description, std::ostream &stream) {
+
+  std::vector<const TaskTiming*> sortedTimings;
+  sortedTimings.reserve(result.taskTimings.size());
+  for (const TaskTiming &timing : result.taskTimings) {
+    sortedTimings.push_back(&timing);
+  }
+
+  std::sort(sortedTimings.begin(), sortedTimings.end(), [](const TaskTiming* a, const TaskTiming* b) {
+    return a->durationMilliseconds > b->durationMilliseconds;
+  });
+
+  std::ios::fmtflags flags = stream.flags();
+  std::streamsize precision = stream.precision();
+  stream << std::fixed << std::setprecision(2);
+
+  stream << "Task timings for " << description << ", " << result.totalMilliseconds << " ms total:\n";
+  for (const TaskTiming* timing : sortedTimings) {
+    double share = result.totalMilliseconds > 0.0 ? 100.0 * timing->durationMilliseconds / result.totalMilliseconds : 0.0;
+    stream
+      << "\t" << std::setw(9) << timing->durationMilliseconds << " ms "
+      << std::setw(6) << share << "% "
+      << timing->taskIndex << ". " << timing->description
+      << (timing->success ? "" : " (failed)") << '\n';
+  }
+  stream.flush();
+
+  stream.flags(flags);
+  stream.precision(precision);
+}
+
+// Writes the task timings as Chrome trace_event JSON, one trace thread per executor thread.
+// Returns false if the file couldn't be written.
+inline bool WriteTaskTimingsChromeTrace(const TaskSequenceResult &result, const std::string &path) {
+
+  std::ofstream file(path, std::ios::trunc);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  file << "{\"traceEvents\":[";
+
+  const char* separator = "\n";
+  for (const TaskTiming &timing : result.taskTimings) {
+
+    // descriptions are our own literals, but keep the JSON valid whatever they contain
+    std::string name;
+    for (char c : timing.description) {
+      if (c == '"' || c == '\\') name += '\\';
+      if (static_cast<unsigned char>(c) >= 0x20) name += c;
+    }
+
+    file << separator
+      << "{\"name\":\"" << name
+      << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << timing.threadIndex
+      << ",\"ts\":" << timing.startMilliseconds * 1000.0
+      << ",\"dur\":" << timing.durationMilliseconds * 1000.0
+      << ",\"args\":{\"index\":" << timing.taskIndex << ",\"success\":" << (timing.success ? "true" : "false") << "}}";
+    separator = ",\n";
+  }
+
+  file << "\n]}\n";
+
+  return file.good();
 }
 
 }
@@ -0,0 +1,328 @@
+#include "VulkanCapabilities.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "VulkanUtils.h"
+
+namespace vks {
+
+namespace {
+
+// vkEnumerateInstanceVersion only exists in 1.1 loaders, so it has to be looked up
+typedef VkResult (VKAPI_PTR *EnumerateInstanceVersionFunction)(uint32_t* pApiVersion);
+
+struct VulkanCapabilitiesFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t loaderVersion;
+  uint32_t headerVersion;
+  uint32_t checksum;
+  uint32_t padding;
+  uint64_t dataSize;
+};
+
+const uint32_t kVulkanCapabilitiesFileMagic = 0x43534b56; // "VKSC"
+const uint32_t kVulkanCapabilitiesFileVersion = 1;
+
+bool isSameDriver(const VkPhysicalDeviceProperties &a, const VkPhysicalDeviceProperties &b) {
+  return a.vendorID == b.vendorID &&
+    a.deviceID == b.deviceID &&
+    a.driverVersion == b.driverVersion &&
+    memcmp(a.pipelineCacheUUID, b.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+uint32_t computeLayerKey(const std::vector<const char*> &layers) {
+  std::string names;
+  for (const char* layer : layers) {
+    names += layer;
+    names += '\n';
+  }
+  return ComputeVkFileChecksum(names.data(), names.size());
+}
+
+VulkanDeviceCapabilities probeVulkanDevice(VkPhysicalDevice physicalDevice, const VkPhysicalDeviceProperties &properties) {
+
+  VulkanDeviceCapabilities device;
+  device.physicalDevice = physicalDevice;
+  device.properties = properties;
+  device.queueFamilies = GetVkFamiliesOfDevice(physicalDevice);
+
+  uint32_t extensionCount = 0;
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+  device.extensions.resize(extensionCount);
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, device.extensions.data());
+  device.extensions.resize(extensionCount);
+
+  std::sort(device.extensions.begin(), device.extensions.end(), [](const VkExtensionProperties &a, const VkExtensionProperties &b) {
+    return strcmp(a.extensionName, b.extensionName) < 0;
+  });
+
+  return device;
+}
+
+// the snapshot is flat, every record is either a plain Vulkan struct or a count followed by an array of them
+template<typename T>
+void writeArray(std::vector<char> &output, const std::vector<T> &values) {
+  const uint32_t count = static_cast<uint32_t>(values.size());
+  output.insert(output.end(), reinterpret_cast<const char*>(&count), reinterpret_cast<const char*>(&count + 1));
+  output.insert(output.end(), reinterpret_cast<const char*>(values.data()), reinterpret_cast<const char*>(values.data() + values.size()));
+}
+
+template<typename T>
+void writeValue(std::vector<char> &output, const T &value) {
+  output.insert(output.end(), reinterpret_cast<const char*>(&value), reinterpret_cast<const char*>(&value + 1));
+}
+
+class SnapshotReader {
+  public:
+    SnapshotReader(const std::vector<char> &data) : data_(data) {}
+
+    template<typename T>
+    bool Read(T &value) {
+      if (data_.size() - offset_ < sizeof(T)) {
+        return false;
+      }
+      memcpy(&value, data_.data() + offset_, sizeof(T));
+      offset_ += sizeof(T);
+      return true;
+    }
+
+    template<typename T>
+    bool ReadArray(std::vector<T> &values) {
+      uint32_t count;
+      if (!Read(count) || (data_.size() - offset_) / sizeof(T) < count) {
+        return false;
+      }
+      values.resize(count);
+      memcpy(values.data(), data_.data() + offset_, count * sizeof(T));
+      offset_ += count * sizeof(T);
+      return true;
+    }
+
+    bool IsAtEnd() const { return offset_ == data_.size(); }
+
+  private:
+    const std::vector<char> &data_;
+    size_t offset_ = 0;
+};
+
+}
+
+const VkExtensionProperties* VulkanInstanceCapabilities::FindExtension(const char* name) const {
+  for (const auto &extension : extensions) {
+    if (strcmp(extension.extensionName, name) == 0) {
+      return &extension;
+    }
+  }
+
+  return nullptr;
+}
+
+bool VulkanInstanceCapabilities::HasLayers(const std::vector<const char*> &names) const {
+  for (const char* name : names) {
+    const auto layer = std::find_if(layers.begin(), layers.end(), [&](const VkLayerProperties &properties) {
+      return strcmp(properties.layerName, name) == 0;
+    });
+    if (layer == layers.end()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool VulkanDeviceCapabilities::HasExtensions(const std::vector<const char*> &names) const {
+  for (const char* name : names) {
+    const auto extension = std::lower_bound(extensions.begin(), extensions.end(), name, [](const VkExtensionProperties &properties, const char* name) {
+      return strcmp(properties.extensionName, name) < 0;
+    });
+    if (extension == extensions.end() || strcmp(extension->extensionName, name) != 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+uint32_t GetVulkanLoaderVersion() {
+
+  const auto enumerateInstanceVersion = reinterpret_cast<EnumerateInstanceVersionFunction>(
+    vkGetInstanceProcAddr(VK_NULL_HANDLE, "vkEnumerateInstanceVersion"));
+
+  uint32_t version = VK_API_VERSION_1_0;
+  if (enumerateInstanceVersion == nullptr || enumerateInstanceVersion(&version) != VK_SUCCESS) {
+    return VK_API_VERSION_1_0;
+  }
+  return version;
+}
+
+VulkanInstanceCapabilities ProbeVulkanInstanceCapabilities() {
+
+  VulkanInstanceCapabilities instance;
+  instance.loaderVersion = GetVulkanLoaderVersion();
+  instance.extensions = GetVkExtensions();
+
+  uint32_t layerCount = 0;
+  vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
+  instance.layers.resize(layerCount);
+  vkEnumerateInstanceLayerProperties(&layerCount, instance.layers.data());
+  instance.layers.resize(layerCount);
+
+  return instance;
+}
+
+uint32_t UpdateVulkanDeviceCapabilities(VkInstance instance, const std::vector<const char*> &enabledLayers, VulkanCapabilities &capabilities) {
+
+  uint32_t deviceCount = 0;
+  vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+  std::vector<VkPhysicalDevice> physicalDevices(deviceCount);
+  vkEnumeratePhysicalDevices(instance, &deviceCount, physicalDevices.data());
+  physicalDevices.resize(deviceCount);
+
+  // snapshots taken with other layers may lack or have extra extensions, so they can't be reused
+  const uint32_t layerKey = computeLayerKey(enabledLayers);
+  std::vector<VulkanDeviceCapabilities> cached;
+  if (capabilities.deviceLayerKey == layerKey) {
+    cached = std::move(capabilities.devices);
+  }
+  std::vector<bool> cachedUsed(cached.size(), false);
+
+  capabilities.deviceLayerKey = layerKey;
+  capabilities.devices.clear();
+
+  uint32_t probedCount = 0;
+  for (VkPhysicalDevice physicalDevice : physicalDevices) {
+
+    // properties are the key, so they are always queried
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    // identical GPUs have identical snapshots, each one is used once so device counts still have to match
+    uint32_t match = 0;
+    while (match < cached.size() && (cachedUsed[match] || !isSameDriver(cached[match].properties, properties))) {
+      ++match;
+    }
+
+    if (match < cached.size()) {
+      cachedUsed[match] = true;
+      capabilities.devices.push_back(std::move(cached[match]));
+      capabilities.devices.back().physicalDevice = physicalDevice;
+    }
+    else {
+      capabilities.devices.push_back(probeVulkanDevice(physicalDevice, properties));
+      ++probedCount;
+    }
+  }
+
+  return probedCount;
+}
+
+bool ReadVulkanCapabilitiesFile(const std::string &path, uint32_t loaderVersion, VulkanCapabilities &output) {
+  std::ifstream file(path, std::ios::ate | std::ios::binary);
+
+  if (!file.is_open()) {
+    return false;
+  }
+
+  size_t fileSize = (size_t)file.tellg();
+  if (fileSize < sizeof(VulkanCapabilitiesFileHeader)) {
+    return false;
+  }
+
+  VulkanCapabilitiesFileHeader header;
+  file.seekg(0);
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+  if (
+    header.magic != kVulkanCapabilitiesFileMagic ||
+    header.version != kVulkanCapabilitiesFileVersion ||
+    header.loaderVersion != loaderVersion ||
+    header.headerVersion != VK_HEADER_VERSION ||
+    header.dataSize != fileSize - sizeof(VulkanCapabilitiesFileHeader)
+    ) {
+    return false;
+  }
+
+  std::vector<char> data((size_t)header.dataSize);
+  file.read(data.data(), data.size());
+
+  if (!file || ComputeVkFileChecksum(data.data(), data.size()) != header.checksum) {
+    return false;
+  }
+
+  VulkanCapabilities capabilities;
+  capabilities.instance.loaderVersion = loaderVersion;
+
+  SnapshotReader reader(data);
+  uint32_t deviceCount;
+  if (
+    !reader.ReadArray(capabilities.instance.extensions) ||
+    !reader.ReadArray(capabilities.instance.layers) ||
+    !reader.Read(capabilities.deviceLayerKey) ||
+    !reader.Read(deviceCount)
+    ) {
+    return false;
+  }
+
+  capabilities.devices.resize(deviceCount);
+  for (VulkanDeviceCapabilities &device : capabilities.devices) {
+    if (
+      !reader.Read(device.properties) ||
+      !reader.ReadArray(device.queueFamilies) ||
+      !reader.ReadArray(device.extensions)
+      ) {
+      return false;
+    }
+  }
+
+  if (!reader.IsAtEnd()) {
+    return false;
+  }
+
+  output = std::move(capabilities);
+  return true;
+}
+
+bool WriteVulkanCapabilitiesFile(const std::string &path, const VulkanCapabilities &capabilities) {
+
+  std::vector<char> data;
+  writeArray(data, capabilities.instance.extensions);
+  writeArray(data, capabilities.instance.layers);
+  writeValue(data, capabilities.deviceLayerKey);
+  writeValue(data, static_cast<uint32_t>(capabilities.devices.size()));
+  for (const VulkanDeviceCapabilities &device : capabilities.devices) {
+    writeValue(data, device.properties);
+    writeArray(data, device.queueFamilies);
+    writeArray(data, device.extensions);
+  }
+
+  VulkanCapabilitiesFileHeader header = {};
+  header.magic = kVulkanCapabilitiesFileMagic;
+  header.version = kVulkanCapabilitiesFileVersion;
+  header.loaderVersion = capabilities.instance.loaderVersion;
+  header.headerVersion = VK_HEADER_VERSION;
+  header.checksum = ComputeVkFileChecksum(data.data(), data.size());
+  header.dataSize = data.size();
+
+  // same as the pipeline cache, a crash mid-write never leaves a truncated snapshot behind
+  std::string temporaryPath = path + ".tmp";
+  {
+    std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(data.data(), data.size());
+
+    if (!file) {
+      return false;
+    }
+  }
+
+  return ReplaceVkFile(temporaryPath, path);
+}
+
+}
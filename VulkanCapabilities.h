@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan\vulkan.hpp>
+
+namespace vks {
+
+// What the loader offers before there is an instance.
+struct VulkanInstanceCapabilities {
+  // from vkEnumerateInstanceVersion, VK_API_VERSION_1_0 for loaders that predate it
+  uint32_t loaderVersion = 0;
+  std::vector<VkExtensionProperties> extensions;
+  std::vector<VkLayerProperties> layers;
+
+  const VkExtensionProperties* FindExtension(const char* name) const;
+  bool HasLayers(const std::vector<const char*> &names) const;
+};
+
+// One physical device as the instance it was probed with saw it, enabled layers can add device extensions.
+struct VulkanDeviceCapabilities {
+  // only valid for the instance it was probed or matched with, never persisted
+  VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+  VkPhysicalDeviceProperties properties;
+  std::vector<VkQueueFamilyProperties> queueFamilies;
+  // sorted by name
+  std::vector<VkExtensionProperties> extensions;
+
+  bool HasExtensions(const std::vector<const char*> &names) const;
+};
+
+// Everything startup needs to know about the loader and the devices, probed once and shared by every task instead
+// of each one enumerating again.
+struct VulkanCapabilities {
+  VulkanInstanceCapabilities instance;
+  // checksum of the instance layers enabled when the devices were probed
+  uint32_t deviceLayerKey = 0;
+  std::vector<VulkanDeviceCapabilities> devices;
+};
+
+// cheap, doesn't enumerate anything
+uint32_t GetVulkanLoaderVersion();
+VulkanInstanceCapabilities ProbeVulkanInstanceCapabilities();
+
+// Fills capabilities.devices with the instance's physical devices, in enumeration order. Devices that already have a
+// snapshot for the same driver and layers keep it and only get their handle, the rest are probed.
+// Returns how many devices had to be probed.
+uint32_t UpdateVulkanDeviceCapabilities(VkInstance instance, const std::vector<const char*> &enabledLayers, VulkanCapabilities &capabilities);
+
+// A snapshot written by WriteVulkanCapabilitiesFile. Returns false if the file is missing, corrupt or was written for
+// another loader or Vulkan header version, in which case everything has to be probed.
+// Layers and extensions installed or removed since then aren't detected: probe the instance capabilities again before
+// disabling anything the snapshot lacks, and when instance creation fails with VK_ERROR_LAYER_NOT_PRESENT or
+// VK_ERROR_EXTENSION_NOT_PRESENT.
+bool ReadVulkanCapabilitiesFile(const std::string &path, uint32_t loaderVersion, VulkanCapabilities &output);
+bool WriteVulkanCapabilitiesFile(const std::string &path, const VulkanCapabilities &capabilities);
+
+}
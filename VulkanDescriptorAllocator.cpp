@@ -0,0 +1,325 @@
+#include "VulkanDescriptorAllocator.h"
+
+#include <algorithm>
+
+namespace vks {
+
+const uint32_t VulkanDescriptorAllocator::kDefaultSetsPerPool;
+const uint32_t VulkanDescriptorAllocator::kMaxSetsPerPool;
+const uint32_t VulkanDescriptorAllocator::kPoolDescriptorTypeCount;
+
+// descriptors of each type per set a pool is sized for, a rough mix that covers what the shaders use
+const struct {
+  VkDescriptorType type;
+  float countPerSet;
+} kDescriptorPoolRatios[] = {
+  { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+  { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+  { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3.0f },
+  { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 0.5f },
+  { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f },
+  { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1.0f },
+  { VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f },
+  { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0.5f },
+};
+
+static_assert(
+  sizeof(kDescriptorPoolRatios) / sizeof(kDescriptorPoolRatios[0]) == VulkanDescriptorAllocator::kPoolDescriptorTypeCount,
+  "one pool budget entry per descriptor type");
+
+bool VulkanDescriptorLayoutCache::LayoutKey::operator==(const LayoutKey &other) const {
+
+  if (bindings.size() != other.bindings.size()) {
+    return false;
+  }
+
+  for (size_t i = 0; i < bindings.size(); ++i) {
+    const VkDescriptorSetLayoutBinding &a = bindings[i];
+    const VkDescriptorSetLayoutBinding &b = other.bindings[i];
+    if (a.binding != b.binding ||
+      a.descriptorType != b.descriptorType ||
+      a.descriptorCount != b.descriptorCount ||
+      a.stageFlags != b.stageFlags) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+size_t VulkanDescriptorLayoutCache::LayoutKeyHash::operator()(const LayoutKey &key) const {
+
+  // FNV-1a over the fields that matter, the struct itself has padding and a pointer
+  uint64_t hash = 14695981039346656037ull;
+  const auto mix = [&](uint32_t value) {
+    hash = (hash ^ value) * 1099511628211ull;
+  };
+
+  for (const auto &binding : key.bindings) {
+    mix(binding.binding);
+    mix(static_cast<uint32_t>(binding.descriptorType));
+    mix(binding.descriptorCount);
+    mix(binding.stageFlags);
+  }
+
+  return static_cast<size_t>(hash);
+}
+
+void VulkanDescriptorLayoutCache::Init(VkDevice device, const VkAllocationCallbacks* allocationCallbacks) {
+  device_ = device;
+  allocationCallbacks_ = allocationCallbacks;
+}
+
+void VulkanDescriptorLayoutCache::Destroy() {
+  for (const auto &entry : layouts_) {
+    vkDestroyDescriptorSetLayout(device_, entry.second, allocationCallbacks_);
+  }
+  layouts_.clear();
+  layoutSizes_.clear();
+}
+
+VkResult VulkanDescriptorLayoutCache::GetLayout(const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingCount, VkDescriptorSetLayout &layout) {
+
+  LayoutKey key;
+  key.bindings.assign(bindings, bindings + bindingCount);
+  std::sort(key.bindings.begin(), key.bindings.end(), [](const VkDescriptorSetLayoutBinding &a, const VkDescriptorSetLayoutBinding &b) {
+    return a.binding < b.binding;
+  });
+
+  auto it = layouts_.find(key);
+  if (it != layouts_.end()) {
+    layout = it->second;
+    return VK_SUCCESS;
+  }
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = bindingCount;
+  layoutInfo.pBindings = key.bindings.data();
+
+  VkResult result;
+  if ((result = vkCreateDescriptorSetLayout(device_, &layoutInfo, allocationCallbacks_, &layout)) != VK_SUCCESS) {
+    return result;
+  }
+
+  // what a set of the layout takes out of a pool, summed per type
+  std::vector<VkDescriptorPoolSize> sizes;
+  for (const auto &binding : key.bindings) {
+    auto size = std::find_if(sizes.begin(), sizes.end(), [&](const VkDescriptorPoolSize &poolSize) {
+      return poolSize.type == binding.descriptorType;
+    });
+    if (size == sizes.end()) {
+      sizes.push_back({ binding.descriptorType, binding.descriptorCount });
+    }
+    else {
+      size->descriptorCount += binding.descriptorCount;
+    }
+  }
+
+  layouts_.emplace(std::move(key), layout);
+  layoutSizes_.emplace(layout, std::move(sizes));
+  return VK_SUCCESS;
+}
+
+const std::vector<VkDescriptorPoolSize>* VulkanDescriptorLayoutCache::GetLayoutSizes(VkDescriptorSetLayout layout) const {
+  auto it = layoutSizes_.find(layout);
+  return it != layoutSizes_.end() ? &it->second : nullptr;
+}
+
+bool VulkanDescriptorAllocator::PoolBudget::Covers(const PoolBudget &needed) const {
+
+  if (sets < needed.sets) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < kPoolDescriptorTypeCount; ++i) {
+    if (descriptors[i] < needed.descriptors[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void VulkanDescriptorAllocator::Init(
+  VkDevice device,
+  const VulkanDescriptorLayoutCache &layoutCache,
+  uint32_t frameSlotCount,
+  uint32_t setsPerPool,
+  const VkAllocationCallbacks* allocationCallbacks) {
+
+  device_ = device;
+  layoutCache_ = &layoutCache;
+  allocationCallbacks_ = allocationCallbacks;
+  setsPerPool_ = std::max(setsPerPool, 1u);
+  framePools_.resize(frameSlotCount);
+  currentFrame_ = 0;
+}
+
+void VulkanDescriptorAllocator::Destroy() {
+
+  for (auto &poolList : framePools_) {
+    for (auto pool : poolList.pools) {
+      vkDestroyDescriptorPool(device_, pool, allocationCallbacks_);
+    }
+  }
+  framePools_.clear();
+
+  for (auto pool : persistentPools_.pools) {
+    vkDestroyDescriptorPool(device_, pool, allocationCallbacks_);
+  }
+  persistentPools_ = PoolList();
+
+  for (auto pool : freePools_) {
+    vkDestroyDescriptorPool(device_, pool, allocationCallbacks_);
+  }
+  freePools_.clear();
+  freePoolCapacities_.clear();
+}
+
+void VulkanDescriptorAllocator::BeginFrame(uint32_t frameSlot) {
+
+  currentFrame_ = frameSlot;
+  PoolList &poolList = framePools_[frameSlot];
+
+  // the largest pool stays with the slot, the others go back for whichever list runs out first
+  for (size_t i = 0; i < poolList.pools.size(); ++i) {
+    vkResetDescriptorPool(device_, poolList.pools[i], 0);
+    if (i + 1 < poolList.pools.size()) {
+      freePools_.push_back(poolList.pools[i]);
+      freePoolCapacities_.push_back(poolList.capacities[i]);
+    }
+  }
+
+  if (poolList.pools.size() > 1) {
+    poolList.pools.erase(poolList.pools.begin(), poolList.pools.end() - 1);
+    poolList.capacities.erase(poolList.capacities.begin(), poolList.capacities.end() - 1);
+  }
+  poolList.remaining = poolList.capacities;
+}
+
+VkResult VulkanDescriptorAllocator::AllocateFrameSet(VkDescriptorSetLayout layout, VkDescriptorSet &set) {
+  return allocate(framePools_[currentFrame_], layout, set);
+}
+
+VkResult VulkanDescriptorAllocator::AllocatePersistentSet(VkDescriptorSetLayout layout, VkDescriptorSet &set) {
+  return allocate(persistentPools_, layout, set);
+}
+
+uint32_t VulkanDescriptorAllocator::GetPoolCount() const {
+  size_t poolCount = persistentPools_.pools.size() + freePools_.size();
+  for (const auto &poolList : framePools_) {
+    poolCount += poolList.pools.size();
+  }
+  return static_cast<uint32_t>(poolCount);
+}
+
+VkResult VulkanDescriptorAllocator::getLayoutBudget(VkDescriptorSetLayout layout, PoolBudget &needed) const {
+
+  const std::vector<VkDescriptorPoolSize>* sizes = layoutCache_->GetLayoutSizes(layout);
+  if (sizes == nullptr) {
+    return VK_ERROR_INITIALIZATION_FAILED;
+  }
+
+  needed = PoolBudget();
+  needed.sets = 1;
+  for (const auto &size : *sizes) {
+    uint32_t type = 0;
+    while (type < kPoolDescriptorTypeCount && kDescriptorPoolRatios[type].type != size.type) {
+      type++;
+    }
+
+    // the pools aren't created with any descriptors of that type
+    if (type == kPoolDescriptorTypeCount) {
+      return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    needed.descriptors[type] = size.descriptorCount;
+  }
+
+  return VK_SUCCESS;
+}
+
+VkResult VulkanDescriptorAllocator::allocate(PoolList &poolList, VkDescriptorSetLayout layout, VkDescriptorSet &set) {
+
+  PoolBudget needed;
+  VkResult result;
+  if ((result = getLayoutBudget(layout, needed)) != VK_SUCCESS) {
+    return result;
+  }
+
+  // nothing is ever freed set by set, so a pool that covers the set can't fail with a fragmented pool either
+  if (poolList.pools.empty() || !poolList.remaining.back().Covers(needed)) {
+    if ((result = addPool(poolList, needed)) != VK_SUCCESS) {
+      return result;
+    }
+  }
+
+  VkDescriptorSetAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = poolList.pools.back();
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &layout;
+
+  if ((result = vkAllocateDescriptorSets(device_, &allocInfo, &set)) != VK_SUCCESS) {
+    return result;
+  }
+
+  PoolBudget &remaining = poolList.remaining.back();
+  remaining.sets -= needed.sets;
+  for (uint32_t i = 0; i < kPoolDescriptorTypeCount; ++i) {
+    remaining.descriptors[i] -= needed.descriptors[i];
+  }
+
+  return VK_SUCCESS;
+}
+
+VkResult VulkanDescriptorAllocator::addPool(PoolList &poolList, const PoolBudget &needed) {
+
+  const uint32_t setCount = poolList.capacities.empty() ?
+    setsPerPool_ :
+    std::min(poolList.capacities.back().sets * 2, std::max(kMaxSetsPerPool, setsPerPool_));
+
+  // a free pool at least as large as the one the list would grow to
+  for (size_t i = 0; i < freePools_.size(); ++i) {
+    if (freePoolCapacities_[i].sets >= setCount && freePoolCapacities_[i].Covers(needed)) {
+      poolList.pools.push_back(freePools_[i]);
+      poolList.capacities.push_back(freePoolCapacities_[i]);
+      poolList.remaining.push_back(freePoolCapacities_[i]);
+      freePools_.erase(freePools_.begin() + i);
+      freePoolCapacities_.erase(freePoolCapacities_.begin() + i);
+      return VK_SUCCESS;
+    }
+  }
+
+  // sized by the ratios, but never too small for the set that asked for the pool
+  PoolBudget capacity;
+  capacity.sets = setCount;
+  VkDescriptorPoolSize poolSizes[kPoolDescriptorTypeCount];
+  for (uint32_t i = 0; i < kPoolDescriptorTypeCount; ++i) {
+    capacity.descriptors[i] = std::max(
+      std::max(static_cast<uint32_t>(kDescriptorPoolRatios[i].countPerSet * setCount), 1u),
+      needed.descriptors[i]);
+    poolSizes[i].type = kDescriptorPoolRatios[i].type;
+    poolSizes[i].descriptorCount = capacity.descriptors[i];
+  }
+
+  VkDescriptorPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.maxSets = setCount;
+  poolInfo.poolSizeCount = kPoolDescriptorTypeCount;
+  poolInfo.pPoolSizes = poolSizes;
+
+  VkDescriptorPool pool;
+  VkResult result;
+  if ((result = vkCreateDescriptorPool(device_, &poolInfo, allocationCallbacks_, &pool)) != VK_SUCCESS) {
+    return result;
+  }
+
+  poolList.pools.push_back(pool);
+  poolList.capacities.push_back(capacity);
+  poolList.remaining.push_back(capacity);
+  return VK_SUCCESS;
+}
+
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan\vulkan.hpp>
+
+namespace vks {
+
+// Hands out one VkDescriptorSetLayout per distinct set of bindings, so subsystems that describe the same
+// set end up with the same layout and compatible pipeline layouts. Layouts live until Destroy.
+// Not thread safe, layouts are meant to be created during init.
+class VulkanDescriptorLayoutCache {
+  public:
+    void Init(VkDevice device, const VkAllocationCallbacks* allocationCallbacks = nullptr);
+    // the device has to be idle and nothing may use the layouts anymore
+    void Destroy();
+
+    // bindings may come in any order, immutable samplers aren't supported
+    VkResult GetLayout(const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingCount, VkDescriptorSetLayout &layout);
+
+    uint32_t GetLayoutCount() const { return static_cast<uint32_t>(layouts_.size()); }
+    // descriptors per type a set of layout takes, nullptr if the layout didn't come from this cache
+    const std::vector<VkDescriptorPoolSize>* GetLayoutSizes(VkDescriptorSetLayout layout) const;
+
+  private:
+    struct LayoutKey {
+      std::vector<VkDescriptorSetLayoutBinding> bindings;
+      bool operator==(const LayoutKey &other) const;
+    };
+
+    struct LayoutKeyHash {
+      size_t operator()(const LayoutKey &key) const;
+    };
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    const VkAllocationCallbacks* allocationCallbacks_ = nullptr;
+    std::unordered_map<LayoutKey, VkDescriptorSetLayout, LayoutKeyHash> layouts_;
+    std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorPoolSize>> layoutSizes_;
+};
+
+// Descriptor sets out of pools that are never freed set by set.
+//
+// Frame sets come from the pools of the current frame slot and are all released at once by the
+// vkResetDescriptorPool calls of the next BeginFrame of that slot. Persistent sets come from a separate
+// list of pools and live until Destroy. Either kind grabs another pool when the current one runs out,
+// each new pool twice the size of the previous one up to kMaxSetsPerPool, and reset pools get reused,
+// so steady state frames neither create pools nor fragment them.
+//
+// Without VK_KHR_maintenance1 an exhausted pool doesn't have to fail vkAllocateDescriptorSets, so the sets
+// and descriptors left in each pool are counted here, from the layouts' bindings in the layout cache, and
+// allocations move on to another pool before the current one could run out.
+// Not thread safe, meant to be driven by the render thread.
+class VulkanDescriptorAllocator {
+  public:
+    static const uint32_t kDefaultSetsPerPool = 64;
+    static const uint32_t kMaxSetsPerPool = 4096;
+    // descriptor types every pool is created with, sets of layouts using any other type can't be allocated
+    static const uint32_t kPoolDescriptorTypeCount = 8;
+
+    // every layout passed to the Allocate calls has to come from layoutCache
+    void Init(
+      VkDevice device,
+      const VulkanDescriptorLayoutCache &layoutCache,
+      uint32_t frameSlotCount,
+      uint32_t setsPerPool = kDefaultSetsPerPool,
+      const VkAllocationCallbacks* allocationCallbacks = nullptr);
+    // the device has to be idle
+    void Destroy();
+
+    // releases every set allocated for frameSlot, whose previous frame must have finished on the GPU
+    void BeginFrame(uint32_t frameSlot);
+
+    // valid until the next BeginFrame of the current frame slot
+    VkResult AllocateFrameSet(VkDescriptorSetLayout layout, VkDescriptorSet &set);
+    // valid until Destroy
+    VkResult AllocatePersistentSet(VkDescriptorSetLayout layout, VkDescriptorSet &set);
+
+    uint32_t GetPoolCount() const;
+
+  private:
+    struct PoolBudget {
+      uint32_t sets = 0;
+      uint32_t descriptors[kPoolDescriptorTypeCount] = {};
+
+      bool Covers(const PoolBudget &needed) const;
+    };
+
+    struct PoolList {
+      // the pool allocations go to is the back one
+      std::vector<VkDescriptorPool> pools;
+      // what each pool was created with, and what is left of it since its last reset
+      std::vector<PoolBudget> capacities;
+      std::vector<PoolBudget> remaining;
+    };
+
+    VkResult getLayoutBudget(VkDescriptorSetLayout layout, PoolBudget &needed) const;
+    VkResult allocate(PoolList &poolList, VkDescriptorSetLayout layout, VkDescriptorSet &set);
+    // the new pool has room for at least one set taking needed
+    VkResult addPool(PoolList &poolList, const PoolBudget &needed);
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    const VulkanDescriptorLayoutCache* layoutCache_ = nullptr;
+    const VkAllocationCallbacks* allocationCallbacks_ = nullptr;
+    uint32_t setsPerPool_ = kDefaultSetsPerPool;
+
+    std::vector<PoolList> framePools_;
+    uint32_t currentFrame_ = 0;
+    PoolList persistentPools_;
+
+    // reset frame pools waiting to be picked up again, with their capacities
+    std::vector<VkDescriptorPool> freePools_;
+    std::vector<PoolBudget> freePoolCapacities_;
+};
+
+}
@@ -0,0 +1,301 @@
+#include "VulkanHostAllocator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace vks {
+
+const size_t VulkanHostAllocator::kMaxPooledBlockSize;
+const size_t VulkanHostAllocator::kPoolChunkSize;
+const uint8_t VulkanHostAllocator::kUnpooled;
+
+namespace {
+
+const size_t kMinBlockSize = 32;
+
+// sits right in front of every pointer handed to the driver
+struct AllocationHeader {
+  uint64_t size;
+  // from the start of the block or system allocation to the pointer handed out
+  uint32_t offset;
+  uint8_t scope;
+  uint8_t sizeClass;
+  uint16_t padding;
+};
+static_assert(sizeof(AllocationHeader) == 16, "AllocationHeader has to keep 16 byte alignment");
+
+// room for the header in front of an allocation, keeping the pointer after it aligned
+size_t getHeaderSpace(size_t alignment) {
+  return std::max(alignment, sizeof(AllocationHeader));
+}
+
+AllocationHeader* getHeader(void* memory) {
+  return reinterpret_cast<AllocationHeader*>(static_cast<char*>(memory) - sizeof(AllocationHeader));
+}
+
+uint32_t getSizeClass(size_t blockSize) {
+  uint32_t sizeClass = 0;
+  for (size_t classSize = kMinBlockSize; classSize < blockSize; classSize *= 2) {
+    ++sizeClass;
+  }
+  return sizeClass;
+}
+
+size_t getClassSize(uint32_t sizeClass) {
+  return kMinBlockSize << sizeClass;
+}
+
+void updatePeak(std::atomic<uint64_t> &peak, uint64_t value) {
+  uint64_t current = peak.load(std::memory_order_relaxed);
+  while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+}
+
+void VulkanHostAllocator::Init() {
+
+  callbacks_.pUserData = this;
+  callbacks_.pfnAllocation = allocationCallback;
+  callbacks_.pfnReallocation = reallocationCallback;
+  callbacks_.pfnFree = freeCallback;
+  callbacks_.pfnInternalAllocation = internalAllocationCallback;
+  callbacks_.pfnInternalFree = internalFreeCallback;
+
+  for (ScopeCounters &counters : scopes_) {
+    counters.allocationCount = 0;
+    counters.pooledCount = 0;
+    counters.liveCount = 0;
+    counters.liveBytes = 0;
+    counters.peakBytes = 0;
+    counters.internalBytes = 0;
+  }
+  liveBytes_ = 0;
+  peakBytes_ = 0;
+  poolBytes_ = 0;
+  systemAllocationCount_ = 0;
+}
+
+void VulkanHostAllocator::Destroy() {
+
+  for (void* chunk : chunks_) {
+    std::free(chunk);
+  }
+  chunks_.clear();
+
+  for (Pool &pool : pools_) {
+    pool.freeList = nullptr;
+  }
+  poolBytes_ = 0;
+}
+
+VulkanHostAllocatorStats VulkanHostAllocator::GetStats() const {
+
+  VulkanHostAllocatorStats stats;
+  for (uint32_t i = 0; i < kVulkanAllocationScopeCount; ++i) {
+    stats.scopes[i].allocationCount = scopes_[i].allocationCount.load(std::memory_order_relaxed);
+    stats.scopes[i].pooledCount = scopes_[i].pooledCount.load(std::memory_order_relaxed);
+    stats.scopes[i].liveCount = scopes_[i].liveCount.load(std::memory_order_relaxed);
+    stats.scopes[i].liveBytes = scopes_[i].liveBytes.load(std::memory_order_relaxed);
+    stats.scopes[i].peakBytes = scopes_[i].peakBytes.load(std::memory_order_relaxed);
+    stats.scopes[i].internalBytes = scopes_[i].internalBytes.load(std::memory_order_relaxed);
+  }
+  stats.liveBytes = liveBytes_.load(std::memory_order_relaxed);
+  stats.peakBytes = peakBytes_.load(std::memory_order_relaxed);
+  stats.poolBytes = poolBytes_.load(std::memory_order_relaxed);
+  stats.systemAllocationCount = systemAllocationCount_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void VulkanHostAllocator::PrintStats(std::ostream &out) const {
+
+  static const char* scopeNames[kVulkanAllocationScopeCount] = { "command", "object", "cache", "device", "instance" };
+
+  const VulkanHostAllocatorStats stats = GetStats();
+  out << "Vulkan host memory: " << stats.liveBytes / 1024 << " KiB live, " << stats.peakBytes / 1024 << " KiB peak, "
+    << stats.poolBytes / 1024 << " KiB pooled, " << stats.systemAllocationCount << " system allocations" << std::endl;
+
+  for (uint32_t i = 0; i < kVulkanAllocationScopeCount; ++i) {
+    const VulkanHostAllocationScopeStats &scope = stats.scopes[i];
+    if (scope.allocationCount == 0 && scope.internalBytes == 0) continue;
+
+    out << "  " << scopeNames[i] << ": " << scope.allocationCount << " allocations (" << scope.pooledCount << " pooled), "
+      << scope.liveCount << " live in " << scope.liveBytes / 1024 << " KiB, " << scope.peakBytes / 1024 << " KiB peak";
+    if (scope.internalBytes > 0) {
+      out << ", " << scope.internalBytes / 1024 << " KiB internal";
+    }
+    out << std::endl;
+  }
+}
+
+void* VulkanHostAllocator::allocationCallback(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+  return static_cast<VulkanHostAllocator*>(userData)->allocate(size, alignment, scope);
+}
+
+void* VulkanHostAllocator::reallocationCallback(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+  return static_cast<VulkanHostAllocator*>(userData)->reallocate(original, size, alignment, scope);
+}
+
+void VulkanHostAllocator::freeCallback(void* userData, void* memory) {
+  static_cast<VulkanHostAllocator*>(userData)->free(memory);
+}
+
+void VulkanHostAllocator::internalAllocationCallback(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope) {
+  static_cast<VulkanHostAllocator*>(userData)->scopes_[scope].internalBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void VulkanHostAllocator::internalFreeCallback(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope) {
+  static_cast<VulkanHostAllocator*>(userData)->scopes_[scope].internalBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void* VulkanHostAllocator::allocate(size_t size, size_t alignment, VkSystemAllocationScope scope) {
+
+  if (size == 0) {
+    return nullptr;
+  }
+
+  const size_t headerSpace = getHeaderSpace(alignment);
+
+  // blocks are aligned to their power of two size, which is at least headerSpace and so at least alignment
+  if (headerSpace + size <= kMaxPooledBlockSize) {
+    const uint32_t sizeClass = getSizeClass(headerSpace + size);
+    void* block = allocateBlock(sizeClass);
+    if (block == nullptr) {
+      return nullptr;
+    }
+
+    void* memory = static_cast<char*>(block) + headerSpace;
+    AllocationHeader* header = getHeader(memory);
+    header->size = size;
+    header->offset = static_cast<uint32_t>(headerSpace);
+    header->scope = static_cast<uint8_t>(scope);
+    header->sizeClass = static_cast<uint8_t>(sizeClass);
+
+    countAllocation(scope, size, true);
+    return memory;
+  }
+
+  // malloc only guarantees fundamental alignment, so leave room to move the pointer up to alignment
+  void* system = std::malloc(headerSpace + size + alignment);
+  if (system == nullptr) {
+    return nullptr;
+  }
+  systemAllocationCount_.fetch_add(1, std::memory_order_relaxed);
+
+  const uintptr_t address = reinterpret_cast<uintptr_t>(system) + headerSpace;
+  void* memory = reinterpret_cast<void*>((address + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1));
+  AllocationHeader* header = getHeader(memory);
+  header->size = size;
+  header->offset = static_cast<uint32_t>(static_cast<char*>(memory) - static_cast<char*>(system));
+  header->scope = static_cast<uint8_t>(scope);
+  header->sizeClass = kUnpooled;
+
+  countAllocation(scope, size, false);
+  return memory;
+}
+
+void* VulkanHostAllocator::reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+
+  if (original == nullptr) {
+    return allocate(size, alignment, scope);
+  }
+  if (size == 0) {
+    free(original);
+    return nullptr;
+  }
+
+  // shrinking, or growing within the block's size class, keeps the allocation where it is
+  AllocationHeader* header = getHeader(original);
+  if (header->sizeClass != kUnpooled && header->offset + size <= getClassSize(header->sizeClass)) {
+    countFree(static_cast<VkSystemAllocationScope>(header->scope), static_cast<size_t>(header->size));
+    countAllocation(scope, size, true);
+    header->size = size;
+    header->scope = static_cast<uint8_t>(scope);
+    return original;
+  }
+
+  void* memory = allocate(size, alignment, scope);
+  if (memory == nullptr) {
+    // the original stays untouched, as the spec wants it
+    return nullptr;
+  }
+
+  memcpy(memory, original, std::min(size, static_cast<size_t>(header->size)));
+  free(original);
+  return memory;
+}
+
+void VulkanHostAllocator::free(void* memory) {
+
+  if (memory == nullptr) {
+    return;
+  }
+
+  AllocationHeader* header = getHeader(memory);
+  countFree(static_cast<VkSystemAllocationScope>(header->scope), static_cast<size_t>(header->size));
+
+  void* block = static_cast<char*>(memory) - header->offset;
+  if (header->sizeClass == kUnpooled) {
+    std::free(block);
+    return;
+  }
+
+  Pool &pool = pools_[header->sizeClass];
+  std::lock_guard<std::mutex> lock(pool.mutex);
+  *static_cast<void**>(block) = pool.freeList;
+  pool.freeList = block;
+}
+
+void* VulkanHostAllocator::allocateBlock(uint32_t sizeClass) {
+
+  Pool &pool = pools_[sizeClass];
+  std::lock_guard<std::mutex> lock(pool.mutex);
+
+  if (pool.freeList == nullptr) {
+    // chunks start at kMaxPooledBlockSize alignment, so every block in them is aligned to its size
+    void* chunk = std::malloc(kPoolChunkSize + kMaxPooledBlockSize);
+    if (chunk == nullptr) {
+      return nullptr;
+    }
+    systemAllocationCount_.fetch_add(1, std::memory_order_relaxed);
+    poolBytes_.fetch_add(kPoolChunkSize + kMaxPooledBlockSize, std::memory_order_relaxed);
+    {
+      std::lock_guard<std::mutex> chunkLock(chunkMutex_);
+      chunks_.push_back(chunk);
+    }
+
+    const uintptr_t start = (reinterpret_cast<uintptr_t>(chunk) + kMaxPooledBlockSize - 1) & ~static_cast<uintptr_t>(kMaxPooledBlockSize - 1);
+    const size_t classSize = getClassSize(sizeClass);
+    for (size_t offset = kPoolChunkSize; offset >= classSize; offset -= classSize) {
+      void* block = reinterpret_cast<void*>(start + offset - classSize);
+      *static_cast<void**>(block) = pool.freeList;
+      pool.freeList = block;
+    }
+  }
+
+  void* block = pool.freeList;
+  pool.freeList = *static_cast<void**>(block);
+  return block;
+}
+
+void VulkanHostAllocator::countAllocation(VkSystemAllocationScope scope, size_t size, bool pooled) {
+
+  ScopeCounters &counters = scopes_[scope];
+  counters.allocationCount.fetch_add(1, std::memory_order_relaxed);
+  if (pooled) {
+    counters.pooledCount.fetch_add(1, std::memory_order_relaxed);
+  }
+  counters.liveCount.fetch_add(1, std::memory_order_relaxed);
+  updatePeak(counters.peakBytes, counters.liveBytes.fetch_add(size, std::memory_order_relaxed) + size);
+  updatePeak(peakBytes_, liveBytes_.fetch_add(size, std::memory_order_relaxed) + size);
+}
+
+void VulkanHostAllocator::countFree(VkSystemAllocationScope scope, size_t size) {
+
+  ScopeCounters &counters = scopes_[scope];
+  counters.liveCount.fetch_sub(1, std::memory_order_relaxed);
+  counters.liveBytes.fetch_sub(size, std::memory_order_relaxed);
+  liveBytes_.fetch_sub(size, std::memory_order_relaxed);
+}
+
+}
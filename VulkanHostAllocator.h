@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include <vulkan\vulkan.hpp>
+
+namespace vks {
+
+// VkSystemAllocationScope runs from COMMAND to INSTANCE
+const uint32_t kVulkanAllocationScopeCount = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+
+struct VulkanHostAllocationScopeStats {
+  // every allocation and reallocation so far
+  uint64_t allocationCount = 0;
+  // of allocationCount, served out of the small block pools
+  uint64_t pooledCount = 0;
+  uint64_t liveCount = 0;
+  uint64_t liveBytes = 0;
+  uint64_t peakBytes = 0;
+  // memory the driver allocated itself and only reported, e.g. executable memory for shaders
+  uint64_t internalBytes = 0;
+};
+
+struct VulkanHostAllocatorStats {
+  VulkanHostAllocationScopeStats scopes[kVulkanAllocationScopeCount];
+  uint64_t liveBytes = 0;
+  uint64_t peakBytes = 0;
+  // what the pools took from the system, pooled memory is only given back by Destroy
+  uint64_t poolBytes = 0;
+  // malloc calls, for the pools and for allocations too large for them
+  uint64_t systemAllocationCount = 0;
+};
+
+// VkAllocationCallbacks that account the driver's host allocations per allocation scope and serve small ones out of
+// size class pools, so creating and destroying objects doesn't go to the system allocator every time.
+//
+// Thread safe, the driver calls it from whichever thread creates objects.
+class VulkanHostAllocator {
+  public:
+    // allocations plus their header up to this size come from the pools
+    static const size_t kMaxPooledBlockSize = 1024;
+    static const size_t kPoolChunkSize = 16 * 1024;
+
+    void Init();
+    // every object created with GetCallbacks has to be destroyed already
+    void Destroy();
+
+    // stays valid until Destroy
+    const VkAllocationCallbacks* GetCallbacks() const { return &callbacks_; }
+
+    VulkanHostAllocatorStats GetStats() const;
+    void PrintStats(std::ostream &out) const;
+
+  private:
+    // 32 to kMaxPooledBlockSize bytes, in powers of two
+    static const uint32_t kSizeClassCount = 6;
+    static const uint8_t kUnpooled = 0xff;
+
+    struct Pool {
+      std::mutex mutex;
+      void* freeList = nullptr;
+    };
+
+    struct ScopeCounters {
+      std::atomic<uint64_t> allocationCount;
+      std::atomic<uint64_t> pooledCount;
+      std::atomic<uint64_t> liveCount;
+      std::atomic<uint64_t> liveBytes;
+      std::atomic<uint64_t> peakBytes;
+      std::atomic<uint64_t> internalBytes;
+    };
+
+    static VKAPI_ATTR void* VKAPI_CALL allocationCallback(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    static VKAPI_ATTR void* VKAPI_CALL reallocationCallback(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    static VKAPI_ATTR void VKAPI_CALL freeCallback(void* userData, void* memory);
+    static VKAPI_ATTR void VKAPI_CALL internalAllocationCallback(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+    static VKAPI_ATTR void VKAPI_CALL internalFreeCallback(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+    void* allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+    void* reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    void free(void* memory);
+
+    void* allocateBlock(uint32_t sizeClass);
+    void countAllocation(VkSystemAllocationScope scope, size_t size, bool pooled);
+    void countFree(VkSystemAllocationScope scope, size_t size);
+
+    VkAllocationCallbacks callbacks_ = {};
+
+    Pool pools_[kSizeClassCount];
+    std::mutex chunkMutex_;
+    std::vector<void*> chunks_;
+
+    ScopeCounters scopes_[kVulkanAllocationScopeCount] = {};
+    std::atomic<uint64_t> liveBytes_{ 0 };
+    std::atomic<uint64_t> peakBytes_{ 0 };
+    std::atomic<uint64_t> poolBytes_{ 0 };
+    std::atomic<uint64_t> systemAllocationCount_{ 0 };
+};
+
+}
@@ -0,0 +1,344 @@
+#include "VulkanIndirectScene.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "VulkanUtils.h"
+
+namespace vks {
+
+// two triangles, clockwise like the default triangle
+const uint16_t kQuadIndices[] = { 0, 1, 2, 2, 3, 0 };
+const uint32_t kQuadIndexCount = sizeof(kQuadIndices) / sizeof(kQuadIndices[0]);
+
+// small enough to always fit into the uploader's staging ring next to other uploads
+const VkDeviceSize kSceneUploadChunkSize = 4 * 1024 * 1024;
+
+struct CullPushConstants {
+  float planes[6][4];
+  uint32_t objectCount;
+};
+
+std::vector<IndirectSceneObject> BuildStressScene(uint32_t objectCount, uint32_t seed) {
+
+  std::vector<IndirectSceneObject> objects(objectCount);
+
+  // xorshift, good enough for jitter and colors and the same on every platform
+  uint32_t state = seed != 0 ? seed : 1;
+  const auto random = [&]() -> float {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return static_cast<float>(state >> 8) / static_cast<float>(1 << 24);
+  };
+
+  const float kExtent = 2.0f;
+  const uint32_t columns = std::max(1u, static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(objectCount)))));
+  const float spacing = 2.0f * kExtent / columns;
+  const float size = spacing * 0.8f;
+
+  for (uint32_t i = 0; i < objectCount; ++i) {
+    IndirectSceneObject &object = objects[i];
+
+    float x = -kExtent + (i % columns + 0.5f) * spacing + (random() - 0.5f) * spacing * 0.2f;
+    float y = -kExtent + (i / columns + 0.5f) * spacing + (random() - 0.5f) * spacing * 0.2f;
+
+    object.transform[0] = x;
+    object.transform[1] = y;
+    object.transform[2] = size;
+    object.transform[3] = size;
+
+    // circumscribed circle of the quad
+    object.sphere[0] = x;
+    object.sphere[1] = y;
+    object.sphere[2] = 0.0f;
+    object.sphere[3] = size * 0.70710678f;
+
+    object.tint[0] = 0.25f + 0.75f * random();
+    object.tint[1] = 0.25f + 0.75f * random();
+    object.tint[2] = 0.25f + 0.75f * random();
+    object.tint[3] = 1.0f;
+  }
+
+  return objects;
+}
+
+VkResult VulkanIndirectScene::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer &buffer, VulkanMemoryAllocation &memory) {
+
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = size;
+  bufferInfo.usage = usage;
+  if (queueFamilies_.size() > 1) {
+    bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies_.size());
+    bufferInfo.pQueueFamilyIndices = queueFamilies_.data();
+  }
+  else {
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  }
+
+  return allocator_->CreateBuffer(bufferInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
+}
+
+VkResult VulkanIndirectScene::Init(
+  VkDevice device,
+  VulkanMemoryAllocator &allocator,
+  VulkanDescriptorLayoutCache &layoutCache,
+  const std::vector<uint32_t> &queueFamilies,
+  uint32_t frameSlotCount,
+  uint32_t objectCount,
+  const VkAllocationCallbacks* allocationCallbacks) {
+
+  device_ = device;
+  allocationCallbacks_ = allocationCallbacks;
+  allocator_ = &allocator;
+  objectCount_ = objectCount;
+  queueFamilies_ = queueFamilies;
+
+  // an empty storage buffer is not allowed, keep at least one element around
+  const VkDeviceSize objectCapacity = std::max(objectCount, 1u);
+
+  VkResult result;
+  if ((result = createBuffer(
+    objectCapacity * sizeof(IndirectSceneObject),
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    objectBuffer_,
+    objectMemory_)) != VK_SUCCESS) {
+    return result;
+  }
+
+  if ((result = createBuffer(
+    sizeof(kQuadIndices),
+    VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    indexBuffer_,
+    indexMemory_)) != VK_SUCCESS) {
+    return result;
+  }
+
+  VkDescriptorSetLayoutBinding bindings[3] = {};
+  bindings[0].binding = 0;
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  bindings[0].descriptorCount = 1;
+  bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+  bindings[1] = bindings[0];
+  bindings[1].binding = 1;
+  bindings[2] = bindings[0];
+  bindings[2].binding = 2;
+  bindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  if ((result = layoutCache.GetLayout(bindings, 3, descriptorSetLayout_)) != VK_SUCCESS) {
+    return result;
+  }
+
+  frames_.resize(frameSlotCount);
+  for (auto &frame : frames_) {
+    if ((result = createBuffer(
+      objectCapacity * sizeof(uint32_t),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      frame.visibleBuffer,
+      frame.visibleMemory)) != VK_SUCCESS) {
+      return result;
+    }
+
+    // written by vkCmdUpdateBuffer and the cull shader, read as the indirect command
+    if ((result = createBuffer(
+      sizeof(VkDrawIndexedIndirectCommand),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      frame.drawBuffer,
+      frame.drawMemory)) != VK_SUCCESS) {
+      return result;
+    }
+  }
+
+  return VK_SUCCESS;
+}
+
+VkResult VulkanIndirectScene::CreateCullPipeline(VkPipelineCache pipelineCache, const uint32_t* cullShaderCode, size_t cullShaderCodeSize) {
+
+  VkResult result;
+  if ((result = createVkShaderModule(device_, cullShaderCode, cullShaderCodeSize, allocationCallbacks_, cullShaderModule_)) != VK_SUCCESS) {
+    return result;
+  }
+
+  VkPushConstantRange pushConstantRange = {};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(CullPushConstants);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout_;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+  if ((result = vkCreatePipelineLayout(device_, &pipelineLayoutInfo, allocationCallbacks_, &cullPipelineLayout_)) != VK_SUCCESS) {
+    return result;
+  }
+
+  VkComputePipelineCreateInfo pipelineInfo = {};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = cullShaderModule_;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.layout = cullPipelineLayout_;
+  pipelineInfo.basePipelineIndex = -1;
+
+  return vkCreateComputePipelines(device_, pipelineCache, 1, &pipelineInfo, allocationCallbacks_, &cullPipeline_);
+}
+
+VkResult VulkanIndirectScene::Upload(VulkanUploader &uploader, const std::vector<IndirectSceneObject> &objects, VulkanUploadTicket &ticket) {
+
+  // a full ring is only freed by finished transfers, there are no frames running yet to do that for us
+  const auto upload = [&](VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size, VkPipelineStageFlags stages, VkAccessFlags access) -> VkResult {
+    const VkSharingMode sharingMode = queueFamilies_.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    VkResult result = uploader.UploadBuffer(buffer, offset, data, size, stages, access, sharingMode);
+    if (result != VK_NOT_READY) {
+      return result;
+    }
+
+    VulkanUploadTicket flushed;
+    if ((result = uploader.Flush(flushed)) != VK_SUCCESS ||
+      (result = uploader.WaitForTransfer(flushed, UINT64_MAX)) != VK_SUCCESS) {
+      return result;
+    }
+    uploader.Update(0);
+
+    return uploader.UploadBuffer(buffer, offset, data, size, stages, access, sharingMode);
+  };
+
+  VkResult result;
+  if ((result = upload(indexBuffer_, 0, kQuadIndices, sizeof(kQuadIndices), VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT)) != VK_SUCCESS) {
+    return result;
+  }
+
+  const char* objectData = reinterpret_cast<const char*>(objects.data());
+  const VkDeviceSize objectBytes = std::min<size_t>(objects.size(), objectCount_) * sizeof(IndirectSceneObject);
+
+  for (VkDeviceSize offset = 0; offset < objectBytes; offset += kSceneUploadChunkSize) {
+    if ((result = upload(
+      objectBuffer_,
+      offset,
+      objectData + offset,
+      std::min(kSceneUploadChunkSize, objectBytes - offset),
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+      VK_ACCESS_SHADER_READ_BIT)) != VK_SUCCESS) {
+      return result;
+    }
+  }
+
+  return uploader.Flush(ticket);
+}
+
+void VulkanIndirectScene::Destroy() {
+
+  if (cullPipeline_ != VK_NULL_HANDLE) {
+    vkDestroyPipeline(device_, cullPipeline_, allocationCallbacks_);
+  }
+
+  if (cullPipelineLayout_ != VK_NULL_HANDLE) {
+    vkDestroyPipelineLayout(device_, cullPipelineLayout_, allocationCallbacks_);
+  }
+
+  if (cullShaderModule_ != VK_NULL_HANDLE) {
+    vkDestroyShaderModule(device_, cullShaderModule_, allocationCallbacks_);
+  }
+
+  for (auto &frame : frames_) {
+    if (frame.visibleBuffer != VK_NULL_HANDLE) {
+      allocator_->DestroyBuffer(frame.visibleBuffer, frame.visibleMemory);
+    }
+    if (frame.drawBuffer != VK_NULL_HANDLE) {
+      allocator_->DestroyBuffer(frame.drawBuffer, frame.drawMemory);
+    }
+  }
+  frames_.clear();
+
+  if (indexBuffer_ != VK_NULL_HANDLE) {
+    allocator_->DestroyBuffer(indexBuffer_, indexMemory_);
+  }
+
+  if (objectBuffer_ != VK_NULL_HANDLE) {
+    allocator_->DestroyBuffer(objectBuffer_, objectMemory_);
+  }
+}
+
+VkResult VulkanIndirectScene::BeginFrame(uint32_t frameSlot, VulkanDescriptorAllocator &descriptorAllocator) {
+
+  FrameResources &frame = frames_[frameSlot];
+
+  // the previous set of this slot went away with the descriptor allocator's reset of it
+  VkResult result;
+  if ((result = descriptorAllocator.AllocateFrameSet(descriptorSetLayout_, frame.descriptorSet)) != VK_SUCCESS) {
+    return result;
+  }
+
+  VkDescriptorBufferInfo bufferInfos[3] = {};
+  bufferInfos[0].buffer = objectBuffer_;
+  bufferInfos[0].range = VK_WHOLE_SIZE;
+  bufferInfos[1].buffer = frame.visibleBuffer;
+  bufferInfos[1].range = VK_WHOLE_SIZE;
+  bufferInfos[2].buffer = frame.drawBuffer;
+  bufferInfos[2].range = VK_WHOLE_SIZE;
+
+  VkWriteDescriptorSet writes[3] = {};
+  for (uint32_t i = 0; i < 3; ++i) {
+    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet = frame.descriptorSet;
+    writes[i].dstBinding = i;
+    writes[i].descriptorCount = 1;
+    writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[i].pBufferInfo = &bufferInfos[i];
+  }
+
+  vkUpdateDescriptorSets(device_, 3, writes, 0, nullptr);
+
+  return VK_SUCCESS;
+}
+
+void VulkanIndirectScene::RecordCulling(VkCommandBuffer commandBuffer, uint32_t frameSlot, const Frustum &frustum) {
+
+  FrameResources &frame = frames_[frameSlot];
+
+  // the previous frame in this slot finished before recording started, so only this frame's own accesses need ordering
+  VkDrawIndexedIndirectCommand drawCommand = {};
+  drawCommand.indexCount = kQuadIndexCount;
+  drawCommand.instanceCount = 0;
+  drawCommand.firstIndex = 0;
+  drawCommand.vertexOffset = 0;
+  drawCommand.firstInstance = 0;
+  vkCmdUpdateBuffer(commandBuffer, frame.drawBuffer, 0, sizeof(drawCommand), &drawCommand);
+
+  VkBufferMemoryBarrier resetBarrier = {};
+  resetBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  resetBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  resetBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  resetBarrier.buffer = frame.drawBuffer;
+  resetBarrier.offset = 0;
+  resetBarrier.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &resetBarrier, 0, nullptr);
+
+  CullPushConstants pushConstants;
+  std::copy(&frustum.planes[0][0], &frustum.planes[0][0] + 24, &pushConstants.planes[0][0]);
+  pushConstants.objectCount = objectCount_;
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline_);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout_, 0, 1, &frame.descriptorSet, 0, nullptr);
+  vkCmdPushConstants(commandBuffer, cullPipelineLayout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+  vkCmdDispatch(commandBuffer, (objectCount_ + kCullGroupSize - 1) / kCullGroupSize, 1, 1);
+}
+
+void VulkanIndirectScene::RecordDraw(VkCommandBuffer commandBuffer, uint32_t frameSlot, VkPipelineLayout pipelineLayout) {
+
+  FrameResources &frame = frames_[frameSlot];
+
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &frame.descriptorSet, 0, nullptr);
+  vkCmdBindIndexBuffer(commandBuffer, indexBuffer_, 0, VK_INDEX_TYPE_UINT16);
+  vkCmdDrawIndexedIndirect(commandBuffer, frame.drawBuffer, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan\vulkan.hpp>
+
+#include "Frustum.h"
+#include "VulkanDescriptorAllocator.h"
+#include "VulkanMemoryAllocator.h"
+#include "VulkanUploader.h"
+
+namespace vks {
+
+// matches SceneObject in cull.comp and scene.vert (std430)
+struct IndirectSceneObject {
+  // xyz center, w radius
+  float sphere[4];
+  // xy offset, zw scale of the unit quad
+  float transform[4];
+  float tint[4];
+};
+
+// Deterministic grid of jittered quads covering four times the default view, so that panning around
+// keeps roughly a quarter of them visible.
+std::vector<IndirectSceneObject> BuildStressScene(uint32_t objectCount, uint32_t seed);
+
+// GPU driven rendering of a static set of quads: every frame a compute pass culls the objects' bounding spheres
+// against the view frustum and compacts the visible ids, bumping the instance count of a single
+// VkDrawIndexedIndirectCommand that the graphics pass then draws. The CPU cost per frame does not
+// depend on the object count.
+//
+// Buffers written by the GPU exist once per frame in flight, the objects and the quad index buffer are shared.
+// Not thread safe, meant to be driven by the render thread.
+class VulkanIndirectScene {
+  public:
+    static const uint32_t kCullGroupSize = 64;
+
+    // Creates the buffers both passes use, their descriptor sets are frame sets written by BeginFrame.
+    // With more than one entry in queueFamilies the buffers are shared concurrently between them, which has to cover
+    // the graphics and compute families when culling runs on another queue family, and the uploader's transfer family.
+    VkResult Init(
+      VkDevice device,
+      VulkanMemoryAllocator &allocator,
+      VulkanDescriptorLayoutCache &layoutCache,
+      const std::vector<uint32_t> &queueFamilies,
+      uint32_t frameSlotCount,
+      uint32_t objectCount,
+      const VkAllocationCallbacks* allocationCallbacks = nullptr);
+    VkResult CreateCullPipeline(VkPipelineCache pipelineCache, const uint32_t* cullShaderCode, size_t cullShaderCodeSize);
+    // Queues the objects and the quad indices on the uploader, ticket has to be complete before the first Record call.
+    // Blocks on the transfer queue if they don't fit into the staging ring at once.
+    VkResult Upload(VulkanUploader &uploader, const std::vector<IndirectSceneObject> &objects, VulkanUploadTicket &ticket);
+    // the device has to be idle
+    void Destroy();
+
+    // Allocates the descriptor set of frameSlot out of the frame sets of descriptorAllocator, after its BeginFrame of
+    // the same slot and before recording anything of this frame.
+    VkResult BeginFrame(uint32_t frameSlot, VulkanDescriptorAllocator &descriptorAllocator);
+
+    // Outside of a render pass, before RecordDraw of the same frame slot. Writes GetDrawBuffer and GetVisibleBuffer
+    // in the compute shader stage, the caller orders that before the draw: with a barrier, or a render graph, on the
+    // same queue, with the semaphore between the submits from another one.
+    void RecordCulling(VkCommandBuffer commandBuffer, uint32_t frameSlot, const Frustum &frustum);
+    // inside the render pass, after binding a pipeline whose layout has GetDescriptorSetLayout as set 1
+    void RecordDraw(VkCommandBuffer commandBuffer, uint32_t frameSlot, VkPipelineLayout pipelineLayout);
+
+    VkDescriptorSetLayout GetDescriptorSetLayout() const { return descriptorSetLayout_; }
+    // read by RecordDraw as indirect commands and in the vertex shader respectively
+    VkBuffer GetDrawBuffer(uint32_t frameSlot) const { return frames_[frameSlot].drawBuffer; }
+    VkBuffer GetVisibleBuffer(uint32_t frameSlot) const { return frames_[frameSlot].visibleBuffer; }
+    uint32_t GetObjectCount() const { return objectCount_; }
+
+  private:
+    struct FrameResources {
+      VkBuffer visibleBuffer = VK_NULL_HANDLE;
+      VulkanMemoryAllocation visibleMemory;
+      VkBuffer drawBuffer = VK_NULL_HANDLE;
+      VulkanMemoryAllocation drawMemory;
+      // valid from BeginFrame until the next BeginFrame of the slot
+      VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    };
+
+    VkResult createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer &buffer, VulkanMemoryAllocation &memory);
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    const VkAllocationCallbacks* allocationCallbacks_ = nullptr;
+    VulkanMemoryAllocator* allocator_ = nullptr;
+    uint32_t objectCount_ = 0;
+    std::vector<uint32_t> queueFamilies_;
+
+    VkBuffer objectBuffer_ = VK_NULL_HANDLE;
+    VulkanMemoryAllocation objectMemory_;
+    VkBuffer indexBuffer_ = VK_NULL_HANDLE;
+    VulkanMemoryAllocation indexMemory_;
+    std::vector<FrameResources> frames_;
+
+    // owned by the layout cache
+    VkDescriptorSetLayout descriptorSetLayout_ = VK_NULL_HANDLE;
+
+    VkShaderModule cullShaderModule_ = VK_NULL_HANDLE;
+    VkPipelineLayout cullPipelineLayout_ = VK_NULL_HANDLE;
+    VkPipeline cullPipeline_ = VK_NULL_HANDLE;
+};
+
+}
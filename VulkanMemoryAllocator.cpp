@@ -0,0 +1,508 @@
+#include "VulkanMemoryAllocator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace vks {
+
+uint32_t log2OfPowerOfTwo(VkDeviceSize value) {
+  uint32_t shift = 0;
+  while ((VkDeviceSize(1) << shift) < value) {
+    shift++;
+  }
+  return shift;
+}
+
+BuddyAllocator::BuddyAllocator(VkDeviceSize size, VkDeviceSize minNodeSize)
+  : size_(size),
+  minNodeSize_(minNodeSize),
+  minNodeShift_(log2OfPowerOfTwo(minNodeSize)),
+  maxOrder_(log2OfPowerOfTwo(size) - log2OfPowerOfTwo(minNodeSize)),
+  freeBytes_(0) {
+
+  freeLists_.resize(maxOrder_ + 1);
+  freeListPositions_.resize(maxOrder_ + 1);
+  for (uint32_t order = 0; order <= maxOrder_; ++order) {
+    freeListPositions_[order].resize(static_cast<size_t>(size_ >> (minNodeShift_ + order)), -1);
+  }
+
+  pushFree(maxOrder_, 0);
+}
+
+bool BuddyAllocator::Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset, uint32_t &order) {
+
+  VkDeviceSize nodeSize = std::max(std::max(size, alignment), minNodeSize_);
+  order = log2OfPowerOfTwo(nodeSize) - minNodeShift_;
+
+  if (order > maxOrder_) {
+    return false;
+  }
+
+  uint32_t freeOrder = order;
+  while (freeOrder <= maxOrder_ && freeLists_[freeOrder].empty()) {
+    freeOrder++;
+  }
+
+  if (freeOrder > maxOrder_) {
+    return false;
+  }
+
+  offset = freeLists_[freeOrder].back();
+  removeFree(freeOrder, offset);
+
+  // split down to the requested size, the upper halves become free buddies
+  while (freeOrder > order) {
+    freeOrder--;
+    pushFree(freeOrder, offset + NodeSize(freeOrder));
+  }
+
+  return true;
+}
+
+void BuddyAllocator::Free(VkDeviceSize offset, uint32_t order) {
+
+  while (order < maxOrder_) {
+    VkDeviceSize buddyOffset = offset ^ NodeSize(order);
+    if (!isFree(order, buddyOffset)) {
+      break;
+    }
+
+    removeFree(order, buddyOffset);
+    offset = std::min(offset, buddyOffset);
+    order++;
+  }
+
+  pushFree(order, offset);
+}
+
+VkDeviceSize BuddyAllocator::LargestFreeNode() const {
+  for (uint32_t order = maxOrder_ + 1; order-- > 0;) {
+    if (!freeLists_[order].empty()) {
+      return NodeSize(order);
+    }
+  }
+  return 0;
+}
+
+void BuddyAllocator::pushFree(uint32_t order, VkDeviceSize offset) {
+  auto &freeList = freeLists_[order];
+  freeListPositions_[order][static_cast<size_t>(offset >> (minNodeShift_ + order))] = static_cast<int32_t>(freeList.size());
+  freeList.push_back(offset);
+  freeBytes_ += NodeSize(order);
+}
+
+void BuddyAllocator::removeFree(uint32_t order, VkDeviceSize offset) {
+  auto &freeList = freeLists_[order];
+  auto &positions = freeListPositions_[order];
+
+  size_t nodeIndex = static_cast<size_t>(offset >> (minNodeShift_ + order));
+  int32_t position = positions[nodeIndex];
+
+  // swap with the last entry to unlink in O(1)
+  VkDeviceSize lastOffset = freeList.back();
+  freeList[position] = lastOffset;
+  positions[static_cast<size_t>(lastOffset >> (minNodeShift_ + order))] = position;
+  freeList.pop_back();
+  positions[nodeIndex] = -1;
+
+  freeBytes_ -= NodeSize(order);
+}
+
+bool BuddyAllocator::isFree(uint32_t order, VkDeviceSize offset) const {
+  return freeListPositions_[order][static_cast<size_t>(offset >> (minNodeShift_ + order))] >= 0;
+}
+
+void VulkanMemoryAllocator::Init(
+  VkPhysicalDevice physicalDevice,
+  VkDevice device,
+  VkDeviceSize blockSize,
+  const VkAllocationCallbacks* allocationCallbacks) {
+
+  device_ = device;
+  allocationCallbacks_ = allocationCallbacks;
+  blockSize_ = VkDeviceSize(1) << log2OfPowerOfTwo(blockSize);
+
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties_);
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  maxAllocationCount_ = properties.limits.maxMemoryAllocationCount;
+
+  pools_.resize(memoryProperties_.memoryTypeCount * kVulkanMemoryResourceKindCount);
+}
+
+void VulkanMemoryAllocator::Destroy() {
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  for (auto &pool : pools_) {
+    for (auto &block : pool.blocks) {
+      if (block.memory != VK_NULL_HANDLE) {
+        freeDeviceMemory(block.memory, block.mappedData);
+      }
+    }
+    pool.blocks.clear();
+  }
+}
+
+VkResult VulkanMemoryAllocator::Allocate(
+  const VkMemoryRequirements &requirements,
+  VkMemoryPropertyFlags properties,
+  VulkanMemoryResourceKind kind,
+  VulkanMemoryAllocation &output) {
+
+  uint32_t memoryTypeIndex;
+  if (!findMemoryType(requirements.memoryTypeBits, properties, memoryTypeIndex)) {
+    return VK_ERROR_FEATURE_NOT_PRESENT;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  output = {};
+  output.memoryTypeIndex = memoryTypeIndex;
+  output.kind = kind;
+  output.size = requirements.size;
+
+  // big resources would waste most of a block, give them their own memory
+  if (requirements.size > blockSize_ / 2) {
+    VkResult result = allocateDeviceMemory(requirements.size, memoryTypeIndex, output.memory, output.mappedData);
+    if (result != VK_SUCCESS) {
+      return result;
+    }
+
+    output.blockIndex = kDedicatedVulkanMemoryBlock;
+    dedicatedAllocationCount_++;
+    dedicatedBytes_ += requirements.size;
+    allocationCount_++;
+    allocatedBytes_ += requirements.size;
+    requestedBytes_ += requirements.size;
+    return VK_SUCCESS;
+  }
+
+  Pool &pool = pools_[memoryTypeIndex * kVulkanMemoryResourceKindCount + kind];
+
+  uint32_t blockIndex = 0;
+  for (; blockIndex < pool.blocks.size(); ++blockIndex) {
+    Block &block = pool.blocks[blockIndex];
+    if (block.memory != VK_NULL_HANDLE && block.buddy.Allocate(requirements.size, requirements.alignment, output.offset, output.order)) {
+      break;
+    }
+  }
+
+  if (blockIndex == pool.blocks.size()) {
+    VkDeviceMemory memory;
+    void* mappedData;
+    VkResult result = allocateDeviceMemory(blockSize_, memoryTypeIndex, memory, mappedData);
+    if (result != VK_SUCCESS) {
+      return result;
+    }
+
+    // even an empty block can't satisfy alignments larger than the block
+    Block block = { memory, mappedData, BuddyAllocator(blockSize_, kMinAllocationSize), 0 };
+    if (!block.buddy.Allocate(requirements.size, requirements.alignment, output.offset, output.order)) {
+      freeDeviceMemory(memory, mappedData);
+      return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
+
+    // reuse the slot of a previously released block so indices of live allocations stay valid
+    blockIndex = 0;
+    while (blockIndex < pool.blocks.size() && pool.blocks[blockIndex].memory != VK_NULL_HANDLE) {
+      blockIndex++;
+    }
+
+    if (blockIndex == pool.blocks.size()) {
+      pool.blocks.push_back(std::move(block));
+    }
+    else {
+      pool.blocks[blockIndex] = std::move(block);
+    }
+  }
+
+  Block &block = pool.blocks[blockIndex];
+  block.allocationCount++;
+
+  output.memory = block.memory;
+  output.blockIndex = blockIndex;
+  if (block.mappedData != nullptr) {
+    output.mappedData = static_cast<char*>(block.mappedData) + output.offset;
+  }
+
+  allocationCount_++;
+  allocatedBytes_ += block.buddy.NodeSize(output.order);
+  requestedBytes_ += requirements.size;
+
+  return VK_SUCCESS;
+}
+
+void VulkanMemoryAllocator::Free(VulkanMemoryAllocation &allocation) {
+
+  if (allocation.memory == VK_NULL_HANDLE) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  allocationCount_--;
+  requestedBytes_ -= allocation.size;
+
+  if (allocation.blockIndex == kDedicatedVulkanMemoryBlock) {
+    freeDeviceMemory(allocation.memory, allocation.mappedData);
+    dedicatedAllocationCount_--;
+    dedicatedBytes_ -= allocation.size;
+    allocatedBytes_ -= allocation.size;
+    allocation = {};
+    return;
+  }
+
+  Pool &pool = pools_[allocation.memoryTypeIndex * kVulkanMemoryResourceKindCount + allocation.kind];
+  Block &block = pool.blocks[allocation.blockIndex];
+
+  block.buddy.Free(allocation.offset, allocation.order);
+  block.allocationCount--;
+  allocatedBytes_ -= block.buddy.NodeSize(allocation.order);
+
+  // keep one empty block per pool around, so alternating allocate/free doesn't thrash vkAllocateMemory
+  if (block.allocationCount == 0) {
+    uint32_t emptyBlockCount = 0;
+    for (const auto &other : pool.blocks) {
+      if (other.memory != VK_NULL_HANDLE && other.allocationCount == 0) {
+        emptyBlockCount++;
+      }
+    }
+
+    if (emptyBlockCount > 1) {
+      freeDeviceMemory(block.memory, block.mappedData);
+      block.memory = VK_NULL_HANDLE;
+      block.mappedData = nullptr;
+    }
+  }
+
+  allocation = {};
+}
+
+VkResult VulkanMemoryAllocator::CreateBuffer(const VkBufferCreateInfo &createInfo, VkMemoryPropertyFlags properties, VkBuffer &buffer, VulkanMemoryAllocation &allocation) {
+
+  VkResult result;
+  if ((result = vkCreateBuffer(device_, &createInfo, allocationCallbacks_, &buffer)) != VK_SUCCESS) {
+    return result;
+  }
+
+  VkMemoryRequirements requirements;
+  vkGetBufferMemoryRequirements(device_, buffer, &requirements);
+
+  if ((result = Allocate(requirements, properties, kLinearMemoryResource, allocation)) != VK_SUCCESS ||
+    (result = vkBindBufferMemory(device_, buffer, allocation.memory, allocation.offset)) != VK_SUCCESS) {
+
+    DestroyBuffer(buffer, allocation);
+    return result;
+  }
+
+  return VK_SUCCESS;
+}
+
+void VulkanMemoryAllocator::DestroyBuffer(VkBuffer &buffer, VulkanMemoryAllocation &allocation) {
+  if (buffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(device_, buffer, allocationCallbacks_);
+    buffer = VK_NULL_HANDLE;
+  }
+  Free(allocation);
+}
+
+VkResult VulkanMemoryAllocator::CreateImage(const VkImageCreateInfo &createInfo, VkMemoryPropertyFlags properties, VkImage &image, VulkanMemoryAllocation &allocation) {
+
+  VkResult result;
+  if ((result = vkCreateImage(device_, &createInfo, allocationCallbacks_, &image)) != VK_SUCCESS) {
+    return result;
+  }
+
+  VkMemoryRequirements requirements;
+  vkGetImageMemoryRequirements(device_, image, &requirements);
+
+  VulkanMemoryResourceKind kind = createInfo.tiling == VK_IMAGE_TILING_OPTIMAL ? kOptimalImageMemoryResource : kLinearMemoryResource;
+
+  if ((result = Allocate(requirements, properties, kind, allocation)) != VK_SUCCESS ||
+    (result = vkBindImageMemory(device_, image, allocation.memory, allocation.offset)) != VK_SUCCESS) {
+
+    DestroyImage(image, allocation);
+    return result;
+  }
+
+  return VK_SUCCESS;
+}
+
+void VulkanMemoryAllocator::DestroyImage(VkImage &image, VulkanMemoryAllocation &allocation) {
+  if (image != VK_NULL_HANDLE) {
+    vkDestroyImage(device_, image, allocationCallbacks_);
+    image = VK_NULL_HANDLE;
+  }
+  Free(allocation);
+}
+
+VulkanMemoryStats VulkanMemoryAllocator::GetStats() const {
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  VulkanMemoryStats stats;
+  stats.dedicatedAllocationCount = dedicatedAllocationCount_;
+  stats.allocationCount = allocationCount_;
+  stats.reservedBytes = dedicatedBytes_;
+  stats.allocatedBytes = allocatedBytes_;
+  stats.requestedBytes = requestedBytes_;
+
+  for (const auto &pool : pools_) {
+    for (const auto &block : pool.blocks) {
+      if (block.memory == VK_NULL_HANDLE) {
+        continue;
+      }
+
+      stats.blockCount++;
+      stats.reservedBytes += blockSize_;
+      stats.freeBytes += block.buddy.FreeBytes();
+      stats.largestFreeRange = std::max(stats.largestFreeRange, block.buddy.LargestFreeNode());
+    }
+  }
+
+  return stats;
+}
+
+VkResult VulkanMemoryAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, VkDeviceMemory &memory, void* &mappedData) {
+
+  if (maxAllocationCount_ != 0 && deviceAllocationCount_ >= maxAllocationCount_) {
+    return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+  }
+
+  VkMemoryAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = size;
+  allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+  VkResult result;
+  if ((result = vkAllocateMemory(device_, &allocInfo, allocationCallbacks_, &memory)) != VK_SUCCESS) {
+    return result;
+  }
+
+  mappedData = nullptr;
+  if (memoryProperties_.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    if ((result = vkMapMemory(device_, memory, 0, VK_WHOLE_SIZE, 0, &mappedData)) != VK_SUCCESS) {
+      vkFreeMemory(device_, memory, allocationCallbacks_);
+      memory = VK_NULL_HANDLE;
+      return result;
+    }
+  }
+
+  deviceAllocationCount_++;
+  return VK_SUCCESS;
+}
+
+void VulkanMemoryAllocator::freeDeviceMemory(VkDeviceMemory memory, void* mappedData) {
+  if (mappedData != nullptr) {
+    vkUnmapMemory(device_, memory);
+  }
+  vkFreeMemory(device_, memory, allocationCallbacks_);
+  deviceAllocationCount_--;
+}
+
+bool VulkanMemoryAllocator::findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties, uint32_t &output) const {
+  for (uint32_t i = 0; i < memoryProperties_.memoryTypeCount; ++i) {
+    if ((typeBits & (1u << i)) && (memoryProperties_.memoryTypes[i].propertyFlags & properties) == properties) {
+      output = i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool RunBuddyAllocatorBenchmark(uint32_t operationCount) {
+
+  const VkDeviceSize blockSize = VulkanMemoryAllocator::kDefaultBlockSize;
+  // the allocator's own load, the block hovers around this much allocated once it has filled up
+  const VkDeviceSize targetBytes = blockSize / 4 * 3;
+
+  struct LiveAllocation {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    uint32_t order;
+  };
+
+  // xorshift, the same sequence on every run
+  uint32_t state = 1;
+  const auto random = [&]() -> uint32_t {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  };
+
+  BuddyAllocator buddy(blockSize, VulkanMemoryAllocator::kMinAllocationSize);
+  std::vector<LiveAllocation> live;
+  VkDeviceSize allocatedBytes = 0;
+  VkDeviceSize requestedBytes = 0;
+  uint32_t allocationCount = 0;
+  uint32_t freeCount = 0;
+  uint32_t failedCount = 0;
+
+  auto start = std::chrono::high_resolution_clock::now();
+  for (uint32_t operation = 0; operation < operationCount; ++operation) {
+
+    const bool allocate = live.empty() || (allocatedBytes < targetBytes && random() % 8 < 5);
+    if (allocate) {
+      // sizes spread evenly over 256 B to 1 MB in log scale like uniform and vertex buffers, every 16th
+      // allocation asks for the 64 KB alignment of an MSAA image
+      LiveAllocation allocation;
+      const uint32_t sizeShift = 8 + random() % 13;
+      allocation.size = (VkDeviceSize(1) << sizeShift) + random() % (VkDeviceSize(1) << sizeShift);
+      const VkDeviceSize alignment = random() % 16 == 0 ? 65536 : 256;
+
+      if (!buddy.Allocate(allocation.size, alignment, allocation.offset, allocation.order)) {
+        failedCount++;
+        continue;
+      }
+
+      live.push_back(allocation);
+      allocatedBytes += buddy.NodeSize(allocation.order);
+      requestedBytes += allocation.size;
+      allocationCount++;
+    }
+    else {
+      const size_t index = random() % live.size();
+      buddy.Free(live[index].offset, live[index].order);
+      allocatedBytes -= buddy.NodeSize(live[index].order);
+      requestedBytes -= live[index].size;
+      live[index] = live.back();
+      live.pop_back();
+      freeCount++;
+    }
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+
+  // fragmentation of the steady state the loop ended in
+  const VkDeviceSize freeBytes = buddy.FreeBytes();
+  const VkDeviceSize largestFreeNode = buddy.LargestFreeNode();
+  const double internalWaste = allocatedBytes > 0 ? 1.0 - static_cast<double>(requestedBytes) / allocatedBytes : 0.0;
+  const double externalFragmentation = freeBytes > 0 ? 1.0 - static_cast<double>(largestFreeNode) / freeBytes : 0.0;
+
+  const double milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+  const uint32_t completedCount = allocationCount + freeCount;
+  std::cout << "Buddy allocator: " << allocationCount << " allocations, " << freeCount << " frees, " << failedCount << " failed, "
+    << milliseconds << " ms, " << (completedCount / 1000.0) / std::max(milliseconds, 1e-6) << " M operations/s" << std::endl;
+  std::cout << "Buddy allocator: " << live.size() << " live allocations, " << requestedBytes / 1024 << " KB requested in "
+    << allocatedBytes / 1024 << " KB of nodes (" << internalWaste * 100.0 << "% internal waste), "
+    << freeBytes / 1024 << " KB free, largest free node " << largestFreeNode / 1024 << " KB ("
+    << externalFragmentation * 100.0 << "% external fragmentation)" << std::endl;
+
+  for (const LiveAllocation &allocation : live) {
+    buddy.Free(allocation.offset, allocation.order);
+  }
+
+  // every buddy has to have merged back into the single root node
+  if (!buddy.IsEmpty() || buddy.LargestFreeNode() != blockSize) {
+    std::cerr << "Buddy allocator didn't merge back into one free block after freeing everything" << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+#include <vulkan\vulkan.hpp>
+
+namespace vks {
+
+// Resources of different kinds never share a memory block, which keeps linear and optimal tiling
+// resources bufferImageGranularity apart without having to pad every allocation.
+enum VulkanMemoryResourceKind {
+  // buffers and linear tiling images
+  kLinearMemoryResource = 0,
+  // optimal tiling images
+  kOptimalImageMemoryResource,
+  kVulkanMemoryResourceKindCount,
+};
+
+// Power of two buddy allocator over the range [0, size), knows nothing about Vulkan.
+// Offsets it hands out are aligned to the rounded up allocation size.
+class BuddyAllocator {
+  public:
+    BuddyAllocator(VkDeviceSize size, VkDeviceSize minNodeSize);
+
+    // returns false if there is no free node big enough
+    bool Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset, uint32_t &order);
+    void Free(VkDeviceSize offset, uint32_t order);
+
+    VkDeviceSize NodeSize(uint32_t order) const { return minNodeSize_ << order; }
+    VkDeviceSize FreeBytes() const { return freeBytes_; }
+    VkDeviceSize LargestFreeNode() const;
+    bool IsEmpty() const { return freeBytes_ == size_; }
+
+  private:
+    void pushFree(uint32_t order, VkDeviceSize offset);
+    void removeFree(uint32_t order, VkDeviceSize offset);
+    bool isFree(uint32_t order, VkDeviceSize offset) const;
+
+    VkDeviceSize size_;
+    VkDeviceSize minNodeSize_;
+    uint32_t minNodeShift_;
+    uint32_t maxOrder_;
+    VkDeviceSize freeBytes_;
+
+    // free node offsets per order, plus each node's position in that list (-1 when not free)
+    // so that merging can unlink a buddy in O(1)
+    std::vector<std::vector<VkDeviceSize>> freeLists_;
+    std::vector<std::vector<int32_t>> freeListPositions_;
+};
+
+struct VulkanMemoryAllocation {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  // persistently mapped pointer to offset, null unless the memory is host visible
+  void* mappedData = nullptr;
+
+  // bookkeeping for Free, blockIndex is kDedicatedVulkanMemoryBlock for dedicated allocations
+  uint32_t memoryTypeIndex = 0;
+  VulkanMemoryResourceKind kind = kLinearMemoryResource;
+  uint32_t blockIndex = 0;
+  uint32_t order = 0;
+};
+
+const uint32_t kDedicatedVulkanMemoryBlock = ~0u;
+
+struct VulkanMemoryStats {
+  uint32_t blockCount = 0;
+  uint32_t dedicatedAllocationCount = 0;
+  uint32_t allocationCount = 0;
+  // bytes of VkDeviceMemory we own, including dedicated allocations
+  VkDeviceSize reservedBytes = 0;
+  // bytes handed out, after rounding to buddy node sizes
+  VkDeviceSize allocatedBytes = 0;
+  // bytes actually requested by resources
+  VkDeviceSize requestedBytes = 0;
+  VkDeviceSize freeBytes = 0;
+  VkDeviceSize largestFreeRange = 0;
+};
+
+// Sub-allocates buffers and images out of large per memory type VkDeviceMemory blocks,
+// so we stay far away from maxMemoryAllocationCount. Host visible blocks stay mapped for their whole lifetime.
+// All methods are thread safe.
+class VulkanMemoryAllocator {
+  public:
+    static const VkDeviceSize kDefaultBlockSize = 64 * 1024 * 1024;
+    static const VkDeviceSize kMinAllocationSize = 256;
+
+    void Init(
+      VkPhysicalDevice physicalDevice,
+      VkDevice device,
+      VkDeviceSize blockSize = kDefaultBlockSize,
+      const VkAllocationCallbacks* allocationCallbacks = nullptr);
+    // frees every block, all resources must have been destroyed before
+    void Destroy();
+
+    VkResult Allocate(
+      const VkMemoryRequirements &requirements,
+      VkMemoryPropertyFlags properties,
+      VulkanMemoryResourceKind kind,
+      VulkanMemoryAllocation &output);
+    void Free(VulkanMemoryAllocation &allocation);
+
+    VkResult CreateBuffer(const VkBufferCreateInfo &createInfo, VkMemoryPropertyFlags properties, VkBuffer &buffer, VulkanMemoryAllocation &allocation);
+    void DestroyBuffer(VkBuffer &buffer, VulkanMemoryAllocation &allocation);
+
+    VkResult CreateImage(const VkImageCreateInfo &createInfo, VkMemoryPropertyFlags properties, VkImage &image, VulkanMemoryAllocation &allocation);
+    void DestroyImage(VkImage &image, VulkanMemoryAllocation &allocation);
+
+    VulkanMemoryStats GetStats() const;
+
+  private:
+    struct Block {
+      VkDeviceMemory memory = VK_NULL_HANDLE;
+      void* mappedData = nullptr;
+      BuddyAllocator buddy;
+      uint32_t allocationCount = 0;
+    };
+
+    struct Pool {
+      std::vector<Block> blocks;
+    };
+
+    VkResult allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, VkDeviceMemory &memory, void* &mappedData);
+    void freeDeviceMemory(VkDeviceMemory memory, void* mappedData);
+    bool findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties, uint32_t &output) const;
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    const VkAllocationCallbacks* allocationCallbacks_ = nullptr;
+    VkPhysicalDeviceMemoryProperties memoryProperties_;
+    uint32_t maxAllocationCount_ = 0;
+    VkDeviceSize blockSize_ = kDefaultBlockSize;
+
+    mutable std::mutex mutex_;
+    // indexed by memoryTypeIndex * kVulkanMemoryResourceKindCount + kind
+    std::vector<Pool> pools_;
+    uint32_t deviceAllocationCount_ = 0;
+    uint32_t dedicatedAllocationCount_ = 0;
+    VkDeviceSize dedicatedBytes_ = 0;
+    uint32_t allocationCount_ = 0;
+    VkDeviceSize allocatedBytes_ = 0;
+    VkDeviceSize requestedBytes_ = 0;
+};
+
+// Allocates and frees random sizes and alignments in a buddy allocator the size of a default block, about 3/4 full
+// once warmed up, and prints the throughput and how fragmented the block ended up. Returns false if the freed
+// block didn't merge back into one node.
+bool RunBuddyAllocatorBenchmark(uint32_t operationCount);
+
+}
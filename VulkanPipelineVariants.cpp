@@ -0,0 +1,275 @@
+#include "VulkanPipelineVariants.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace vks {
+
+bool VulkanPipelineState::operator==(const VulkanPipelineState &other) const {
+  return vertShaderModule == other.vertShaderModule &&
+    fragShaderModule == other.fragShaderModule &&
+    layout == other.layout &&
+    renderPass == other.renderPass &&
+    subpass == other.subpass &&
+    topology == other.topology &&
+    polygonMode == other.polygonMode &&
+    cullMode == other.cullMode &&
+    frontFace == other.frontFace &&
+    blendMode == other.blendMode;
+}
+
+// non dispatchable handles are pointers on 64 bit and uint64_t on 32 bit platforms
+template<typename T>
+uint64_t pipelineHandleBits(T handle) {
+  uint64_t bits = 0;
+  memcpy(&bits, &handle, sizeof(handle));
+  return bits;
+}
+
+size_t VulkanPipelineStateHash::operator()(const VulkanPipelineState &state) const {
+
+  // FNV-1a, field by field so padding doesn't leak in
+  uint64_t hash = 14695981039346656037ull;
+  const auto mix = [&](uint64_t value) {
+    hash = (hash ^ value) * 1099511628211ull;
+  };
+
+  mix(pipelineHandleBits(state.vertShaderModule));
+  mix(pipelineHandleBits(state.fragShaderModule));
+  mix(pipelineHandleBits(state.layout));
+  mix(pipelineHandleBits(state.renderPass));
+  mix(state.subpass);
+  mix(static_cast<uint64_t>(state.topology));
+  mix(static_cast<uint64_t>(state.polygonMode));
+  mix(state.cullMode);
+  mix(static_cast<uint64_t>(state.frontFace));
+  mix(static_cast<uint64_t>(state.blendMode));
+
+  return static_cast<size_t>(hash);
+}
+
+VkResult CreateVulkanGraphicsPipeline(
+  VkDevice device,
+  VkPipelineCache pipelineCache,
+  const VulkanPipelineState &state,
+  VkPipeline &pipeline,
+  const VkAllocationCallbacks* allocationCallbacks) {
+
+  VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+  shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+  shaderStages[0].module = state.vertShaderModule;
+  shaderStages[0].pName = "main";
+
+  shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  shaderStages[1].module = state.fragShaderModule;
+  shaderStages[1].pName = "main";
+
+  VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+  vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+  VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+  inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  inputAssembly.topology = state.topology;
+  inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+  // the actual viewport and scissor are set while recording, so a resize doesn't need new pipelines
+  VkPipelineViewportStateCreateInfo viewportState = {};
+  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewportState.viewportCount = 1;
+  viewportState.scissorCount = 1;
+
+  VkPipelineRasterizationStateCreateInfo rasterizer = {};
+  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterizer.depthClampEnable = VK_FALSE;
+  rasterizer.rasterizerDiscardEnable = VK_FALSE;
+  rasterizer.polygonMode = state.polygonMode;
+  rasterizer.lineWidth = 1.0f;
+  rasterizer.cullMode = state.cullMode;
+  rasterizer.frontFace = state.frontFace;
+  rasterizer.depthBiasEnable = VK_FALSE;
+
+  VkPipelineMultisampleStateCreateInfo multisampling = {};
+  multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisampling.sampleShadingEnable = VK_FALSE;
+  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+  multisampling.minSampleShading = 1.0f;
+
+  VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+  colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+  colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+  switch (state.blendMode) {
+    case kOpaqueBlend:
+      colorBlendAttachment.blendEnable = VK_FALSE;
+      colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+      colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+      colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+      colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+      break;
+    case kAlphaBlend:
+      colorBlendAttachment.blendEnable = VK_TRUE;
+      colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+      colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+      colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+      colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+      break;
+    case kAdditiveBlend:
+      colorBlendAttachment.blendEnable = VK_TRUE;
+      colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+      colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+      colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+      colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+      break;
+  }
+
+  VkPipelineColorBlendStateCreateInfo colorBlending = {};
+  colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  colorBlending.logicOpEnable = VK_FALSE;
+  colorBlending.logicOp = VK_LOGIC_OP_COPY;
+  colorBlending.attachmentCount = 1;
+  colorBlending.pAttachments = &colorBlendAttachment;
+
+  VkDynamicState dynamicStates[] = {
+    VK_DYNAMIC_STATE_VIEWPORT,
+    VK_DYNAMIC_STATE_SCISSOR
+  };
+
+  VkPipelineDynamicStateCreateInfo dynamicState = {};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount = 2;
+  dynamicState.pDynamicStates = dynamicStates;
+
+  VkGraphicsPipelineCreateInfo pipelineInfo = {};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineInfo.stageCount = 2;
+  pipelineInfo.pStages = shaderStages;
+  pipelineInfo.pVertexInputState = &vertexInputInfo;
+  pipelineInfo.pInputAssemblyState = &inputAssembly;
+  pipelineInfo.pViewportState = &viewportState;
+  pipelineInfo.pRasterizationState = &rasterizer;
+  pipelineInfo.pMultisampleState = &multisampling;
+  pipelineInfo.pDepthStencilState = nullptr;
+  pipelineInfo.pColorBlendState = &colorBlending;
+  pipelineInfo.pDynamicState = &dynamicState;
+  pipelineInfo.layout = state.layout;
+  pipelineInfo.renderPass = state.renderPass;
+  pipelineInfo.subpass = state.subpass;
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+  pipelineInfo.basePipelineIndex = -1;
+
+  return vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, allocationCallbacks, &pipeline);
+}
+
+void VulkanPipelineVariantCache::Init(
+  VkDevice device,
+  VkPipelineCache pipelineCache,
+  uint32_t compileThreadCount,
+  const VkAllocationCallbacks* allocationCallbacks) {
+
+  device_ = device;
+  allocationCallbacks_ = allocationCallbacks;
+  pipelineCache_ = pipelineCache;
+  stopping_ = false;
+
+  for (uint32_t i = 0; i < std::max(compileThreadCount, 1u); ++i) {
+    threads_.emplace_back(&VulkanPipelineVariantCache::compileLoop, this);
+  }
+}
+
+void VulkanPipelineVariantCache::Destroy() {
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    queue_.clear();
+  }
+  queueCondition_.notify_all();
+
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+
+  for (const auto &entry : variants_) {
+    if (entry.second.pipeline != VK_NULL_HANDLE) {
+      vkDestroyPipeline(device_, entry.second.pipeline, allocationCallbacks_);
+    }
+  }
+  variants_.clear();
+}
+
+VulkanPipelineVariantCache::Variant &VulkanPipelineVariantCache::findOrQueue(const VulkanPipelineState &state) {
+
+  auto inserted = variants_.emplace(state, Variant());
+  if (inserted.second && !stopping_) {
+    queue_.push_back(state);
+    queueCondition_.notify_one();
+  }
+
+  return inserted.first->second;
+}
+
+VkPipeline VulkanPipelineVariantCache::Get(const VulkanPipelineState &state, VkPipeline fallback) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const Variant &variant = findOrQueue(state);
+  return variant.status == kReadyVariant ? variant.pipeline : fallback;
+}
+
+void VulkanPipelineVariantCache::Prefetch(const VulkanPipelineState &state) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  findOrQueue(state);
+}
+
+void VulkanPipelineVariantCache::WaitIdle() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idleCondition_.wait(lock, [this]() { return queue_.empty() && compilingCount_ == 0; });
+}
+
+uint32_t VulkanPipelineVariantCache::GetReadyCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<uint32_t>(std::count_if(variants_.begin(), variants_.end(), [](const std::pair<const VulkanPipelineState, Variant> &entry) {
+    return entry.second.status == kReadyVariant;
+  }));
+}
+
+uint32_t VulkanPipelineVariantCache::GetFailedCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<uint32_t>(std::count_if(variants_.begin(), variants_.end(), [](const std::pair<const VulkanPipelineState, Variant> &entry) {
+    return entry.second.status == kFailedVariant;
+  }));
+}
+
+void VulkanPipelineVariantCache::compileLoop() {
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    queueCondition_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+    if (stopping_) {
+      return;
+    }
+
+    VulkanPipelineState state = queue_.front();
+    queue_.pop_front();
+    compilingCount_++;
+
+    // the driver can take milliseconds here, nobody waits on the lock meanwhile
+    lock.unlock();
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult result = CreateVulkanGraphicsPipeline(device_, pipelineCache_, state, pipeline, allocationCallbacks_);
+    lock.lock();
+
+    Variant &variant = variants_[state];
+    variant.status = result == VK_SUCCESS ? kReadyVariant : kFailedVariant;
+    variant.pipeline = result == VK_SUCCESS ? pipeline : VK_NULL_HANDLE;
+
+    compilingCount_--;
+    if (queue_.empty() && compilingCount_ == 0) {
+      idleCondition_.notify_all();
+    }
+  }
+}
+
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan\vulkan.hpp>
+
+namespace vks {
+
+enum VulkanBlendMode {
+  kOpaqueBlend = 0,
+  // src alpha over, premultiplied alpha isn't used anywhere yet
+  kAlphaBlend,
+  kAdditiveBlend,
+};
+
+// Everything that tells two graphics pipelines apart. Viewport and scissor are always dynamic, and there are
+// no vertex buffers, so neither is part of it. Value type, compared and hashed field by field.
+struct VulkanPipelineState {
+  VkShaderModule vertShaderModule = VK_NULL_HANDLE;
+  VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+  VkPipelineLayout layout = VK_NULL_HANDLE;
+  VkRenderPass renderPass = VK_NULL_HANDLE;
+  uint32_t subpass = 0;
+  VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+  VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+  VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+  VulkanBlendMode blendMode = kOpaqueBlend;
+
+  bool operator==(const VulkanPipelineState &other) const;
+};
+
+struct VulkanPipelineStateHash {
+  size_t operator()(const VulkanPipelineState &state) const;
+};
+
+// blocking, for pipelines that have to exist before the first frame
+VkResult CreateVulkanGraphicsPipeline(
+  VkDevice device,
+  VkPipelineCache pipelineCache,
+  const VulkanPipelineState &state,
+  VkPipeline &pipeline,
+  const VkAllocationCallbacks* allocationCallbacks = nullptr);
+
+// Pipeline variants by state. A variant that isn't compiled yet is queued for the compile threads and the
+// caller gets its fallback pipeline instead, so asking for one never waits on the driver. The compile threads
+// share pipelineCache, which Vulkan synchronizes internally.
+//
+// Get and Prefetch only hold a lock for the lookup and may be called from any thread.
+class VulkanPipelineVariantCache {
+  public:
+    // compileThreadCount 0 means one
+    void Init(
+      VkDevice device,
+      VkPipelineCache pipelineCache,
+      uint32_t compileThreadCount,
+      const VkAllocationCallbacks* allocationCallbacks = nullptr);
+    // waits for the compile in progress, drops the queued ones, then destroys every variant. The device has to be idle.
+    void Destroy();
+
+    // the variant's pipeline if it's ready, fallback otherwise, or when it failed to compile
+    VkPipeline Get(const VulkanPipelineState &state, VkPipeline fallback);
+    // queues state unless it's known already
+    void Prefetch(const VulkanPipelineState &state);
+    // blocks until the queue is empty and nothing is compiling, for loading screens
+    void WaitIdle();
+
+    uint32_t GetReadyCount() const;
+    uint32_t GetFailedCount() const;
+
+  private:
+    enum VariantStatus {
+      kQueuedVariant,
+      kReadyVariant,
+      kFailedVariant,
+    };
+
+    struct Variant {
+      VariantStatus status = kQueuedVariant;
+      VkPipeline pipeline = VK_NULL_HANDLE;
+    };
+
+    // returns the variant, queueing it first if it's new, mutex_ has to be held
+    Variant &findOrQueue(const VulkanPipelineState &state);
+    void compileLoop();
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    const VkAllocationCallbacks* allocationCallbacks_ = nullptr;
+    VkPipelineCache pipelineCache_ = VK_NULL_HANDLE;
+
+    mutable std::mutex mutex_;
+    std::condition_variable queueCondition_;
+    std::condition_variable idleCondition_;
+    std::unordered_map<VulkanPipelineState, Variant, VulkanPipelineStateHash> variants_;
+    std::deque<VulkanPipelineState> queue_;
+    uint32_t compilingCount_ = 0;
+    bool stopping_ = false;
+
+    std::vector<std::thread> threads_;
+};
+
+}
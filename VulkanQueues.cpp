@@ -0,0 +1,146 @@
+#include "VulkanQueues.h"
+
+#include <algorithm>
+
+namespace vks {
+
+bool VulkanQueueTopology::IsComplete() const {
+  return roles[kGraphicsQueueRole].familyIndex != kNoVulkanQueueFamily &&
+    roles[kPresentQueueRole].familyIndex != kNoVulkanQueueFamily;
+}
+
+std::vector<uint32_t> VulkanQueueTopology::GetQueueCounts() const {
+
+  std::vector<uint32_t> queueCounts(families.size(), 0);
+  for (const auto &slot : roles) {
+    if (slot.familyIndex != kNoVulkanQueueFamily) {
+      queueCounts[slot.familyIndex] = std::max(queueCounts[slot.familyIndex], slot.queueIndex + 1);
+    }
+  }
+
+  return queueCounts;
+}
+
+std::vector<uint32_t> VulkanQueueTopology::GetFamilies(std::initializer_list<VulkanQueueRole> roleList) const {
+
+  std::vector<uint32_t> familyIndices;
+  for (VulkanQueueRole role : roleList) {
+    uint32_t familyIndex = roles[role].familyIndex;
+    if (familyIndex != kNoVulkanQueueFamily && std::find(familyIndices.begin(), familyIndices.end(), familyIndex) == familyIndices.end()) {
+      familyIndices.push_back(familyIndex);
+    }
+  }
+
+  return familyIndices;
+}
+
+VulkanQueueTopology DiscoverVulkanQueueTopology(
+  VkPhysicalDevice physicalDevice,
+  const std::vector<VkQueueFamilyProperties> &families,
+  VkSurfaceKHR surface) {
+
+  VulkanQueueTopology topology;
+  topology.families = families;
+
+  const uint32_t familyCount = static_cast<uint32_t>(topology.families.size());
+  topology.familyCanPresent.resize(familyCount, VK_FALSE);
+  for (uint32_t i = 0; i < familyCount; ++i) {
+    // without a surface (headless) there is nothing to present to, any family will do
+    topology.familyCanPresent[i] = surface == VK_NULL_HANDLE;
+    if (surface != VK_NULL_HANDLE) {
+      vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &topology.familyCanPresent[i]);
+    }
+  }
+
+  const auto hasFlags = [&](uint32_t family, VkQueueFlags required, VkQueueFlags excluded) -> bool {
+    const VkQueueFamilyProperties &properties = topology.families[family];
+    return properties.queueCount > 0 &&
+      (properties.queueFlags & required) == required &&
+      (properties.queueFlags & excluded) == 0;
+  };
+
+  const auto findFamily = [&](VkQueueFlags required, VkQueueFlags excluded) -> uint32_t {
+    for (uint32_t i = 0; i < familyCount; ++i) {
+      if (hasFlags(i, required, excluded)) {
+        return i;
+      }
+    }
+    return kNoVulkanQueueFamily;
+  };
+
+  VulkanQueueSlot &graphics = topology.roles[kGraphicsQueueRole];
+  VulkanQueueSlot &present = topology.roles[kPresentQueueRole];
+  VulkanQueueSlot &compute = topology.roles[kComputeQueueRole];
+  VulkanQueueSlot &transfer = topology.roles[kTransferQueueRole];
+
+  // presenting from the graphics queue saves a semaphore hop and a concurrent swap chain
+  for (uint32_t i = 0; i < familyCount && graphics.familyIndex == kNoVulkanQueueFamily; ++i) {
+    if (hasFlags(i, VK_QUEUE_GRAPHICS_BIT, 0) && topology.familyCanPresent[i]) {
+      graphics.familyIndex = i;
+    }
+  }
+
+  if (graphics.familyIndex == kNoVulkanQueueFamily) {
+    graphics.familyIndex = findFamily(VK_QUEUE_GRAPHICS_BIT, 0);
+    for (uint32_t i = 0; i < familyCount && present.familyIndex == kNoVulkanQueueFamily; ++i) {
+      if (topology.families[i].queueCount > 0 && topology.familyCanPresent[i]) {
+        present.familyIndex = i;
+      }
+    }
+  }
+  else {
+    present = graphics;
+  }
+
+  if (graphics.familyIndex == kNoVulkanQueueFamily) {
+    return topology;
+  }
+
+  const uint32_t graphicsQueueCount = topology.families[graphics.familyIndex].queueCount;
+
+  compute.familyIndex = findFamily(VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT);
+  if (compute.familyIndex == kNoVulkanQueueFamily) {
+    compute = graphics;
+    if (graphicsQueueCount > 1) {
+      compute.queueIndex = 1;
+    }
+  }
+
+  transfer.familyIndex = findFamily(VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+  if (transfer.familyIndex == kNoVulkanQueueFamily) {
+    if (compute.familyIndex != graphics.familyIndex && topology.families[compute.familyIndex].queueCount > 1) {
+      transfer.familyIndex = compute.familyIndex;
+      transfer.queueIndex = 1;
+    }
+    else {
+      transfer = graphics;
+    }
+  }
+
+  return topology;
+}
+
+void PrintVulkanQueueTopology(const VulkanQueueTopology &topology, std::ostream &stream) {
+
+  stream << "Vulkan queue families:" << std::endl;
+  for (uint32_t i = 0; i < topology.families.size(); ++i) {
+    const VkQueueFamilyProperties &family = topology.families[i];
+    stream << "  " << i << ": " << family.queueCount << " queues,"
+      << ((family.queueFlags & VK_QUEUE_GRAPHICS_BIT) ? " graphics" : "")
+      << ((family.queueFlags & VK_QUEUE_COMPUTE_BIT) ? " compute" : "")
+      << ((family.queueFlags & VK_QUEUE_TRANSFER_BIT) ? " transfer" : "")
+      << ((family.queueFlags & VK_QUEUE_SPARSE_BINDING_BIT) ? " sparse" : "")
+      << (topology.familyCanPresent[i] ? " present" : "")
+      << std::endl;
+  }
+
+  const char* roleNames[kVulkanQueueRoleCount] = { "graphics", "present", "compute", "transfer" };
+  stream << "Vulkan queues:";
+  for (uint32_t role = 0; role < kVulkanQueueRoleCount; ++role) {
+    const VulkanQueueSlot &slot = topology.roles[role];
+    stream << " " << roleNames[role] << " " << slot.familyIndex << "." << slot.queueIndex;
+  }
+  stream << std::endl;
+}
+
+}
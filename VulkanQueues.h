@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <ostream>
+#include <vector>
+
+#include <vulkan\vulkan.hpp>
+
+namespace vks {
+
+const uint32_t kNoVulkanQueueFamily = ~0u;
+
+enum VulkanQueueRole {
+  kGraphicsQueueRole = 0,
+  kPresentQueueRole,
+  kComputeQueueRole,
+  kTransferQueueRole,
+  kVulkanQueueRoleCount,
+};
+
+// one queue of the device, by family and index within the family
+struct VulkanQueueSlot {
+  uint32_t familyIndex = kNoVulkanQueueFamily;
+  uint32_t queueIndex = 0;
+
+  bool operator==(const VulkanQueueSlot &other) const { return familyIndex == other.familyIndex && queueIndex == other.queueIndex; }
+  bool operator!=(const VulkanQueueSlot &other) const { return !(*this == other); }
+};
+
+// The queue families of a physical device and the queue picked for each role. Roles share a queue when
+// the device has nothing better, so work on a role's queue can only overlap graphics when its slot differs.
+//
+// compute prefers a family without graphics (async compute engines), then a second queue of the graphics family.
+// transfer prefers a transfer only family (DMA engines), then a second queue of the dedicated compute family,
+// but never a second graphics queue: the uploader only synchronizes with semaphores across queue families.
+struct VulkanQueueTopology {
+  std::vector<VkQueueFamilyProperties> families;
+  std::vector<VkBool32> familyCanPresent;
+  VulkanQueueSlot roles[kVulkanQueueRoleCount];
+
+  // graphics and, with a surface, present were found
+  bool IsComplete() const;
+  const VulkanQueueSlot &Get(VulkanQueueRole role) const { return roles[role]; }
+  bool HasOwnQueue(VulkanQueueRole role) const { return role == kGraphicsQueueRole || roles[role] != roles[kGraphicsQueueRole]; }
+
+  // queues to create per family, indexed by family, 0 for unused families
+  std::vector<uint32_t> GetQueueCounts() const;
+  // the distinct families of the given roles, e.g. for VK_SHARING_MODE_CONCURRENT resources
+  std::vector<uint32_t> GetFamilies(std::initializer_list<VulkanQueueRole> roles) const;
+};
+
+// families as probed into the device's VulkanDeviceCapabilities, only present support is queried here since it
+// depends on the surface. surface may be null for headless rendering, present then shares the graphics queue
+VulkanQueueTopology DiscoverVulkanQueueTopology(
+  VkPhysicalDevice physicalDevice,
+  const std::vector<VkQueueFamilyProperties> &families,
+  VkSurfaceKHR surface);
+void PrintVulkanQueueTopology(const VulkanQueueTopology &topology, std::ostream &stream);
+
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <vulkan\vulkan.hpp>
+
+#include "VulkanMemoryAllocator.h"
+
+namespace vks {
+
+typedef uint32_t VulkanGraphResource;
+typedef uint32_t VulkanGraphPass;
+
+// How a pass uses a resource, each one maps to the stage, access mask and image layout barriers are derived from.
+enum VulkanGraphAccess {
+  kColorAttachmentWriteAccess,
+  kDepthAttachmentWriteAccess,
+  kDepthAttachmentReadAccess,
+  kFragmentSampledReadAccess,
+  kComputeSampledReadAccess,
+  kComputeStorageReadAccess,
+  kComputeStorageWriteAccess,
+  kVertexStorageReadAccess,
+  kIndirectCommandReadAccess,
+  kTransferReadAccess,
+  kTransferWriteAccess,
+  kVulkanGraphAccessCount,
+};
+
+// transient images live only within a frame, the graph creates them and aliases their memory
+struct VulkanGraphImageDesc {
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  VkExtent2D extent = { 0, 0 };
+  VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+};
+
+// how an imported image has to be left for whoever uses it after the graph, e.g. the presentation engine
+struct VulkanGraphImageHandoff {
+  VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  VkPipelineStageFlags stageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+  VkAccessFlags accessMask = 0;
+};
+
+typedef std::function<void(VkCommandBuffer)> VulkanGraphPassRecorder;
+
+// A frame graph over a single queue. Passes run in the order they were added and declare what they read and write,
+// Compile then
+//  - culls passes none of whose writes reach an imported resource, unless they were marked as having side effects,
+//  - derives the pipeline barriers and image layout transitions between the passes that are left,
+//  - creates the transient images and aliases the memory of those whose lifetimes don't overlap.
+//
+// The graph is compiled once and executed every frame, imported resources can be rebound in between, e.g. to the
+// acquired swap chain image. Passes that begin a render pass must use render passes whose attachments start and end
+// in the layout of the declared access, the graph does the transitions around them.
+//
+// Transient images are shared between frames in flight, the first barrier on their memory waits for the last
+// use of it, which on a single queue also orders against the previous frame.
+// Not thread safe, meant to be driven by the render thread.
+class VulkanRenderGraph {
+  public:
+    // imported images start out in initialLayout, stageMask is where the previous use (or a semaphore wait) ends
+    VulkanGraphResource ImportImage(
+      const char* name,
+      VkImageAspectFlags aspect,
+      VkImageLayout initialLayout,
+      VkPipelineStageFlags initialStageMask,
+      const VulkanGraphImageHandoff &handoff);
+    // imported buffers are assumed to be ordered against earlier use by the frame fences
+    VulkanGraphResource ImportBuffer(const char* name);
+    VulkanGraphResource CreateImage(const char* name, const VulkanGraphImageDesc &desc);
+
+    VulkanGraphPass AddPass(const char* name, VulkanGraphPassRecorder recorder);
+    void Read(VulkanGraphPass pass, VulkanGraphResource resource, VulkanGraphAccess access);
+    void Write(VulkanGraphPass pass, VulkanGraphResource resource, VulkanGraphAccess access);
+    // keeps the pass even if nothing reads what it writes, e.g. for readbacks and timestamps
+    void SetSideEffects(VulkanGraphPass pass);
+
+    VkResult Compile(VkDevice device, VulkanMemoryAllocator &allocator, const VkAllocationCallbacks* allocationCallbacks = nullptr);
+    // the device has to be idle, forgets every pass and resource
+    void Destroy();
+
+    void SetImportedImage(VulkanGraphResource resource, VkImage image);
+    void SetImportedBuffer(VulkanGraphResource resource, VkBuffer buffer);
+    // outside of a render pass
+    void Execute(VkCommandBuffer commandBuffer);
+
+    // only valid for transient images, after Compile
+    VkImage GetImage(VulkanGraphResource resource) const { return resources_[resource].image; }
+    VkImageView GetImageView(VulkanGraphResource resource) const { return resources_[resource].imageView; }
+
+    bool IsPassCulled(VulkanGraphPass pass) const { return passes_[pass].culled; }
+    uint32_t GetBarrierCount() const;
+    // barriers recorded right before pass, after Compile
+    uint32_t GetBarrierCountBefore(VulkanGraphPass pass) const;
+    // memory the transient images would need each on their own, and what they take with aliasing
+    VkDeviceSize GetTransientBytes() const;
+    VkDeviceSize GetAliasedTransientBytes() const;
+
+    void Print(std::ostream &out) const;
+
+  private:
+    enum ResourceKind {
+      kImportedImage,
+      kImportedBuffer,
+      kTransientImage,
+    };
+
+    struct Use {
+      VulkanGraphResource resource;
+      VulkanGraphAccess access;
+    };
+
+    struct Resource {
+      std::string name;
+      ResourceKind kind = kImportedBuffer;
+      VulkanGraphImageDesc desc;
+      VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      VkPipelineStageFlags initialStageMask = 0;
+      VulkanGraphImageHandoff handoff;
+      VkImageUsageFlags usage = 0;
+
+      VkImage image = VK_NULL_HANDLE;
+      VkBuffer buffer = VK_NULL_HANDLE;
+      VkImageView imageView = VK_NULL_HANDLE;
+      VkMemoryRequirements requirements = {};
+      // index into aliases_, UINT32_MAX unless transient and used
+      uint32_t alias = UINT32_MAX;
+
+      // executed passes, in order, that touch the resource
+      uint32_t firstPass = UINT32_MAX;
+      uint32_t lastPass = 0;
+      uint32_t readerCount = 0;
+    };
+
+    struct Pass {
+      std::string name;
+      VulkanGraphPassRecorder recorder;
+      std::vector<Use> reads;
+      std::vector<Use> writes;
+      bool sideEffects = false;
+      bool culled = false;
+      // barriers recorded before the pass, the handles get patched in by Execute
+      uint32_t barrierBatch = UINT32_MAX;
+    };
+
+    struct BarrierBatch {
+      VkPipelineStageFlags srcStageMask = 0;
+      VkPipelineStageFlags dstStageMask = 0;
+      std::vector<VkImageMemoryBarrier> imageBarriers;
+      std::vector<VulkanGraphResource> imageResources;
+      std::vector<VkBufferMemoryBarrier> bufferBarriers;
+      std::vector<VulkanGraphResource> bufferResources;
+    };
+
+    // transient images sharing one allocation
+    struct Alias {
+      VkMemoryRequirements requirements = {};
+      VulkanMemoryAllocation memory;
+      std::vector<VulkanGraphResource> images;
+    };
+
+    void cullPasses();
+    void computeLifetimes();
+    void buildBarriers();
+    void assignAliases();
+    VkResult createTransientImage(Resource &resource);
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    const VkAllocationCallbacks* allocationCallbacks_ = nullptr;
+    VulkanMemoryAllocator* allocator_ = nullptr;
+
+    std::vector<Resource> resources_;
+    std::vector<Pass> passes_;
+    std::vector<VulkanGraphPass> executedPasses_;
+    std::vector<BarrierBatch> batches_;
+    // recorded after the last pass, hands imported images off in their final layout
+    uint32_t finalBatch_ = UINT32_MAX;
+    std::vector<Alias> aliases_;
+};
+
+// Compiles small graphs over imported resources, which needs no device, and checks where the barriers end up.
+// Prints each case and returns false if any of them failed.
+bool RunRenderGraphBarrierCheck();
+
+}
@@ -1,5 +1,10 @@
 #include "VulkanSquirrel.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <functional>
@@ -8,22 +13,142 @@
 #include <string>
 #include <vector>
 
+#include "AssetPack.h"
+#include "AsyncLogger.h"
+#include "FrameLimiter.h"
+#include "FrameProfiler.h"
+#include "Frustum.h"
+#include "FrustumCulling.h"
+#include "Scene.h"
 #include "TaskSequence.h"
+#include "VulkanCapabilities.h"
+#include "VulkanDescriptorAllocator.h"
+#include "VulkanHostAllocator.h"
+#include "VulkanMemoryAllocator.h"
+#include "VulkanIndirectScene.h"
+#include "VulkanPipelineVariants.h"
+#include "VulkanQueues.h"
+#include "VulkanRenderGraph.h"
+#include "VulkanUniformAllocator.h"
+#include "VulkanUploader.h"
 #include "VulkanUtils.h"
+#include "WorkerPool.h"
 
 namespace vks {
 
+// everything one frame needs while it is being recorded or executed by the GPU
+struct VulkanFrameData {
+  VkSemaphore imageAvailableSemaphore = VK_NULL_HANDLE;
+  VkFence inFlightFence = VK_NULL_HANDLE;
+
+  // reset as a whole with vkResetCommandPool once inFlightFence signaled
+  VkCommandPool commandPool = VK_NULL_HANDLE;
+  VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+
+  // one pool and secondary command buffer per recording chunk, a chunk is only recorded by one thread at a time
+  std::vector<VkCommandPool> recordingCommandPools;
+  std::vector<VkCommandBuffer> recordingCommandBuffers;
+
+  // secondary command buffer from commandPool for the indirect scene, only allocated when it is enabled
+  VkCommandBuffer sceneCommandBuffer = VK_NULL_HANDLE;
+
+  // the indirect scene's culling with async compute, submitted to the compute queue right before the frame's
+  // graphics submit, which waits on cullFinishedSemaphore. Reset with the other pools once inFlightFence signaled,
+  // the graphics submit waiting on it means the compute work finished too.
+  VkCommandPool computeCommandPool = VK_NULL_HANDLE;
+  VkCommandBuffer computeCommandBuffer = VK_NULL_HANDLE;
+  VkSemaphore cullFinishedSemaphore = VK_NULL_HANDLE;
+  bool computeRecorded = false;
+
+  // what the frame's submit waits on, kept around so they don't reallocate every frame
+  std::vector<VkSemaphore> waitSemaphores;
+  std::vector<VkPipelineStageFlags> waitStages;
+};
+
+// stand-in until there are real materials, a draw's materialId picks its tint
+const float kMaterialTints[][4] = {
+  { 1.0f, 1.0f, 1.0f, 1.0f },
+  { 1.0f, 0.5f, 0.5f, 1.0f },
+  { 0.5f, 1.0f, 0.5f, 1.0f },
+  { 0.5f, 0.5f, 1.0f, 1.0f },
+};
+const uint32_t kMaterialTintCount = sizeof(kMaterialTints) / sizeof(kMaterialTints[0]);
+const VulkanBlendMode kMaterialBlendModes[kMaterialTintCount] = {
+  kOpaqueBlend,
+  kOpaqueBlend,
+  kOpaqueBlend,
+  kAdditiveBlend,
+};
+
+// matches the push_constant block in test.vert
+struct VulkanDrawPushConstants {
+  DrawTransform transform;
+  float tint[4];
+};
+
+// set = 0, binding = 0 of the default pipeline, written once per frame
+struct VulkanFrameUniforms {
+  // xy offset, zw scale applied on top of every draw's transform
+  float view[4];
+};
+
+// a swap chain replaced by a resize, destroyed once no frame in flight can still reference it
+struct VulkanRetiredSwapChain {
+  VkSwapchainKHR swapChain;
+  std::vector<VkImageView> imageViews;
+  std::vector<VkFramebuffer> framebuffers;
+  std::vector<VkSemaphore> renderFinishedSemaphores;
+  uint64_t retiredFrameNumber;
+};
+
+// this frame's state the render graph's passes read while recording
+struct VulkanGraphFrame {
+  VulkanFrameData* frame = nullptr;
+  uint32_t imageIndex = 0;
+  uint32_t chunkCount = 0;
+  bool drawIndirectScene = false;
+};
+
+// below this many draws per chunk the cost of handing work to another thread isn't worth it
+const uint32_t kMinDrawsPerRecordingChunk = 64;
+
+// scene entities wrap around [-kSceneWorldExtent, kSceneWorldExtent], twice the identity view
+const float kSceneWorldExtent = 2.0f;
+
+struct VulkanFrameTimeStats {
+  uint64_t frameCount = 0;
+  double totalMilliseconds = 0.0;
+  double minMilliseconds = std::numeric_limits<double>::max();
+  double maxMilliseconds = 0.0;
+};
+
 struct VulkanSquirrelData {
   VulkanSquirrelOptions options;
 
+  // started by Run before any task and stopped last, everything the engine reports goes through it
+  AsyncLogger logger;
+
+  // set up by Run before any task, every Vulkan object is created and destroyed with allocationCallbacks,
+  // which point into hostAllocator when options.hostAllocationTracking is set
+  VulkanHostAllocator hostAllocator;
+  const VkAllocationCallbacks* allocationCallbacks = nullptr;
+
   // created by taskInitGLFWWindow
   GLFWwindow* window = nullptr;
 
+  // probed by taskProbeVulkanInstanceCapabilities or read from options.capabilityCachePath, the devices are filled in
+  // by taskPickVulkanPhysicalDevice, which writes the snapshot back when anything had to be probed
+  VulkanCapabilities capabilities;
+  bool capabilitiesFromFile = false;
+  bool capabilitiesChanged = false;
+
   // created by taskCheckVulkanExtensions
   std::vector<VkExtensionProperties> extensions;
 
   // created by taskInitVulkanInstance
   VkInstance instance = VK_NULL_HANDLE;
+  // requested and available, the device enables the same layers
+  bool validationLayersEnabled = false;
 
   // created by taskInitVulkanDebug
   VkDebugReportCallbackEXT callbackDebugInstance = VK_NULL_HANDLE;
@@ -38,52 +163,170 @@ struct VulkanSquirrelData {
 
   // created by taskPickVulkanPhysicalDevice
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+  VkPhysicalDeviceProperties physicalDeviceProperties;
+  VulkanQueueTopology queueTopology;
 
-  // created by taskCreateVulkanLogicalDevice
+  // created by taskCreateVulkanLogicalDevice, roles without a queue of their own share the main (graphics) queue
   VkDevice device = VK_NULL_HANDLE;
   uint32_t mainQueueFamilyIndex;
   VkQueue mainQueue = VK_NULL_HANDLE;
+  uint32_t presentQueueFamilyIndex;
+  VkQueue presentQueue = VK_NULL_HANDLE;
+  uint32_t computeQueueFamilyIndex;
+  VkQueue computeQueue = VK_NULL_HANDLE;
+  uint32_t transferQueueFamilyIndex;
+  VkQueue transferQueue = VK_NULL_HANDLE;
+  // the indirect scene's culling runs on computeQueue and overlaps the previous frame's graphics work
+  bool asyncCompute = false;
+
+  // initialized by taskCreateVulkanMemoryAllocator
+  VulkanMemoryAllocator memoryAllocator;
+
+  // created by taskCreateVulkanUploader, fed by whoever streams assets in and flushed once per frame
+  VulkanUploader uploader;
+
+  // initialized by taskCreateVulkanDescriptorAllocator, every descriptor set layout and set comes from here
+  VulkanDescriptorLayoutCache descriptorLayoutCache;
+  VulkanDescriptorAllocator descriptorAllocator;
+
+  // created by taskCreateVulkanFrameUniforms, one descriptor set over the whole uniform ring,
+  // every bind picks its data with a dynamic offset
+  VulkanUniformAllocator uniformAllocator;
+  VkDescriptorSetLayout frameDescriptorSetLayout = VK_NULL_HANDLE;
+  VkDescriptorSet frameDescriptorSet = VK_NULL_HANDLE;
+
+  // created by taskCreateVulkanPipelineCache
+  VkPipelineCache pipelineCache = VK_NULL_HANDLE;
 
   // created by taskCheckVulkanSurfaceCapabilities
   VkSurfaceFormatKHR surfaceFormat;
   VkPresentModeKHR presentMode;
   VkExtent2D extent;
 
-  // created by taskCreateVulkanSwapChain
+  // created by taskCreateVulkanSwapChain, or by taskCreateVulkanOffscreenImages in headless mode
   VkSwapchainKHR swapChain = VK_NULL_HANDLE;
   std::vector<VkImage> swapChainImages;
   VkExtent2D swapChainExtent;
 
+  // created by taskCreateVulkanOffscreenImages, owned by us unlike swap chain images
+  std::vector<VkImage> offscreenImages;
+  std::vector<VulkanMemoryAllocation> offscreenImageMemory;
+
   // created by taskCreateVulkanSwapChainImageViews
   std::vector<VkImageView> swapChainImageViews;
+  // Per swap chain image rather than per frame slot, presenting an image waits on its semaphore and only acquiring
+  // that image again proves the wait is over, a frame slot's fence doesn't. Empty in headless mode.
+  std::vector<VkSemaphore> renderFinishedSemaphores;
+
+  // set by the GLFW resize callback and by out of date / suboptimal results, handled by recreateVulkanSwapChain
+  bool swapChainNeedsRecreation = false;
+  std::vector<VulkanRetiredSwapChain> retiredSwapChains;
 
   // create by taskCreateVulkanDefaultRenderPass
   VkRenderPass defaultRenderPass;
 
+  // opened by taskOpenAssetPack, views into it stay valid until it is closed at shutdown
+  AssetPack assetPack;
+
+  // created by taskReadVulkanDefaultShaders
+  AssetView vertShaderCode;
+  AssetView fragShaderCode;
+  // only used when the shaders are not in the asset pack
+  std::vector<uint32_t> looseVertShaderCode;
+  std::vector<uint32_t> looseFragShaderCode;
+
   // created by taskCreateVulkanDefaultPipeline
   VkShaderModule vertShaderModule = VK_NULL_HANDLE;
   VkShaderModule fragShaderModule = VK_NULL_HANDLE;
   VkPipelineLayout defaultPipelineLayout = VK_NULL_HANDLE;
   VkPipeline defaultGraphicsPipeline = VK_NULL_HANDLE;
+  // compiles the material variants of the default pipeline in the background, defaultGraphicsPipeline stands in meanwhile
+  VulkanPipelineVariantCache pipelineVariants;
+  // resolved by the render thread once per frame, before recording starts
+  VkPipeline materialPipelines[kMaterialTintCount] = {};
+
+  // created by taskCreateVulkanIndirectScene when options.stressSceneObjectCount is set
+  VulkanIndirectScene indirectScene;
+  VulkanUploadTicket indirectSceneTicket = 0;
+  // set once a compute submit made the uploaded objects visible to the compute queue
+  bool indirectSceneVisibleToCompute = false;
+  std::vector<uint32_t> looseCullShaderCode;
+  std::vector<uint32_t> looseSceneVertShaderCode;
+  VkShaderModule sceneVertShaderModule = VK_NULL_HANDLE;
+  VkPipelineLayout scenePipelineLayout = VK_NULL_HANDLE;
+  VkPipeline scenePipeline = VK_NULL_HANDLE;
 
   // created by taskCreateVulkanDefaultFramebuffers
   std::vector<VkFramebuffer> swapChainFramebuffers;
 
-  // created by taskCreateVulkanCommandPool
-  VkCommandPool commandPool;
+  // created by taskCreateVulkanRenderGraph, the imported resources get rebound to this frame's ones before it executes
+  VulkanRenderGraph renderGraph;
+  VulkanGraphResource backbufferResource = 0;
+  VulkanGraphResource sceneDrawResource = 0;
+  VulkanGraphResource sceneVisibleResource = 0;
+  // what the render graph's passes record, set by recordVulkanCommandBuffer right before executing it
+  VulkanGraphFrame graphFrame;
+
+  // started by VulkanSquirrel::Run, splits command recording across threads
+  WorkerPool recordingWorkers;
+
+  // recorded every frame into secondary command buffers
+  DrawList drawList;
+  // rebuilt from drawList every frame, only the visible draws get recorded
+  CullingBounds drawListBounds;
+  std::vector<uint32_t> visibleDraws;
+  CullingPath cullingPath = kScalarCulling;
+  // set when drawList only holds visible draws already, e.g. when it was built from the scene
+  bool drawListCulled = false;
+
+  // populated with options.sceneEntityCount entities, feeds drawList when there's no buildDrawList callback
+  Scene scene;
+  std::vector<uint32_t> visibleSceneRows;
+  // the camera, identity until something drives it
+  VulkanFrameUniforms frameUniforms = { { 0.0f, 0.0f, 1.0f, 1.0f } };
+
+  // one entry per frame in flight, sized before init so that taskCreateVulkanCommandBuffers
+  // and taskCreateVulkanSyncObjects can fill in their parts concurrently
+  std::vector<VulkanFrameData> frames;
+  uint32_t currentFrame = 0;
+  // number of frames submitted so far
+  uint64_t frameNumber = 0;
+
+  // updated by the render loop
+  VulkanFrameTimeStats frameTimeStats;
+  // from the glfwPollEvents that sampled a frame's input until its present call returned, windowed only
+  VulkanFrameTimeStats inputLatencyStats;
+  std::chrono::high_resolution_clock::time_point inputSampleTime;
+
+  // paces the render loop when options.presentPolicy is kCappedFrameRatePresentPolicy
+  FrameLimiter frameLimiter;
+
+  // created by taskCreateVulkanFrameProfiler, stays disabled unless options.frameProfiling is set
+  FrameProfiler frameProfiler;
+};
 
-  // created by taskCreateVulkanCommandBuffers
-  std::vector<VkCommandBuffer> commandBuffers;
+bool isHeadless(const VulkanSquirrelData &data) {
+  return data.options.presentationMode == kHeadlessPresentation;
+}
 
-  // created by taskCreateVulkanSemaphores
-  VkSemaphore imageAvailableSemaphore = VK_NULL_HANDLE;
-  VkSemaphore renderFinishedSemaphore = VK_NULL_HANDLE;
-};
+// multi-line reports go through the logger line by line, so tasks printing concurrently don't interleave mid line
+void logVulkanReport(VulkanSquirrelData &data, const std::function<void(std::ostream&)> &print) {
+  std::stringstream report;
+  print(report);
+
+  std::string line;
+  while (std::getline(report, line)) {
+    data.logger.Log(kInfoLogSeverity, line);
+  }
+}
 
 tsk::TaskResult taskInitGLFWWindow(VulkanSquirrelData &data) {
+
+  if (isHeadless(data)) return tsk::kTaskSuccess;
+
   glfwInit();
   glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-  glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+  glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
   data.window = glfwCreateWindow(data.options.windowWidth, data.options.windowHeight, "VulkanSquirrel", nullptr, nullptr);
 
   if (data.window == nullptr) {
@@ -94,33 +337,78 @@ tsk::TaskResult taskInitGLFWWindow(VulkanSquirrelData &data) {
     };
   }
 
+  glfwSetWindowUserPointer(data.window, &data);
+  glfwSetFramebufferSizeCallback(data.window, [](GLFWwindow* window, int, int) {
+    auto data = static_cast<VulkanSquirrelData*>(glfwGetWindowUserPointer(window));
+    data->swapChainNeedsRecreation = true;
+  });
+
+  return tsk::kTaskSuccess;
+}
+
+tsk::TaskResult taskProbeVulkanInstanceCapabilities(VulkanSquirrelData &data) {
+
+  if (
+    !data.options.capabilityCachePath.empty() &&
+    ReadVulkanCapabilitiesFile(data.options.capabilityCachePath, GetVulkanLoaderVersion(), data.capabilities)
+    ) {
+    data.logger.Write(kInfoLogSeverity) << "Loaded Vulkan capability snapshot from " << data.options.capabilityCachePath;
+    data.capabilitiesFromFile = true;
+    return tsk::kTaskSuccess;
+  }
+
+  data.capabilities.instance = ProbeVulkanInstanceCapabilities();
+  data.capabilitiesChanged = true;
+
   return tsk::kTaskSuccess;
 }
 
+// A snapshot from disk misses whatever was installed since it was written and still lists what was removed.
+// Called before disabling something the snapshot doesn't have, and when instance creation fails on it.
+// Returns false if the capabilities were probed already.
+bool reprobeVulkanInstanceCapabilities(VulkanSquirrelData &data) {
+
+  if (!data.capabilitiesFromFile) {
+    return false;
+  }
+
+  data.logger.Log(kWarningLogSeverity, "Vulkan capability snapshot is out of date, probing again");
+  data.capabilities.instance = ProbeVulkanInstanceCapabilities();
+  data.capabilitiesFromFile = false;
+  data.capabilitiesChanged = true;
+  return true;
+}
+
 tsk::TaskResult taskCheckVulkanExtensions(VulkanSquirrelData &data) {
-  std::vector<VkExtensionProperties> availableExtensions = GetVkExtensions();
+  const std::vector<VkExtensionProperties> &availableExtensions = data.capabilities.instance.extensions;
 
-  std::cout << "available extensions:" << std::endl;
+  data.logger.Log(kDebugLogSeverity, "available extensions:");
 
   for (const auto& availableExtension : availableExtensions) {
-    std::cout << "\t" << availableExtension.extensionName << std::endl;
+    data.logger.Write(kDebugLogSeverity) << "\t" << availableExtension.extensionName;
   }
 
   unsigned int glfwExtensionCount = 0;
-  const char** glfwExtensions;
+  const char** glfwExtensions = nullptr;
 
-  glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+  // headless runs have no surface, so none of the window system extensions are needed
+  if (!isHeadless(data)) {
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+  }
 
-  std::cout << "enabling extensions:" << std::endl;
+  data.logger.Log(kInfoLogSeverity, "enabling extensions:");
 
   const auto checkAndAddExtension = [&](const char* neededExtension) -> bool {
-    const auto availableExtension = FindVkExtension(availableExtensions, neededExtension);
+    auto availableExtension = data.capabilities.instance.FindExtension(neededExtension);
+    if (availableExtension == nullptr && reprobeVulkanInstanceCapabilities(data)) {
+      availableExtension = data.capabilities.instance.FindExtension(neededExtension);
+    }
     if (availableExtension == nullptr) {
       return false;
     }
     else {
       const char* extensionName = (*availableExtension).extensionName;
-      std::cout << "\t" << extensionName << std::endl;
+      data.logger.Write(kInfoLogSeverity) << "\t" << extensionName;
       data.extensions.push_back(*availableExtension);
       return true;
     }
@@ -140,23 +428,23 @@ tsk::TaskResult taskCheckVulkanExtensions(VulkanSquirrelData &data) {
 
   if (data.options.vulkanValidationLayersMode == kEnabledVulkanValidationLayers) {
     if (!checkAndAddExtension(VK_EXT_DEBUG_REPORT_EXTENSION_NAME)) {
-      std::stringstream errorStringStream;
-      errorStringStream << "Vulkan Debug Extension missing" << VK_EXT_DEBUG_REPORT_EXTENSION_NAME;
-      std::cerr << errorStringStream.str() << std::endl;
+      data.logger.Write(kWarningLogSeverity) << "Vulkan Debug Extension missing" << VK_EXT_DEBUG_REPORT_EXTENSION_NAME;
     }
   }
 
   return tsk::kTaskSuccess;
 }
 
-tsk::TaskResult taskInitVulkanInstance(VulkanSquirrelData &data) {
-  bool enableValidationLayersAfterCheck = true;
+VkResult createVulkanInstance(VulkanSquirrelData &data) {
+
+  data.validationLayersEnabled = data.options.vulkanValidationLayersMode == kEnabledVulkanValidationLayers;
   if (
-    data.options.vulkanValidationLayersMode == kEnabledVulkanValidationLayers &&
-    !CheckVkValidationLayerSupport(data.options.vulkanValidationLayers)
+    data.validationLayersEnabled &&
+    !data.capabilities.instance.HasLayers(data.options.vulkanValidationLayers) &&
+    (!reprobeVulkanInstanceCapabilities(data) || !data.capabilities.instance.HasLayers(data.options.vulkanValidationLayers))
     ) {
-    std::cerr << "Vulkan validation layer requested, but not available!";
-    enableValidationLayersAfterCheck = false;
+    data.logger.Log(kWarningLogSeverity, "Vulkan validation layer requested, but not available!");
+    data.validationLayersEnabled = false;
   }
 
   VkApplicationInfo appInfo = {};
@@ -182,7 +470,7 @@ tsk::TaskResult taskInitVulkanInstance(VulkanSquirrelData &data) {
   createInfo.ppEnabledExtensionNames = extensions.data();
 
 
-  if (data.options.vulkanValidationLayersMode == kEnabledVulkanValidationLayers && enableValidationLayersAfterCheck) {
+  if (data.validationLayersEnabled) {
     createInfo.enabledLayerCount = static_cast<uint32_t>(data.options.vulkanValidationLayers.size());
     createInfo.ppEnabledLayerNames = data.options.vulkanValidationLayers.data();
   }
@@ -190,8 +478,28 @@ tsk::TaskResult taskInitVulkanInstance(VulkanSquirrelData &data) {
     createInfo.enabledLayerCount = 0;
   }
 
-  VkResult result;
-  if ((result = vkCreateInstance(&createInfo, nullptr, &data.instance)) != VK_SUCCESS || data.instance == VK_NULL_HANDLE) {
+  return vkCreateInstance(&createInfo, data.allocationCallbacks, &data.instance);
+}
+
+tsk::TaskResult taskInitVulkanInstance(VulkanSquirrelData &data) {
+
+  VkResult result = createVulkanInstance(data);
+
+  // a snapshot from disk doesn't know about layers removed since, probe again and drop what is gone
+  if (
+    (result == VK_ERROR_LAYER_NOT_PRESENT || result == VK_ERROR_EXTENSION_NOT_PRESENT) &&
+    reprobeVulkanInstanceCapabilities(data)
+    ) {
+    data.extensions.erase(
+      std::remove_if(data.extensions.begin(), data.extensions.end(), [&](const VkExtensionProperties &extension) {
+        return data.capabilities.instance.FindExtension(extension.extensionName) == nullptr;
+      }),
+      data.extensions.end());
+
+    result = createVulkanInstance(data);
+  }
+
+  if (result != VK_SUCCESS || data.instance == VK_NULL_HANDLE) {
 
     std::stringstream errorStringStream;
     errorStringStream << "Failed to create Vulkan instance with vk error code:" << result;
@@ -214,7 +522,14 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL VKDebugOutputCallback(
   const char* msg,
   void* userData) {
 
-  std::cerr << "validation layer: " << msg << std::endl;
+  // Called from inside the driver on whichever thread made the call, so format on the stack and never wait.
+  // One character more than a log slot holds, so a message that doesn't fit still arrives too long and gets marked as cut.
+  char message[AsyncLogger::kMaxMessageLength + 2];
+  const int length = snprintf(message, sizeof(message), "validation layer: %s", msg);
+  if (length > 0) {
+    const LogSeverity severity = (flags & VK_DEBUG_REPORT_ERROR_BIT_EXT) ? kErrorLogSeverity : kWarningLogSeverity;
+    static_cast<AsyncLogger*>(userData)->Log(severity, message, std::min(static_cast<size_t>(length), sizeof(message) - 1));
+  }
 
   return VK_FALSE;
 }
@@ -227,11 +542,12 @@ tsk::TaskResult taskInitVulkanDebug(VulkanSquirrelData &data) {
   createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_REPORT_CALLBACK_CREATE_INFO_EXT;
   createInfo.flags = VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT;
   createInfo.pfnCallback = VKDebugOutputCallback;
+  createInfo.pUserData = &data.logger;
 
   VkResult result;
-  if ((result = CreateVkDebugReportCallbackEXT(data.instance, &createInfo, nullptr, &data.callbackDebugInstance)) != VK_SUCCESS) {
+  if ((result = CreateVkDebugReportCallbackEXT(data.instance, &createInfo, data.allocationCallbacks, &data.callbackDebugInstance)) != VK_SUCCESS) {
 
-    std::cerr << "Failed to set up vulkan debug callback with vk error code:" << result << std::endl;
+    data.logger.Write(kWarningLogSeverity) << "Failed to set up vulkan debug callback with vk error code:" << result;
     return tsk::kTaskSuccess; // failing here is not critical
   }
 
@@ -240,8 +556,10 @@ tsk::TaskResult taskInitVulkanDebug(VulkanSquirrelData &data) {
 
 tsk::TaskResult taskCreateVulkanSurface(VulkanSquirrelData &data) {
 
+  if (isHeadless(data)) return tsk::kTaskSuccess;
+
   VkResult result;
-  if ((result = glfwCreateWindowSurface(data.instance, data.window, nullptr, &data.surface)) != VK_SUCCESS) {
+  if ((result = glfwCreateWindowSurface(data.instance, data.window, data.allocationCallbacks, &data.surface)) != VK_SUCCESS) {
 
     std::stringstream errorStringStream;
     errorStringStream << "Failed to create Vulkan surface with vk error code: " << result;
@@ -255,61 +573,56 @@ tsk::TaskResult taskCreateVulkanSurface(VulkanSquirrelData &data) {
   return tsk::kTaskSuccess;
 }
 
-int findSuitableVKQueue(const VkPhysicalDevice &device, const VkSurfaceKHR &surface) {
-
-  std::vector<VkQueueFamilyProperties> queueFamilies = GetVkFamiliesOfDevice(device);
-
-  bool foundQueueWithGraphicsCapabilityAndPresentation = false;
-  for (int i = 0; i < queueFamilies.size(); ++i) {
-    const auto& queueFamily = queueFamilies[i];
-
-    VkBool32 presentSupport = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-    if (presentSupport && queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-
-      return i;
-    }
-  }
-
-  return -1;
-}
-
-bool isVKDeviceSuitable(const VkPhysicalDevice &device, const VkSurfaceKHR &surface, const std::vector<const char*> &extensions) {
-
-  VkPhysicalDeviceProperties deviceProperties;
-  vkGetPhysicalDeviceProperties(device, &deviceProperties);
-
-  //unused for now
-  //VkPhysicalDeviceFeatures deviceFeatures;
-  //vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+bool isVKDeviceSuitable(
+  const VulkanDeviceCapabilities &device,
+  const VkSurfaceKHR &surface,
+  const std::vector<const char*> &extensions,
+  bool requireDiscreteGPU,
+  VulkanQueueTopology &topology) {
 
-  if (deviceProperties.deviceType != VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
+  if (requireDiscreteGPU && device.properties.deviceType != VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
     return false;
   }
 
-  if (!CheckVkExtensionSupport(device, extensions)) {
+  if (!device.HasExtensions(extensions)) {
     return false;
   }
 
-  return findSuitableVKQueue(device, surface) != -1;
+  topology = DiscoverVulkanQueueTopology(device.physicalDevice, device.queueFamilies, surface);
+  return topology.IsComplete();
 }
 
 tsk::TaskResult taskPickVulkanPhysicalDevice(VulkanSquirrelData &data) {
 
-  uint32_t deviceCount = 0;
-  vkEnumeratePhysicalDevices(data.instance, &deviceCount, nullptr);
-
-  std::vector<VkPhysicalDevice> devices(deviceCount);
+  const size_t snapshotDeviceCount = data.capabilities.devices.size();
+  const uint32_t probedCount = UpdateVulkanDeviceCapabilities(
+    data.instance,
+    data.validationLayersEnabled ? data.options.vulkanValidationLayers : std::vector<const char*>(),
+    data.capabilities);
+  if (probedCount > 0 || data.capabilities.devices.size() != snapshotDeviceCount) {
+    data.capabilitiesChanged = true;
+  }
 
-  VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-  vkEnumeratePhysicalDevices(data.instance, &deviceCount, devices.data());
-  for (const auto& device : devices) {
-    if (isVKDeviceSuitable(device, data.surface, data.options.vulkanExtensions)) {
-      data.physicalDevice = device;
+  for (const auto& device : data.capabilities.devices) {
+    // headless runs target CI and render farm nodes, which typically only have a CPU driver such as lavapipe
+    VulkanQueueTopology topology;
+    if (isVKDeviceSuitable(device, data.surface, data.options.vulkanExtensions, !isHeadless(data), topology)) {
+      data.physicalDevice = device.physicalDevice;
+      data.physicalDeviceProperties = device.properties;
+      data.queueTopology = topology;
       break;
     }
   }
 
+  if (data.capabilitiesChanged && !data.options.capabilityCachePath.empty()) {
+    if (WriteVulkanCapabilitiesFile(data.options.capabilityCachePath, data.capabilities)) {
+      data.logger.Write(kInfoLogSeverity) << "Wrote Vulkan capability snapshot to " << data.options.capabilityCachePath;
+    }
+    else {
+      data.logger.Write(kWarningLogSeverity) << "Failed to write Vulkan capability snapshot to " << data.options.capabilityCachePath;
+    }
+  }
+
   if (data.physicalDevice == VK_NULL_HANDLE) {
     return {
       false,
@@ -323,36 +636,40 @@ tsk::TaskResult taskPickVulkanPhysicalDevice(VulkanSquirrelData &data) {
 
 tsk::TaskResult taskCreateVulkanLogicalDevice(VulkanSquirrelData &data) {
 
-  bool enableValidationLayersAfterCheck = false;
-  if (data.options.vulkanValidationLayersMode == kEnabledVulkanValidationLayers && !CheckVkValidationLayerSupport(data.options.vulkanValidationLayers)) {
-    std::cerr << "vulkan validation layers requested, but not available!" << std::endl;
+  logVulkanReport(data, [&](std::ostream &out) { PrintVulkanQueueTopology(data.queueTopology, out); });
 
-    enableValidationLayersAfterCheck = true;
-  }
+  // every queue gets the same priority, there's no latency critical work that should starve the rest
+  std::vector<uint32_t> queueCounts = data.queueTopology.GetQueueCounts();
+  std::vector<float> queuePriorities(*std::max_element(queueCounts.begin(), queueCounts.end()), 1.0f);
+  std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 
-  data.mainQueueFamilyIndex = findSuitableVKQueue(data.physicalDevice, data.surface);
-  VkDeviceQueueCreateInfo queueCreateInfo = {};
-  queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-  queueCreateInfo.queueFamilyIndex = data.mainQueueFamilyIndex;
-  queueCreateInfo.queueCount = 1;
+  for (uint32_t familyIndex = 0; familyIndex < queueCounts.size(); ++familyIndex) {
+    if (queueCounts[familyIndex] == 0) {
+      continue;
+    }
 
-  float queuePriority = 1.0f;
-  queueCreateInfo.pQueuePriorities = &queuePriority;
+    VkDeviceQueueCreateInfo queueCreateInfo = {};
+    queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueCreateInfo.queueFamilyIndex = familyIndex;
+    queueCreateInfo.queueCount = queueCounts[familyIndex];
+    queueCreateInfo.pQueuePriorities = queuePriorities.data();
+    queueCreateInfos.push_back(queueCreateInfo);
+  }
 
   VkPhysicalDeviceFeatures deviceFeatures = {}; // empty for now
 
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
-  createInfo.pQueueCreateInfos = &queueCreateInfo;
-  createInfo.queueCreateInfoCount = 1;
+  createInfo.pQueueCreateInfos = queueCreateInfos.data();
+  createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 
   createInfo.pEnabledFeatures = &deviceFeatures;
 
   createInfo.enabledExtensionCount = static_cast<uint32_t>(data.options.vulkanExtensions.size());
   createInfo.ppEnabledExtensionNames = data.options.vulkanExtensions.data();
 
-  if (enableValidationLayersAfterCheck && data.options.vulkanValidationLayersMode == kEnabledVulkanValidationLayers) {
+  if (data.validationLayersEnabled) {
     createInfo.enabledLayerCount = static_cast<uint32_t>(data.options.vulkanValidationLayers.size());
     createInfo.ppEnabledLayerNames = data.options.vulkanValidationLayers.data();
   }
@@ -361,7 +678,7 @@ tsk::TaskResult taskCreateVulkanLogicalDevice(VulkanSquirrelData &data) {
   }
 
   VkResult result;
-  if ((result = vkCreateDevice(data.physicalDevice, &createInfo, nullptr, &data.device)) != VK_SUCCESS || data.device == VK_NULL_HANDLE) {
+  if ((result = vkCreateDevice(data.physicalDevice, &createInfo, data.allocationCallbacks, &data.device)) != VK_SUCCESS || data.device == VK_NULL_HANDLE) {
 
     return {
       false,
@@ -370,13 +687,196 @@ tsk::TaskResult taskCreateVulkanLogicalDevice(VulkanSquirrelData &data) {
     };
   }
 
-  vkGetDeviceQueue(data.device, data.mainQueueFamilyIndex, 0, &data.mainQueue);
+  const auto getQueue = [&](VulkanQueueRole role, uint32_t &familyIndex, VkQueue &queue) {
+    const VulkanQueueSlot &slot = data.queueTopology.Get(role);
+    familyIndex = slot.familyIndex;
+    vkGetDeviceQueue(data.device, slot.familyIndex, slot.queueIndex, &queue);
+  };
+
+  getQueue(kGraphicsQueueRole, data.mainQueueFamilyIndex, data.mainQueue);
+  getQueue(kPresentQueueRole, data.presentQueueFamilyIndex, data.presentQueue);
+  getQueue(kComputeQueueRole, data.computeQueueFamilyIndex, data.computeQueue);
+  getQueue(kTransferQueueRole, data.transferQueueFamilyIndex, data.transferQueue);
+
+  data.asyncCompute = data.options.asyncCompute && data.queueTopology.HasOwnQueue(kComputeQueueRole);
+
+  return tsk::kTaskSuccess;
+}
+
+tsk::TaskResult taskCreateVulkanMemoryAllocator(VulkanSquirrelData &data) {
+
+  data.memoryAllocator.Init(data.physicalDevice, data.device, VulkanMemoryAllocator::kDefaultBlockSize, data.allocationCallbacks);
+
+  return tsk::kTaskSuccess;
+}
+
+tsk::TaskResult taskCreateVulkanUploader(VulkanSquirrelData &data) {
+
+  VkResult result;
+  if ((result = data.uploader.Init(
+    data.physicalDevice,
+    data.device,
+    data.memoryAllocator,
+    data.transferQueue,
+    data.transferQueueFamilyIndex,
+    data.mainQueueFamilyIndex,
+    VulkanUploader::kDefaultStagingSize,
+    data.allocationCallbacks)) != VK_SUCCESS) {
+
+    std::stringstream errorStringStream;
+    errorStringStream << "Failed to create Vulkan uploader with vk error code: " << result;
+    return {
+      false,
+      kVKFailedToCreateUploader,
+      errorStringStream.str()
+    };
+  }
+
+  return tsk::kTaskSuccess;
+}
+
+tsk::TaskResult taskCreateVulkanDescriptorAllocator(VulkanSquirrelData &data) {
+  data.descriptorLayoutCache.Init(data.device, data.allocationCallbacks);
+  data.descriptorAllocator.Init(
+    data.device,
+    data.descriptorLayoutCache,
+    static_cast<uint32_t>(data.frames.size()),
+    VulkanDescriptorAllocator::kDefaultSetsPerPool,
+    data.allocationCallbacks);
+  return tsk::kTaskSuccess;
+}
+
+tsk::TaskResult taskCreateVulkanFrameUniforms(VulkanSquirrelData &data) {
+
+  VkResult result;
+  if ((result = data.uniformAllocator.Init(
+    data.physicalDevice,
+    data.memoryAllocator,
+    static_cast<uint32_t>(data.frames.size()))) != VK_SUCCESS) {
+
+    std::stringstream errorStringStream;
+    errorStringStream << "Failed to create Vulkan frame uniform buffer with vk error code: " << result;
+    return {
+      false,
+      kVKFailedToCreateFrameUniformBuffer,
+      errorStringStream.str()
+    };
+  }
+
+  const auto descriptorFailure = [&](const char* what) -> tsk::TaskResult {
+    std::stringstream errorStringStream;
+    errorStringStream << "Failed to create Vulkan " << what << " with vk error code: " << result;
+    return {
+      false,
+      kVKFailedToCreateFrameDescriptorSet,
+      errorStringStream.str()
+    };
+  };
+
+  VkDescriptorSetLayoutBinding binding = {};
+  binding.binding = 0;
+  binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  binding.descriptorCount = 1;
+  binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+  if ((result = data.descriptorLayoutCache.GetLayout(&binding, 1, data.frameDescriptorSetLayout)) != VK_SUCCESS) {
+    return descriptorFailure("descriptor set layout");
+  }
+
+  if ((result = data.descriptorAllocator.AllocatePersistentSet(data.frameDescriptorSetLayout, data.frameDescriptorSet)) != VK_SUCCESS) {
+    return descriptorFailure("descriptor set");
+  }
+
+  VkDescriptorBufferInfo bufferInfo = {};
+  bufferInfo.buffer = data.uniformAllocator.GetBuffer();
+  bufferInfo.offset = 0;
+  bufferInfo.range = data.uniformAllocator.GetBindingRange();
+
+  VkWriteDescriptorSet write = {};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = data.frameDescriptorSet;
+  write.dstBinding = 0;
+  write.dstArrayElement = 0;
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  write.pBufferInfo = &bufferInfo;
+
+  vkUpdateDescriptorSets(data.device, 1, &write, 0, nullptr);
+
+  return tsk::kTaskSuccess;
+}
+
+void printVulkanMemoryStats(const VulkanSquirrelData &data, std::ostream &out) {
+  VulkanMemoryStats stats = data.memoryAllocator.GetStats();
+
+  out
+    << "Vulkan memory: " << stats.allocationCount << " allocations in "
+    << stats.blockCount << " blocks + " << stats.dedicatedAllocationCount << " dedicated, "
+    << stats.requestedBytes << " bytes requested, "
+    << stats.allocatedBytes << " allocated, "
+    << stats.reservedBytes << " reserved, largest free range "
+    << stats.largestFreeRange << " of " << stats.freeBytes << " free bytes" << std::endl;
+}
+
+tsk::TaskResult taskCreateVulkanPipelineCache(VulkanSquirrelData &data) {
+
+  std::vector<char> cacheData;
+  if (!data.options.pipelineCachePath.empty()) {
+    if (ReadVkPipelineCacheFile(data.options.pipelineCachePath, data.physicalDeviceProperties, cacheData)) {
+      data.logger.Write(kInfoLogSeverity) << "Loaded Vulkan pipeline cache with " << cacheData.size() << " bytes";
+    }
+    else {
+      data.logger.Log(kInfoLogSeverity, "No usable Vulkan pipeline cache found, starting with an empty one");
+      cacheData.clear();
+    }
+  }
+
+  VkPipelineCacheCreateInfo createInfo = {};
+  createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  createInfo.initialDataSize = cacheData.size();
+  createInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+
+  VkResult result;
+  if ((result = vkCreatePipelineCache(data.device, &createInfo, data.allocationCallbacks, &data.pipelineCache)) != VK_SUCCESS) {
+
+    std::stringstream errorStringStream;
+    errorStringStream << "Failed to create Vulkan pipeline cache with vk error code: " << result;
+    return {
+      false,
+      kVKFailedToCreatePipelineCache,
+      errorStringStream.str()
+    };
+  }
 
   return tsk::kTaskSuccess;
 }
 
+void saveVulkanPipelineCache(VulkanSquirrelData &data) {
+
+  if (data.options.pipelineCachePath.empty() || data.pipelineCache == VK_NULL_HANDLE) {
+    return;
+  }
+
+  size_t cacheSize = 0;
+  if (vkGetPipelineCacheData(data.device, data.pipelineCache, &cacheSize, nullptr) != VK_SUCCESS || cacheSize == 0) {
+    return;
+  }
+
+  std::vector<char> cacheData(cacheSize);
+  if (vkGetPipelineCacheData(data.device, data.pipelineCache, &cacheSize, cacheData.data()) != VK_SUCCESS) {
+    return;
+  }
+  cacheData.resize(cacheSize);
+
+  if (!WriteVkPipelineCacheFile(data.options.pipelineCachePath, data.physicalDeviceProperties, cacheData)) {
+    data.logger.Write(kWarningLogSeverity) << "Failed to write Vulkan pipeline cache to " << data.options.pipelineCachePath;
+  }
+}
+
 tsk::TaskResult taskCheckVulkanSurfaceCapabilities(VulkanSquirrelData &data) {
 
+  if (isHeadless(data)) return tsk::kTaskSuccess;
+
   vkGetPhysicalDeviceSurfaceCapabilitiesKHR(data.physicalDevice, data.surface, &data.surfaceCapabilities);
 
   uint32_t formatCount;
@@ -398,14 +898,20 @@ tsk::TaskResult taskCheckVulkanSurfaceCapabilities(VulkanSquirrelData &data) {
   return tsk::kTaskSuccess;
 }
 
-VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR> availablePresentModes) {
+VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR> availablePresentModes, VulkanPresentPolicy policy) {
+  // FIFO is the only mode every implementation has to support
   VkPresentModeKHR bestMode = VK_PRESENT_MODE_FIFO_KHR;
 
+  if (policy == kPowerSavingPresentPolicy) {
+    return bestMode;
+  }
+
   for (const auto& availablePresentMode : availablePresentModes) {
     if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
       return availablePresentMode;
     }
-    else if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
+    // tears, only worth it when latency is all that matters, a capped frame rate doesn't need it
+    else if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR && policy == kLowLatencyPresentPolicy) {
       bestMode = availablePresentMode;
     }
   }
@@ -413,6 +919,16 @@ VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR> avail
   return bestMode;
 }
 
+const char* getVulkanPresentModeName(VkPresentModeKHR presentMode) {
+  switch (presentMode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+    case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo relaxed";
+    default: return "unknown";
+  }
+}
+
 VkExtent2D chooseSwapExtent(const uint32_t &width, const uint32_t &height, const VkSurfaceCapabilitiesKHR& capabilities) {
   if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
     return capabilities.currentExtent;
@@ -441,11 +957,9 @@ VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>
   return availableFormats[0];
 }
 
-tsk::TaskResult taskCreateVulkanSwapChain(VulkanSquirrelData &data) {
+VkResult createVulkanSwapChain(VulkanSquirrelData &data, uint32_t width, uint32_t height, VkSwapchainKHR oldSwapChain) {
 
-  data.surfaceFormat = chooseSwapSurfaceFormat(data.surfaceFormats);
-  data.presentMode = chooseSwapPresentMode(data.surfacePresentModes);
-  data.swapChainExtent = chooseSwapExtent(data.options.windowWidth, data.options.windowHeight, data.surfaceCapabilities);
+  data.swapChainExtent = chooseSwapExtent(width, height, data.surfaceCapabilities);
 
   // we try one more than minimum to implement triple buffering
   uint32_t imageCount = data.surfaceCapabilities.minImageCount + 1;
@@ -464,18 +978,46 @@ tsk::TaskResult taskCreateVulkanSwapChain(VulkanSquirrelData &data) {
   createInfo.imageArrayLayers = 1;
   createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
-  createInfo.pQueueFamilyIndices = &data.mainQueueFamilyIndex;
-  createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  // rendered on the graphics queue and presented from the present queue, ownership transfers every frame would cost more
+  uint32_t queueFamilyIndices[] = { data.mainQueueFamilyIndex, data.presentQueueFamilyIndex };
+  if (data.presentQueueFamilyIndex != data.mainQueueFamilyIndex) {
+    createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+    createInfo.queueFamilyIndexCount = 2;
+    createInfo.pQueueFamilyIndices = queueFamilyIndices;
+  }
+  else {
+    createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  }
 
   createInfo.preTransform = data.surfaceCapabilities.currentTransform;
   createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
   createInfo.presentMode = data.presentMode;
   createInfo.clipped = VK_TRUE;
 
-  createInfo.oldSwapchain = VK_NULL_HANDLE;
+  // lets the driver hand resources over from the swap chain being replaced
+  createInfo.oldSwapchain = oldSwapChain;
+
+  VkResult result;
+  if ((result = vkCreateSwapchainKHR(data.device, &createInfo, data.allocationCallbacks, &data.swapChain)) != VK_SUCCESS) {
+    return result;
+  }
+
+  vkGetSwapchainImagesKHR(data.device, data.swapChain, &imageCount, nullptr);
+  data.swapChainImages.resize(imageCount);
+  vkGetSwapchainImagesKHR(data.device, data.swapChain, &imageCount, data.swapChainImages.data());
+
+  return VK_SUCCESS;
+}
+
+tsk::TaskResult taskCreateVulkanSwapChain(VulkanSquirrelData &data) {
+
+  if (isHeadless(data)) return tsk::kTaskSuccess;
+
+  data.surfaceFormat = chooseSwapSurfaceFormat(data.surfaceFormats);
+  data.presentMode = chooseSwapPresentMode(data.surfacePresentModes, data.options.presentPolicy);
 
   VkResult result;
-  if ((result = vkCreateSwapchainKHR(data.device, &createInfo, nullptr, &data.swapChain)) != VK_SUCCESS) {
+  if ((result = createVulkanSwapChain(data, data.options.windowWidth, data.options.windowHeight, VK_NULL_HANDLE)) != VK_SUCCESS) {
 
     std::stringstream errorStringStream;
     errorStringStream << "Failed to create Vulkan swap chain with vk error code: " << result;
@@ -486,9 +1028,58 @@ tsk::TaskResult taskCreateVulkanSwapChain(VulkanSquirrelData &data) {
     };
   }
 
-  vkGetSwapchainImagesKHR(data.device, data.swapChain, &imageCount, nullptr);
-  data.swapChainImages.resize(imageCount);
-  vkGetSwapchainImagesKHR(data.device, data.swapChain, &imageCount, data.swapChainImages.data());
+  return tsk::kTaskSuccess;
+}
+
+uint32_t getVulkanFrameCount(const VulkanSquirrelOptions &options) {
+  if (options.frameSubmissionMode == kSerializedFrameSubmission) {
+    return 1;
+  }
+
+  return std::max(options.framesInFlight, 1u);
+}
+
+tsk::TaskResult taskCreateVulkanOffscreenImages(VulkanSquirrelData &data) {
+
+  if (!isHeadless(data)) return tsk::kTaskSuccess;
+
+  data.surfaceFormat = { VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
+  data.swapChainExtent = { static_cast<uint32_t>(data.options.windowWidth), static_cast<uint32_t>(data.options.windowHeight) };
+
+  // one image per frame in flight, so frame slot i always renders into image i
+  uint32_t imageCount = getVulkanFrameCount(data.options);
+  data.offscreenImages.resize(imageCount, VK_NULL_HANDLE);
+  data.offscreenImageMemory.resize(imageCount);
+
+  for (uint32_t i = 0; i < imageCount; ++i) {
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = data.surfaceFormat.format;
+    imageInfo.extent = { data.swapChainExtent.width, data.swapChainExtent.height, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VkResult result;
+    if ((result = data.memoryAllocator.CreateImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, data.offscreenImages[i], data.offscreenImageMemory[i])) != VK_SUCCESS) {
+
+      std::stringstream errorStringStream;
+      errorStringStream << "Failed to create Vulkan offscreen image with vk error code: " << result;
+      return {
+        false,
+        kVKFailedToCreateOffscreenImage,
+        errorStringStream.str()
+      };
+    }
+  }
+
+  // the rest of the pipeline treats the offscreen ring like swap chain images
+  data.swapChainImages = data.offscreenImages;
 
   return tsk::kTaskSuccess;
 }
@@ -516,7 +1107,7 @@ tsk::TaskResult taskCreateVulkanSwapChainImageViews(VulkanSquirrelData &data) {
     createInfo.subresourceRange.layerCount = 1;
 
     VkResult result;
-    if ((result = vkCreateImageView(data.device, &createInfo, nullptr, &data.swapChainImageViews[i])) != VK_SUCCESS) {
+    if ((result = vkCreateImageView(data.device, &createInfo, data.allocationCallbacks, &data.swapChainImageViews[i])) != VK_SUCCESS) {
 
       std::stringstream errorStringStream;
       errorStringStream << "Failed to create Vulkan swap chain image view with vk error code: " << result;
@@ -528,45 +1119,96 @@ tsk::TaskResult taskCreateVulkanSwapChainImageViews(VulkanSquirrelData &data) {
     }
   }
 
+  if (isHeadless(data)) {
+    return tsk::kTaskSuccess;
+  }
+
+  VkSemaphoreCreateInfo semaphoreInfo = {};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+  data.renderFinishedSemaphores.resize(data.swapChainImages.size(), VK_NULL_HANDLE);
+  for (auto &semaphore : data.renderFinishedSemaphores) {
+    VkResult result;
+    if ((result = vkCreateSemaphore(data.device, &semaphoreInfo, data.allocationCallbacks, &semaphore)) != VK_SUCCESS) {
+
+      std::stringstream errorStringStream;
+      errorStringStream << "Failed to create Vulkan semaphore with vk error code: " << result;
+      return {
+        false,
+        kVKFailedToCreateDefaultVulkanSemaphore,
+        errorStringStream.str()
+      };
+    }
+  }
+
   return tsk::kTaskSuccess;
 }
 
-bool readFile(const std::string& filename, std::vector<char> &output) {
+// reads into uint32_t storage so the result is aligned for SPIR-V, size is the file size in bytes
+bool readFile(const std::string& filename, std::vector<uint32_t> &output, size_t &size) {
   std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
   if (!file.is_open()) {
     return false;
   }
 
-  size_t fileSize = (size_t)file.tellg();
-  output.resize(fileSize);
+  size = (size_t)file.tellg();
+  output.resize((size + sizeof(uint32_t) - 1) / sizeof(uint32_t));
 
   file.seekg(0);
-  file.read(output.data(), fileSize);
+  file.read(reinterpret_cast<char*>(output.data()), size);
 
   file.close();
 
   return true;
 }
 
-tsk::TaskResult taskCreateVulkanDefaultRenderPass(VulkanSquirrelData &data) {
+tsk::TaskResult taskOpenAssetPack(VulkanSquirrelData &data) {
 
-  VkAttachmentDescription colorAttachment = {};
-  colorAttachment.format = data.surfaceFormat.format;
-  colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  if (data.options.assetPackPath.empty()) return tsk::kTaskSuccess;
 
-  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  // not an error, assets are then read as loose files
+  if (!data.assetPack.Open(data.options.assetPackPath)) {
+    data.logger.Write(kInfoLogSeverity) << "No usable asset pack at " << data.options.assetPackPath << ", reading loose asset files";
+  }
 
-  colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  return tsk::kTaskSuccess;
+}
 
-  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+// looks the asset up in the pack first, and falls back to ./Assets/name, looseStorage then owns the data
+bool readAsset(VulkanSquirrelData &data, const std::string &name, std::vector<uint32_t> &looseStorage, AssetView &output) {
 
-  VkAttachmentReference colorAttachmentRef = {};
-  colorAttachmentRef.attachment = 0;
-  colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  if (data.assetPack.IsOpen() && data.assetPack.Find(name, output)) {
+    return true;
+  }
+
+  if (!readFile("./Assets/" + name, looseStorage, output.size)) {
+    return false;
+  }
+
+  output.data = looseStorage.data();
+  return true;
+}
+
+tsk::TaskResult taskCreateVulkanDefaultRenderPass(VulkanSquirrelData &data) {
+
+  VkAttachmentDescription colorAttachment = {};
+  colorAttachment.format = data.surfaceFormat.format;
+  colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+
+  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+  colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+  // the render graph transitions the image around the pass and orders it against the acquire
+  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentReference colorAttachmentRef = {};
+  colorAttachmentRef.attachment = 0;
+  colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
   VkSubpassDescription subpass = {};
   subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
@@ -581,21 +1223,8 @@ tsk::TaskResult taskCreateVulkanDefaultRenderPass(VulkanSquirrelData &data) {
   renderPassInfo.subpassCount = 1;
   renderPassInfo.pSubpasses = &subpass;
 
-  VkSubpassDependency dependency = {};
-  dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-  dependency.dstSubpass = 0;
-
-  dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  dependency.srcAccessMask = 0;
-
-  dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-  renderPassInfo.dependencyCount = 1;
-  renderPassInfo.pDependencies = &dependency;
-
   VkResult result;
-  if ((result = vkCreateRenderPass(data.device, &renderPassInfo, nullptr, &data.defaultRenderPass)) != VK_SUCCESS) {
+  if ((result = vkCreateRenderPass(data.device, &renderPassInfo, data.allocationCallbacks, &data.defaultRenderPass)) != VK_SUCCESS) {
 
     std::stringstream errorStringStream;
     errorStringStream << "Failed to create Vulkan render pass with vk error code: " << result;
@@ -609,12 +1238,9 @@ tsk::TaskResult taskCreateVulkanDefaultRenderPass(VulkanSquirrelData &data) {
   return tsk::kTaskSuccess;
 }
 
-tsk::TaskResult taskCreateVulkanDefaultPipeline(VulkanSquirrelData &data) {
-
-  std::vector<char> vertShaderCode;
-  std::vector<char> fragShaderCode;
+tsk::TaskResult taskReadVulkanDefaultShaders(VulkanSquirrelData &data) {
 
-  if (!readFile("./Assets/test.vert.spv", vertShaderCode)) {
+  if (!readAsset(data, "test.vert.spv", data.looseVertShaderCode, data.vertShaderCode)) {
     return {
       false,
       kVKFailedToReadDefaultVulkanVertShader,
@@ -622,7 +1248,7 @@ tsk::TaskResult taskCreateVulkanDefaultPipeline(VulkanSquirrelData &data) {
     };
   }
 
-  if (!readFile("./Assets/test.frag.spv", fragShaderCode)) {
+  if (!readAsset(data, "test.frag.spv", data.looseFragShaderCode, data.fragShaderCode)) {
     return {
       false,
       kVKFailedToReadDefaultVulkanFragShader,
@@ -630,8 +1256,54 @@ tsk::TaskResult taskCreateVulkanDefaultPipeline(VulkanSquirrelData &data) {
     };
   }
 
+  return tsk::kTaskSuccess;
+}
+
+// Every graphics pipeline draws into the default render pass with the same fixed function state,
+// they only differ in shaders and layout.
+VulkanPipelineState makeVulkanPipelineState(
+  const VulkanSquirrelData &data,
+  VkShaderModule vertShaderModule,
+  VkShaderModule fragShaderModule,
+  VkPipelineLayout pipelineLayout) {
+
+  VulkanPipelineState state;
+  state.vertShaderModule = vertShaderModule;
+  state.fragShaderModule = fragShaderModule;
+  state.layout = pipelineLayout;
+  state.renderPass = data.defaultRenderPass;
+  state.subpass = 0;
+  return state;
+}
+
+VkResult createVulkanGraphicsPipeline(
+  const VulkanSquirrelData &data,
+  VkShaderModule vertShaderModule,
+  VkShaderModule fragShaderModule,
+  VkPipelineLayout pipelineLayout,
+  VkPipeline &pipeline) {
+
+  return CreateVulkanGraphicsPipeline(
+    data.device,
+    data.pipelineCache,
+    makeVulkanPipelineState(data, vertShaderModule, fragShaderModule, pipelineLayout),
+    pipeline,
+    data.allocationCallbacks);
+}
+
+// The pipeline of every material, the default one until its variant finished compiling in the background.
+void resolveVulkanMaterialPipelines(VulkanSquirrelData &data) {
+  for (uint32_t material = 0; material < kMaterialTintCount; ++material) {
+    VulkanPipelineState state = makeVulkanPipelineState(data, data.vertShaderModule, data.fragShaderModule, data.defaultPipelineLayout);
+    state.blendMode = kMaterialBlendModes[material];
+    data.materialPipelines[material] = data.pipelineVariants.Get(state, data.defaultGraphicsPipeline);
+  }
+}
+
+tsk::TaskResult taskCreateVulkanDefaultPipeline(VulkanSquirrelData &data) {
+
   {
-    VkResult vertResult = createVkShaderModule(data.device, vertShaderCode, data.vertShaderModule);
+    VkResult vertResult = createVkShaderModule(data.device, static_cast<const uint32_t*>(data.vertShaderCode.data), data.vertShaderCode.size, data.allocationCallbacks, data.vertShaderModule);
     if (vertResult != VK_SUCCESS) {
 
       std::stringstream errorStringStream;
@@ -645,7 +1317,7 @@ tsk::TaskResult taskCreateVulkanDefaultPipeline(VulkanSquirrelData &data) {
   }
 
   {
-    VkResult fragResult = createVkShaderModule(data.device, fragShaderCode, data.fragShaderModule);
+    VkResult fragResult = createVkShaderModule(data.device, static_cast<const uint32_t*>(data.fragShaderCode.data), data.fragShaderCode.size, data.allocationCallbacks, data.fragShaderModule);
     if (fragResult != VK_SUCCESS) {
 
       std::stringstream errorStringStream;
@@ -658,119 +1330,22 @@ tsk::TaskResult taskCreateVulkanDefaultPipeline(VulkanSquirrelData &data) {
     }
   }
 
-  VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
-  vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-  vertShaderStageInfo.module = data.vertShaderModule;
-  vertShaderStageInfo.pName = "main";
-
-  VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
-  fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-  fragShaderStageInfo.module = data.fragShaderModule;
-  fragShaderStageInfo.pName = "main";
-
-  VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
-
-  VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-  vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-  vertexInputInfo.vertexBindingDescriptionCount = 0;
-  vertexInputInfo.pVertexBindingDescriptions = nullptr; // Optional
-  vertexInputInfo.vertexAttributeDescriptionCount = 0;
-  vertexInputInfo.pVertexAttributeDescriptions = nullptr; // Optional
-
-  VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-  inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-  inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-  inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-  VkViewport viewport = {};
-  viewport.x = 0.0f;
-  viewport.y = 0.0f;
-  viewport.width = static_cast<float>(data.swapChainExtent.width);
-  viewport.height = static_cast<float>(data.swapChainExtent.height);
-  viewport.minDepth = 0.0f;
-  viewport.maxDepth = 1.0f;
-
-  VkRect2D scissor = {};
-  scissor.offset = { 0, 0 };
-  scissor.extent = data.swapChainExtent;
-
-  VkPipelineViewportStateCreateInfo viewportState = {};
-  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-  viewportState.viewportCount = 1;
-  viewportState.pViewports = &viewport;
-  viewportState.scissorCount = 1;
-  viewportState.pScissors = &scissor;
-
-  VkPipelineRasterizationStateCreateInfo rasterizer = {};
-  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-  rasterizer.depthClampEnable = VK_FALSE;
-
-  rasterizer.rasterizerDiscardEnable = VK_FALSE;
-
-  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-
-  rasterizer.lineWidth = 1.0f;
-
-  rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-  rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-
-  rasterizer.depthBiasEnable = VK_FALSE;
-  rasterizer.depthBiasConstantFactor = 0.0f; // Optional
-  rasterizer.depthBiasClamp = 0.0f; // Optional
-  rasterizer.depthBiasSlopeFactor = 0.0f; // Optional
-
-  VkPipelineMultisampleStateCreateInfo multisampling = {};
-  multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-  multisampling.sampleShadingEnable = VK_FALSE;
-  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-  multisampling.minSampleShading = 1.0f; // Optional
-  multisampling.pSampleMask = nullptr; // Optional
-  multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
-  multisampling.alphaToOneEnable = VK_FALSE; // Optional
-
-  VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-  colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-  colorBlendAttachment.blendEnable = VK_FALSE;
-  colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-  colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-  colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD; // Optional
-  colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-  colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-  colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD; // Optional
-
-  VkPipelineColorBlendStateCreateInfo colorBlending = {};
-  colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-  colorBlending.logicOpEnable = VK_FALSE;
-  colorBlending.logicOp = VK_LOGIC_OP_COPY; // Optional
-  colorBlending.attachmentCount = 1;
-  colorBlending.pAttachments = &colorBlendAttachment;
-  colorBlending.blendConstants[0] = 0.0f; // Optional
-  colorBlending.blendConstants[1] = 0.0f; // Optional
-  colorBlending.blendConstants[2] = 0.0f; // Optional
-  colorBlending.blendConstants[3] = 0.0f; // Optional
-
-  VkDynamicState dynamicStates[] = {
-    VK_DYNAMIC_STATE_VIEWPORT,
-    VK_DYNAMIC_STATE_LINE_WIDTH
-  };
-
-  VkPipelineDynamicStateCreateInfo dynamicState = {};
-  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-  dynamicState.dynamicStateCount = 2;
-  dynamicState.pDynamicStates = dynamicStates;
-
   VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipelineLayoutInfo.setLayoutCount = 0; // Optional
-  pipelineLayoutInfo.pSetLayouts = nullptr; // Optional
-  pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-  pipelineLayoutInfo.pPushConstantRanges = 0; // Optional
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &data.frameDescriptorSetLayout;
+
+  VkPushConstantRange pushConstantRange = {};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(VulkanDrawPushConstants);
+
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
   {
     VkResult result;
-    if ((result = vkCreatePipelineLayout(data.device, &pipelineLayoutInfo, nullptr, &data.defaultPipelineLayout)) != VK_SUCCESS) {
+    if ((result = vkCreatePipelineLayout(data.device, &pipelineLayoutInfo, data.allocationCallbacks, &data.defaultPipelineLayout)) != VK_SUCCESS) {
 
       std::stringstream errorStringStream;
       errorStringStream << "Failed to create Vulkan pipeline layout with vk error code: " << result;
@@ -782,31 +1357,9 @@ tsk::TaskResult taskCreateVulkanDefaultPipeline(VulkanSquirrelData &data) {
     }
   }
 
-  VkGraphicsPipelineCreateInfo pipelineInfo = {};
-  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  pipelineInfo.stageCount = 2;
-  pipelineInfo.pStages = shaderStages;
-
-  pipelineInfo.pVertexInputState = &vertexInputInfo;
-  pipelineInfo.pInputAssemblyState = &inputAssembly;
-  pipelineInfo.pViewportState = &viewportState;
-  pipelineInfo.pRasterizationState = &rasterizer;
-  pipelineInfo.pMultisampleState = &multisampling;
-  pipelineInfo.pDepthStencilState = nullptr; // Optional
-  pipelineInfo.pColorBlendState = &colorBlending;
-  pipelineInfo.pDynamicState = nullptr; // Optional
-
-  pipelineInfo.layout = data.defaultPipelineLayout;
-
-  pipelineInfo.renderPass = data.defaultRenderPass;
-  pipelineInfo.subpass = 0;
-
-  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
-  pipelineInfo.basePipelineIndex = -1; // Optional
-
   {
     VkResult result;
-    if ((result = vkCreateGraphicsPipelines(data.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &data.defaultGraphicsPipeline)) != VK_SUCCESS) {
+    if ((result = createVulkanGraphicsPipeline(data, data.vertShaderModule, data.fragShaderModule, data.defaultPipelineLayout, data.defaultGraphicsPipeline)) != VK_SUCCESS) {
 
       std::stringstream errorStringStream;
       errorStringStream << "Failed to create Vulkan graphics pipeline with vk error code: " << result;
@@ -818,6 +1371,75 @@ tsk::TaskResult taskCreateVulkanDefaultPipeline(VulkanSquirrelData &data) {
     }
   }
 
+  // gets the variants compiling right away, the first frames draw with the default pipeline until they're done
+  data.pipelineVariants.Init(data.device, data.pipelineCache, 1, data.allocationCallbacks);
+  resolveVulkanMaterialPipelines(data);
+
+  return tsk::kTaskSuccess;
+}
+
+tsk::TaskResult taskCreateVulkanIndirectScene(VulkanSquirrelData &data) {
+
+  if (data.options.stressSceneObjectCount == 0) return tsk::kTaskSuccess;
+
+  VkResult result = VK_SUCCESS;
+  const auto sceneFailure = [&](const char* what) -> tsk::TaskResult {
+    std::stringstream errorStringStream;
+    errorStringStream << "Failed to " << what << " for the indirect scene with vk error code: " << result;
+    return {
+      false,
+      kVKFailedToCreateIndirectScene,
+      errorStringStream.str()
+    };
+  };
+
+  AssetView cullShaderCode;
+  AssetView vertShaderCode;
+  if (!readAsset(data, "cull.comp.spv", data.looseCullShaderCode, cullShaderCode) ||
+    !readAsset(data, "scene.vert.spv", data.looseSceneVertShaderCode, vertShaderCode)) {
+    return sceneFailure("read the shaders");
+  }
+
+  if ((result = data.indirectScene.Init(
+    data.device,
+    data.memoryAllocator,
+    data.descriptorLayoutCache,
+    data.asyncCompute ? data.queueTopology.GetFamilies({ kGraphicsQueueRole, kComputeQueueRole, kTransferQueueRole }) : std::vector<uint32_t>(),
+    static_cast<uint32_t>(data.frames.size()),
+    data.options.stressSceneObjectCount,
+    data.allocationCallbacks)) != VK_SUCCESS) {
+    return sceneFailure("create the buffers");
+  }
+
+  if ((result = data.indirectScene.CreateCullPipeline(data.pipelineCache, static_cast<const uint32_t*>(cullShaderCode.data), cullShaderCode.size)) != VK_SUCCESS) {
+    return sceneFailure("create the cull pipeline");
+  }
+
+  if ((result = createVkShaderModule(data.device, static_cast<const uint32_t*>(vertShaderCode.data), vertShaderCode.size, data.allocationCallbacks, data.sceneVertShaderModule)) != VK_SUCCESS) {
+    return sceneFailure("create the vert shader module");
+  }
+
+  VkDescriptorSetLayout setLayouts[] = { data.frameDescriptorSetLayout, data.indirectScene.GetDescriptorSetLayout() };
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 2;
+  pipelineLayoutInfo.pSetLayouts = setLayouts;
+
+  if ((result = vkCreatePipelineLayout(data.device, &pipelineLayoutInfo, data.allocationCallbacks, &data.scenePipelineLayout)) != VK_SUCCESS) {
+    return sceneFailure("create the pipeline layout");
+  }
+
+  // shares the default fragment shader, it only passes the interpolated color through
+  if ((result = createVulkanGraphicsPipeline(data, data.sceneVertShaderModule, data.fragShaderModule, data.scenePipelineLayout, data.scenePipeline)) != VK_SUCCESS) {
+    return sceneFailure("create the graphics pipeline");
+  }
+
+  std::vector<IndirectSceneObject> objects = BuildStressScene(data.options.stressSceneObjectCount, 1);
+  if ((result = data.indirectScene.Upload(data.uploader, objects, data.indirectSceneTicket)) != VK_SUCCESS) {
+    return sceneFailure("upload the objects");
+  }
+
   return tsk::kTaskSuccess;
 }
 
@@ -840,7 +1462,7 @@ tsk::TaskResult taskCreateVulkanDefaultFramebuffers(VulkanSquirrelData &data) {
     framebufferInfo.layers = 1;
 
     VkResult result;
-    if ((result = vkCreateFramebuffer(data.device, &framebufferInfo, nullptr, &data.swapChainFramebuffers[i])) != VK_SUCCESS) {
+    if ((result = vkCreateFramebuffer(data.device, &framebufferInfo, data.allocationCallbacks, &data.swapChainFramebuffers[i])) != VK_SUCCESS) {
 
       std::stringstream errorStringStream;
       errorStringStream << "Failed to create Vulkan framebuffer with vk error code: " << result;
@@ -855,107 +1477,545 @@ tsk::TaskResult taskCreateVulkanDefaultFramebuffers(VulkanSquirrelData &data) {
   return tsk::kTaskSuccess;
 }
 
-tsk::TaskResult taskCreateVulkanCommandPool(VulkanSquirrelData &data) {
+tsk::TaskResult taskCreateVulkanCommandPools(VulkanSquirrelData &data) {
 
   VkCommandPoolCreateInfo poolInfo = {};
   poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
   poolInfo.queueFamilyIndex = data.mainQueueFamilyIndex;
-  poolInfo.flags = 0; // Optional
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // re-recorded every frame
+
+  const auto createCommandPool = [&](VkCommandPool &commandPool, tsk::TaskResult &taskResult) -> bool {
+
+    VkResult result;
+    if ((result = vkCreateCommandPool(data.device, &poolInfo, data.allocationCallbacks, &commandPool)) != VK_SUCCESS) {
+
+      std::stringstream errorStringStream;
+      errorStringStream << "Failed to create Vulkan command pool with vk error code: " << result;
+      taskResult = {
+        false,
+        kVKFailedToCreateDefaultVulkanCommandPool,
+        errorStringStream.str()
+      };
+
+      return false;
+    }
+
+    return true;
+  };
+
+  tsk::TaskResult taskResult;
+
+  for (auto &frame : data.frames) {
+    if (!createCommandPool(frame.commandPool, taskResult)) {
+      return taskResult;
+    }
+
+    frame.recordingCommandPools.resize(data.recordingWorkers.ThreadCount(), VK_NULL_HANDLE);
+    for (auto &recordingCommandPool : frame.recordingCommandPools) {
+      if (!createCommandPool(recordingCommandPool, taskResult)) {
+        return taskResult;
+      }
+    }
+  }
+
+  if (data.asyncCompute && data.options.stressSceneObjectCount > 0) {
+    poolInfo.queueFamilyIndex = data.computeQueueFamilyIndex;
+    for (auto &frame : data.frames) {
+      if (!createCommandPool(frame.computeCommandPool, taskResult)) {
+        return taskResult;
+      }
+    }
+  }
+
+  return tsk::kTaskSuccess;
+}
+
+tsk::TaskResult taskCreateVulkanCommandBuffers(VulkanSquirrelData &data) {
+
+  const auto allocateCommandBuffer = [&](VkCommandPool commandPool, VkCommandBufferLevel level, VkCommandBuffer &commandBuffer, tsk::TaskResult &taskResult) -> bool {
+
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPool;
+    allocInfo.level = level;
+    allocInfo.commandBufferCount = 1;
+
+    VkResult result;
+    if ((result = vkAllocateCommandBuffers(data.device, &allocInfo, &commandBuffer)) != VK_SUCCESS) {
+
+      std::stringstream errorStringStream;
+      errorStringStream << "Failed to create Vulkan command buffers with vk error code: " << result;
+      taskResult = {
+        false,
+        kVKFailedToCreateDefaultVulkanCommandBuffers,
+        errorStringStream.str()
+      };
+
+      return false;
+    }
+
+    return true;
+  };
+
+  tsk::TaskResult taskResult;
+
+  for (auto &frame : data.frames) {
+    if (!allocateCommandBuffer(frame.commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, frame.commandBuffer, taskResult)) {
+      return taskResult;
+    }
+
+    frame.recordingCommandBuffers.resize(frame.recordingCommandPools.size(), VK_NULL_HANDLE);
+    for (size_t i = 0; i < frame.recordingCommandPools.size(); i++) {
+      if (!allocateCommandBuffer(frame.recordingCommandPools[i], VK_COMMAND_BUFFER_LEVEL_SECONDARY, frame.recordingCommandBuffers[i], taskResult)) {
+        return taskResult;
+      }
+    }
+
+    if (data.options.stressSceneObjectCount > 0) {
+      if (!allocateCommandBuffer(frame.commandPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, frame.sceneCommandBuffer, taskResult)) {
+        return taskResult;
+      }
+    }
+
+    if (frame.computeCommandPool != VK_NULL_HANDLE) {
+      if (!allocateCommandBuffer(frame.computeCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, frame.computeCommandBuffer, taskResult)) {
+        return taskResult;
+      }
+    }
+  }
+
+  return tsk::kTaskSuccess;
+}
+
+// Begins a secondary command buffer continuing the default render pass, with pipeline, the frame uniforms,
+// viewport and scissor already set.
+VkResult beginVulkanDrawCommandBuffer(
+  VulkanSquirrelData &data,
+  VkCommandBuffer commandBuffer,
+  uint32_t imageIndex,
+  VkPipeline pipeline,
+  VkPipelineLayout pipelineLayout,
+  uint32_t frameUniformOffset) {
+
+  VkCommandBufferInheritanceInfo inheritanceInfo = {};
+  inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritanceInfo.renderPass = data.defaultRenderPass;
+  inheritanceInfo.subpass = 0;
+  inheritanceInfo.framebuffer = data.swapChainFramebuffers[imageIndex];
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+  VkResult result;
+  if ((result = vkBeginCommandBuffer(commandBuffer, &beginInfo)) != VK_SUCCESS) {
+    return result;
+  }
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &data.frameDescriptorSet, 1, &frameUniformOffset);
+
+  VkViewport viewport = {};
+  viewport.x = 0.0f;
+  viewport.y = 0.0f;
+  viewport.width = static_cast<float>(data.swapChainExtent.width);
+  viewport.height = static_cast<float>(data.swapChainExtent.height);
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+  VkRect2D scissor = {};
+  scissor.offset = { 0, 0 };
+  scissor.extent = data.swapChainExtent;
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+  return VK_SUCCESS;
+}
+
+VkResult recordVulkanDrawChunk(
+  VulkanSquirrelData &data,
+  VkCommandBuffer commandBuffer,
+  uint32_t imageIndex,
+  uint32_t frameUniformOffset,
+  uint32_t firstDraw,
+  uint32_t drawCount) {
+
+  VkResult result;
+  if ((result = beginVulkanDrawCommandBuffer(data, commandBuffer, imageIndex, data.defaultGraphicsPipeline, data.defaultPipelineLayout, frameUniformOffset)) != VK_SUCCESS) {
+    return result;
+  }
+
+  const DrawTransform* transforms = data.drawList.Transforms();
+  const uint32_t* materialIds = data.drawList.MaterialIds();
+  const uint32_t* visibleDraws = data.visibleDraws.data();
+
+  VkPipeline boundPipeline = data.defaultGraphicsPipeline;
+  VulkanDrawPushConstants pushConstants;
+  for (uint32_t visibleIndex = firstDraw; visibleIndex < firstDraw + drawCount; ++visibleIndex) {
+    uint32_t i = visibleDraws[visibleIndex];
+    uint32_t material = materialIds[i] % kMaterialTintCount;
+
+    // the variants share the default layout, so push constants and descriptor sets stay bound
+    if (data.materialPipelines[material] != boundPipeline) {
+      boundPipeline = data.materialPipelines[material];
+      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, boundPipeline);
+    }
+
+    pushConstants.transform = transforms[i];
+    memcpy(pushConstants.tint, kMaterialTints[material], sizeof(pushConstants.tint));
+
+    vkCmdPushConstants(commandBuffer, data.defaultPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pushConstants), &pushConstants);
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+  }
+
+  return vkEndCommandBuffer(commandBuffer);
+}
+
+// Fills visibleDraws with the draws whose triangle can end up on screen with the current view.
+void cullVulkanDrawList(VulkanSquirrelData &data) {
+
+  const uint32_t drawCount = data.drawList.Size();
+  const DrawTransform* transforms = data.drawList.Transforms();
+
+  data.drawListBounds.Clear();
+  data.drawListBounds.Reserve(drawCount);
+  for (uint32_t i = 0; i < drawCount; ++i) {
+    // the triangle's vertices lie within [-0.5, 0.5] before scaling
+    const DrawTransform &transform = transforms[i];
+    const float halfWidth = 0.5f * std::fabs(transform.scaleX);
+    const float halfHeight = 0.5f * std::fabs(transform.scaleY);
+
+    const float center[3] = { transform.offsetX, transform.offsetY, 0.0f };
+    const float boundsMin[3] = { center[0] - halfWidth, center[1] - halfHeight, 0.0f };
+    const float boundsMax[3] = { center[0] + halfWidth, center[1] + halfHeight, 0.0f };
+    data.drawListBounds.Add(center, std::sqrt(halfWidth * halfWidth + halfHeight * halfHeight), boundsMin, boundsMax);
+  }
+
+  data.visibleDraws.resize(drawCount);
+  const Frustum frustum = MakeViewFrustum(data.frameUniforms.view, 0.0f, 1.0f);
+  data.visibleDraws.resize(CullBoxes(frustum, data.drawListBounds, data.visibleDraws.data(), data.cullingPath));
+}
+
+VkResult recordVulkanIndirectSceneDraw(
+  VulkanSquirrelData &data,
+  VkCommandBuffer commandBuffer,
+  uint32_t imageIndex,
+  uint32_t frameUniformOffset) {
+
+  VkResult result;
+  if ((result = beginVulkanDrawCommandBuffer(data, commandBuffer, imageIndex, data.scenePipeline, data.scenePipelineLayout, frameUniformOffset)) != VK_SUCCESS) {
+    return result;
+  }
+
+  data.indirectScene.RecordDraw(commandBuffer, data.currentFrame, data.scenePipelineLayout);
+
+  return vkEndCommandBuffer(commandBuffer);
+}
+
+VkResult recordVulkanAsyncCulling(VulkanSquirrelData &data, VulkanFrameData &frame, const Frustum &frustum) {
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  VkResult result;
+  if ((result = vkBeginCommandBuffer(frame.computeCommandBuffer, &beginInfo)) != VK_SUCCESS) {
+    return result;
+  }
+
+  // The host saw the transfer queue's fence before IsComplete turned true, which made the copies available, but only
+  // the graphics submit waits on the upload's semaphore. Make them visible to this queue before the first culling
+  // pass, every later compute submit comes after this barrier in submission order.
+  if (!data.indirectSceneVisibleToCompute) {
+    VkMemoryBarrier objectsBarrier = {};
+    objectsBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    objectsBarrier.srcAccessMask = 0;
+    objectsBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(frame.computeCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &objectsBarrier, 0, nullptr, 0, nullptr);
+  }
+
+  data.indirectScene.RecordCulling(frame.computeCommandBuffer, data.currentFrame, frustum);
+
+  if ((result = vkEndCommandBuffer(frame.computeCommandBuffer)) != VK_SUCCESS) {
+    return result;
+  }
+
+  frame.computeRecorded = true;
+  return VK_SUCCESS;
+}
+
+VkResult recordVulkanCommandBuffer(VulkanSquirrelData &data, VulkanFrameData &frame, uint32_t imageIndex) {
+
+  // everything recorded from these pools last time this slot was used has finished executing
+  vkResetCommandPool(data.device, frame.commandPool, 0);
+  for (auto recordingCommandPool : frame.recordingCommandPools) {
+    vkResetCommandPool(data.device, recordingCommandPool, 0);
+  }
+  if (frame.computeCommandPool != VK_NULL_HANDLE) {
+    vkResetCommandPool(data.device, frame.computeCommandPool, 0);
+  }
+
+  // this slot's previous frame finished, so its part of the uniform ring can be overwritten
+  data.uniformAllocator.BeginFrame(data.currentFrame);
+  data.descriptorAllocator.BeginFrame(data.currentFrame);
+
+  uint32_t frameUniformOffset;
+  if (!data.uniformAllocator.Push(data.frameUniforms, frameUniformOffset)) {
+    return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+  }
+
+  if (data.drawListCulled) {
+    data.visibleDraws.resize(data.drawList.Size());
+    for (uint32_t i = 0; i < data.drawList.Size(); ++i) {
+      data.visibleDraws[i] = i;
+    }
+  }
+  else {
+    cullVulkanDrawList(data);
+  }
+
+  resolveVulkanMaterialPipelines(data);
+
+  // split the visible draws into contiguous chunks, each recorded into its own secondary command buffer
+  uint32_t drawCount = static_cast<uint32_t>(data.visibleDraws.size());
+  uint32_t chunkCount = std::min(
+    static_cast<uint32_t>(frame.recordingCommandBuffers.size()),
+    (drawCount + kMinDrawsPerRecordingChunk - 1) / kMinDrawsPerRecordingChunk);
+  uint32_t drawsPerChunk = chunkCount > 0 ? (drawCount + chunkCount - 1) / chunkCount : 0;
+
+  std::vector<VkResult> chunkResults(chunkCount, VK_SUCCESS);
+  data.recordingWorkers.ParallelFor(chunkCount, [&](uint32_t chunk, uint32_t) {
+    uint32_t firstDraw = chunk * drawsPerChunk;
+    uint32_t chunkDrawCount = std::min(drawsPerChunk, drawCount - firstDraw);
+    chunkResults[chunk] = recordVulkanDrawChunk(data, frame.recordingCommandBuffers[chunk], imageIndex, frameUniformOffset, firstDraw, chunkDrawCount);
+  });
+
+  for (VkResult chunkResult : chunkResults) {
+    if (chunkResult != VK_SUCCESS) {
+      return chunkResult;
+    }
+  }
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  beginInfo.pInheritanceInfo = nullptr; // Optional
+
+  VkResult result;
+  if ((result = vkBeginCommandBuffer(frame.commandBuffer, &beginInfo)) != VK_SUCCESS) {
+    return result;
+  }
+
+  data.frameProfiler.WriteGpuFrameBegin(frame.commandBuffer);
+
+  // takes ownership of whatever the transfer queue finished uploading before anything can read it
+  data.uploader.RecordPendingAcquires(frame.commandBuffer, data.frameNumber, frame.waitSemaphores, frame.waitStages);
+
+  // only once the scene's objects arrived, which the acquires above just made visible
+  bool drawIndirectScene = data.indirectScene.GetObjectCount() > 0 && data.uploader.IsComplete(data.indirectSceneTicket);
+  frame.computeRecorded = false;
+  if (drawIndirectScene) {
+    if ((result = data.indirectScene.BeginFrame(data.currentFrame, data.descriptorAllocator)) != VK_SUCCESS) {
+      return result;
+    }
+
+    if (frame.computeCommandBuffer != VK_NULL_HANDLE) {
+      // IsComplete means the host saw their transfer finish, recordVulkanAsyncCulling makes them visible to compute
+      if ((result = recordVulkanAsyncCulling(data, frame, MakeViewFrustum(data.frameUniforms.view, 0.0f, 1.0f))) != VK_SUCCESS) {
+        return result;
+      }
+      frame.waitSemaphores.push_back(frame.cullFinishedSemaphore);
+      frame.waitStages.push_back(VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+    }
+
+    if ((result = recordVulkanIndirectSceneDraw(data, frame.sceneCommandBuffer, imageIndex, frameUniformOffset)) != VK_SUCCESS) {
+      return result;
+    }
+  }
+
+  data.graphFrame.frame = &frame;
+  data.graphFrame.imageIndex = imageIndex;
+  data.graphFrame.chunkCount = chunkCount;
+  data.graphFrame.drawIndirectScene = drawIndirectScene;
+
+  data.renderGraph.SetImportedImage(data.backbufferResource, data.swapChainImages[imageIndex]);
+  if (data.indirectScene.GetObjectCount() > 0) {
+    data.renderGraph.SetImportedBuffer(data.sceneDrawResource, data.indirectScene.GetDrawBuffer(data.currentFrame));
+    data.renderGraph.SetImportedBuffer(data.sceneVisibleResource, data.indirectScene.GetVisibleBuffer(data.currentFrame));
+  }
+  data.renderGraph.Execute(frame.commandBuffer);
+
+  data.frameProfiler.WriteGpuFrameEnd(frame.commandBuffer);
+
+  return vkEndCommandBuffer(frame.commandBuffer);
+}
+
+void recordVulkanSceneCullingPass(VulkanSquirrelData &data, VkCommandBuffer commandBuffer) {
+
+  if (!data.graphFrame.drawIndirectScene) return;
+
+  data.indirectScene.RecordCulling(commandBuffer, data.currentFrame, MakeViewFrustum(data.frameUniforms.view, 0.0f, 1.0f));
+}
+
+void recordVulkanMainPass(VulkanSquirrelData &data, VkCommandBuffer commandBuffer) {
+
+  VulkanFrameData &frame = *data.graphFrame.frame;
+
+  VkRenderPassBeginInfo renderPassInfo = {};
+
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  renderPassInfo.renderPass = data.defaultRenderPass;
+  renderPassInfo.framebuffer = data.swapChainFramebuffers[data.graphFrame.imageIndex];
+  renderPassInfo.renderArea.offset = { 0, 0 };
+  renderPassInfo.renderArea.extent = data.swapChainExtent;
+
+  VkClearValue clearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
+  renderPassInfo.clearValueCount = 1;
+  renderPassInfo.pClearValues = &clearColor;
+
+  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+  // the scene is the background, the draw list goes on top
+  if (data.graphFrame.drawIndirectScene) {
+    vkCmdExecuteCommands(commandBuffer, 1, &frame.sceneCommandBuffer);
+  }
+  if (data.graphFrame.chunkCount > 0) {
+    vkCmdExecuteCommands(commandBuffer, data.graphFrame.chunkCount, frame.recordingCommandBuffers.data());
+  }
+  vkCmdEndRenderPass(commandBuffer);
+}
+
+// Declares the frame's passes once, recordVulkanCommandBuffer rebinds the imported resources every frame.
+tsk::TaskResult taskCreateVulkanRenderGraph(VulkanSquirrelData &data) {
+
+  // the acquire semaphore is waited on at the color attachment output stage, the transition out of undefined chains onto it
+  VulkanGraphImageHandoff presentHandoff;
+  if (isHeadless(data)) {
+    // headless frames are never presented, leave them ready to be copied out instead
+    presentHandoff.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    presentHandoff.stageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    presentHandoff.accessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  }
+  else {
+    presentHandoff.layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    presentHandoff.stageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    presentHandoff.accessMask = 0;
+  }
+  data.backbufferResource = data.renderGraph.ImportImage(
+    "backbuffer",
+    VK_IMAGE_ASPECT_COLOR_BIT,
+    VK_IMAGE_LAYOUT_UNDEFINED,
+    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+    presentHandoff);
+
+  const bool indirectScene = data.indirectScene.GetObjectCount() > 0;
+  if (indirectScene) {
+    data.sceneDrawResource = data.renderGraph.ImportBuffer("scene draw commands");
+    data.sceneVisibleResource = data.renderGraph.ImportBuffer("scene visible ids");
+  }
+
+  // with async compute the culling runs on the compute queue, ordered by the semaphore instead
+  if (indirectScene && !data.asyncCompute) {
+    VulkanGraphPass cullPass = data.renderGraph.AddPass("scene culling", [&data](VkCommandBuffer commandBuffer) {
+      recordVulkanSceneCullingPass(data, commandBuffer);
+    });
+    // the draw command gets reset with a buffer update before the dispatch
+    data.renderGraph.Write(cullPass, data.sceneDrawResource, kTransferWriteAccess);
+    data.renderGraph.Write(cullPass, data.sceneDrawResource, kComputeStorageWriteAccess);
+    data.renderGraph.Write(cullPass, data.sceneVisibleResource, kComputeStorageWriteAccess);
+  }
+
+  VulkanGraphPass mainPass = data.renderGraph.AddPass("main", [&data](VkCommandBuffer commandBuffer) {
+    recordVulkanMainPass(data, commandBuffer);
+  });
+  data.renderGraph.Write(mainPass, data.backbufferResource, kColorAttachmentWriteAccess);
+  if (indirectScene) {
+    data.renderGraph.Read(mainPass, data.sceneDrawResource, kIndirectCommandReadAccess);
+    data.renderGraph.Read(mainPass, data.sceneVisibleResource, kVertexStorageReadAccess);
+  }
 
   VkResult result;
-  if ((result = vkCreateCommandPool(data.device, &poolInfo, nullptr, &data.commandPool)) != VK_SUCCESS) {
+  if ((result = data.renderGraph.Compile(data.device, data.memoryAllocator, data.allocationCallbacks)) != VK_SUCCESS) {
 
     std::stringstream errorStringStream;
-    errorStringStream << "Failed to create Vulkan command pool with vk error code: " << result;
+    errorStringStream << "Failed to compile the render graph with vk error code: " << result;
     return {
       false,
-      kVKFailedToCreateDefaultVulkanCommandPool,
+      kVKFailedToCreateRenderGraph,
       errorStringStream.str()
     };
   }
 
+  logVulkanReport(data, [&](std::ostream &out) { data.renderGraph.Print(out); });
+
   return tsk::kTaskSuccess;
 }
 
+tsk::TaskResult taskCreateVulkanFrameProfiler(VulkanSquirrelData &data) {
 
-tsk::TaskResult taskCreateVulkanCommandBuffers(VulkanSquirrelData &data) {
-
-  data.commandBuffers.resize(data.swapChainFramebuffers.size());
-
-  VkCommandBufferAllocateInfo allocInfo = {};
-  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.commandPool = data.commandPool;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandBufferCount = (uint32_t)data.commandBuffers.size();
+  if (!data.options.frameProfiling) return tsk::kTaskSuccess;
 
   VkResult result;
-  if ((result = vkAllocateCommandBuffers(data.device, &allocInfo, data.commandBuffers.data())) != VK_SUCCESS) {
+  if ((result = data.frameProfiler.Init(
+    data.physicalDevice,
+    data.device,
+    data.mainQueueFamilyIndex,
+    static_cast<uint32_t>(data.frames.size()),
+    data.options.frameProfilerHistory,
+    !data.options.frameProfilerTracePath.empty(),
+    data.allocationCallbacks)) != VK_SUCCESS) {
 
     std::stringstream errorStringStream;
-    errorStringStream << "Failed to create Vulkan command buffers with vk error code: " << result;
+    errorStringStream << "Failed to create Vulkan timestamp query pool with vk error code: " << result;
     return {
       false,
-      kVKFailedToCreateDefaultVulkanCommandBuffers,
+      kVKFailedToCreateTimestampQueryPool,
       errorStringStream.str()
     };
   }
 
-  for (size_t i = 0; i < data.commandBuffers.size(); i++) {
-    VkCommandBufferBeginInfo beginInfo = {};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-    beginInfo.pInheritanceInfo = nullptr; // Optional
-
-    vkBeginCommandBuffer(data.commandBuffers[i], &beginInfo);
+  return tsk::kTaskSuccess;
+}
 
-    VkRenderPassBeginInfo renderPassInfo = {};
+tsk::TaskResult taskCreateVulkanSyncObjects(VulkanSquirrelData &data) {
 
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = data.defaultRenderPass;
-    renderPassInfo.framebuffer = data.swapChainFramebuffers[i];
-    renderPassInfo.renderArea.offset = { 0, 0 };
-    renderPassInfo.renderArea.extent = data.swapChainExtent;
+  VkSemaphoreCreateInfo semaphoreInfo = {};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VkClearValue clearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColor;
+  // created signaled so the first wait on each frame slot doesn't block
+  VkFenceCreateInfo fenceInfo = {};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    vkCmdBeginRenderPass(data.commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(data.commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, data.defaultGraphicsPipeline);
-    vkCmdDraw(data.commandBuffers[i], 3, 1, 0, 0);
-    vkCmdEndRenderPass(data.commandBuffers[i]);
+  const auto createSemaphore = [&](VkSemaphore &semaphore, tsk::TaskResult &taskResult) -> bool {
 
     VkResult result;
-    if ((result = vkEndCommandBuffer(data.commandBuffers[i])) != VK_SUCCESS) {
+    if ((result = vkCreateSemaphore(data.device, &semaphoreInfo, data.allocationCallbacks, &semaphore)) != VK_SUCCESS) {
 
       std::stringstream errorStringStream;
-      errorStringStream << "Failed to create Vulkan command buffer with vk error code: " << result;
-      return {
+      errorStringStream << "Failed to create Vulkan semaphore with vk error code: " << result;
+      taskResult = {
         false,
-        kVKFailedToCreateDefaultVulkanCommandBuffer,
+        kVKFailedToCreateDefaultVulkanSemaphore,
         errorStringStream.str()
       };
-    }
-  }
-
-  return tsk::kTaskSuccess;
-}
 
-tsk::TaskResult taskCreateVulkanSemaphores(VulkanSquirrelData &data) {
+      return false;
+    }
 
-  VkSemaphoreCreateInfo semaphoreInfo = {};
-  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    return true;
+  };
 
-  const auto createSemaphore = [&](VkSemaphore &semaphore, tsk::TaskResult &taskResult) -> bool {
+  const auto createFence = [&](VkFence &fence, tsk::TaskResult &taskResult) -> bool {
 
     VkResult result;
-    if ((result = vkCreateSemaphore(data.device, &semaphoreInfo, nullptr, &semaphore)) != VK_SUCCESS) {
+    if ((result = vkCreateFence(data.device, &fenceInfo, data.allocationCallbacks, &fence)) != VK_SUCCESS) {
 
       std::stringstream errorStringStream;
-      errorStringStream << "Failed to create Vulkan semaphore with vk error code: " << result;
+      errorStringStream << "Failed to create Vulkan fence with vk error code: " << result;
       taskResult = {
         false,
-        kVKFailedToCreateDefaultVulkanSemaphore,
+        kVKFailedToCreateDefaultVulkanFence,
         errorStringStream.str()
       };
 
@@ -967,193 +2027,713 @@ tsk::TaskResult taskCreateVulkanSemaphores(VulkanSquirrelData &data) {
 
   tsk::TaskResult taskResult;
 
-  if (!createSemaphore(data.imageAvailableSemaphore, taskResult)) {
-    return taskResult;
-  }
+  for (auto &frame : data.frames) {
+    if (!createSemaphore(frame.imageAvailableSemaphore, taskResult)) {
+      return taskResult;
+    }
 
-  if (!createSemaphore(data.renderFinishedSemaphore, taskResult)) {
-    return taskResult;
+    if (!createFence(frame.inFlightFence, taskResult)) {
+      return taskResult;
+    }
+
+    if (data.asyncCompute && data.options.stressSceneObjectCount > 0) {
+      if (!createSemaphore(frame.cullFinishedSemaphore, taskResult)) {
+        return taskResult;
+      }
+    }
   }
 
   return tsk::kTaskSuccess;
 }
 
+void destroyVulkanRetiredSwapChain(VulkanSquirrelData &data, VulkanRetiredSwapChain &retired) {
+  for (auto framebuffer : retired.framebuffers) {
+    vkDestroyFramebuffer(data.device, framebuffer, data.allocationCallbacks);
+  }
+
+  for (auto imageView : retired.imageViews) {
+    vkDestroyImageView(data.device, imageView, data.allocationCallbacks);
+  }
+
+  for (auto semaphore : retired.renderFinishedSemaphores) {
+    vkDestroySemaphore(data.device, semaphore, data.allocationCallbacks);
+  }
+
+  vkDestroySwapchainKHR(data.device, retired.swapChain, data.allocationCallbacks);
+}
+
+// destroys retired swap chains that no frame in flight can reference anymore, called after the frame fence wait
+void destroyVulkanRetiredSwapChains(VulkanSquirrelData &data) {
+  auto it = data.retiredSwapChains.begin();
+  while (it != data.retiredSwapChains.end()) {
+    if (data.frameNumber >= it->retiredFrameNumber + data.frames.size()) {
+      destroyVulkanRetiredSwapChain(data, *it);
+      it = data.retiredSwapChains.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+}
+
+// Rebuilds only what depends on the surface size: swap chain, image views and framebuffers.
+// The old objects are retired instead of waiting for the device to go idle, and command buffers
+// are recorded every frame anyway.
+bool recreateVulkanSwapChain(VulkanSquirrelData &data, uint32_t width, uint32_t height) {
+
+  vkGetPhysicalDeviceSurfaceCapabilitiesKHR(data.physicalDevice, data.surface, &data.surfaceCapabilities);
+
+  data.retiredSwapChains.push_back({
+    data.swapChain,
+    std::move(data.swapChainImageViews),
+    std::move(data.swapChainFramebuffers),
+    std::move(data.renderFinishedSemaphores),
+    data.frameNumber
+  });
+  data.swapChainImageViews.clear();
+  data.swapChainFramebuffers.clear();
+  data.renderFinishedSemaphores.clear();
+
+  VkResult result;
+  if ((result = createVulkanSwapChain(data, width, height, data.retiredSwapChains.back().swapChain)) != VK_SUCCESS) {
+    data.logger.Write(kErrorLogSeverity) << "Failed to recreate Vulkan swap chain with vk error code: " << result;
+    data.swapChain = VK_NULL_HANDLE;
+    return false;
+  }
+
+  tsk::TaskResult taskResult = taskCreateVulkanSwapChainImageViews(data);
+  if (taskResult.success) {
+    taskResult = taskCreateVulkanDefaultFramebuffers(data);
+  }
+
+  if (!taskResult.success) {
+    data.logger.Write(kErrorLogSeverity) << "Failed to recreate Vulkan swap chain resources: " << taskResult.errorMessage;
+    return false;
+  }
+
+  data.swapChainNeedsRecreation = false;
+  return true;
+}
+
+void recordVulkanFrameTime(VulkanFrameTimeStats &stats, double frameMilliseconds) {
+  stats.frameCount++;
+  stats.totalMilliseconds += frameMilliseconds;
+  stats.minMilliseconds = std::min(stats.minMilliseconds, frameMilliseconds);
+  stats.maxMilliseconds = std::max(stats.maxMilliseconds, frameMilliseconds);
+}
+
+// The only point where the CPU waits on the GPU, and only for the frame that used this slot framesInFlight frames ago.
+// Called before input is sampled, so that the input doesn't go stale while waiting.
+void waitForVulkanFrameSlot(VulkanSquirrelData &data) {
+
+  VulkanFrameData &frame = data.frames[data.currentFrame];
+  FrameProfiler &profiler = data.frameProfiler;
+
+  profiler.BeginFrame(data.currentFrame);
+
+  profiler.BeginCpuScope(kFenceWaitCpuScope);
+  vkWaitForFences(data.device, 1, &frame.inFlightFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+  profiler.EndCpuScope(kFenceWaitCpuScope);
+
+  profiler.ResolveGpuScopes();
+}
+
+// has to follow waitForVulkanFrameSlot, submitted is false when the frame was skipped, e.g. while minimized
+bool drawVulkanFrame(VulkanSquirrelData &data, bool &submitted) {
+
+  submitted = false;
+
+  if (data.swapChainNeedsRecreation && !isHeadless(data)) {
+
+    int width = 0;
+    int height = 0;
+    glfwGetFramebufferSize(data.window, &width, &height);
+
+    // minimized, there is nothing to present to until the window comes back
+    if (width == 0 || height == 0) {
+      glfwWaitEvents();
+      return true;
+    }
+
+    if (!recreateVulkanSwapChain(data, static_cast<uint32_t>(width), static_cast<uint32_t>(height))) {
+      return false;
+    }
+  }
+
+  VulkanFrameData &frame = data.frames[data.currentFrame];
+  FrameProfiler &profiler = data.frameProfiler;
+
+  destroyVulkanRetiredSwapChains(data);
+
+  // every frame up to the one that last used this slot has finished
+  uint64_t completedFrameCount = data.frameNumber >= data.frames.size() ? data.frameNumber - data.frames.size() + 1 : 0;
+  data.uploader.Update(completedFrameCount);
+
+  VkResult result;
+  VulkanUploadTicket uploadTicket;
+  if ((result = data.uploader.Flush(uploadTicket)) != VK_SUCCESS) {
+    data.logger.Write(kErrorLogSeverity) << "Failed to submit Vulkan uploads with vk error code: " << result;
+    return false;
+  }
+
+  uint32_t imageIndex = data.currentFrame;
+  if (!isHeadless(data)) {
+    profiler.BeginCpuScope(kAcquireCpuScope);
+    result = vkAcquireNextImageKHR(data.device, data.swapChain, std::numeric_limits<uint64_t>::max(), frame.imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+    profiler.EndCpuScope(kAcquireCpuScope);
+
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+      // nothing was acquired and the fence is still signaled, so this frame slot can simply be retried
+      data.swapChainNeedsRecreation = true;
+      return true;
+    }
+    else if (result == VK_SUBOPTIMAL_KHR) {
+      // still presentable, finish this frame and recreate before the next one
+      data.swapChainNeedsRecreation = true;
+    }
+    else if (result != VK_SUCCESS) {
+      data.logger.Write(kErrorLogSeverity) << "Failed to acquire Vulkan swap chain image with vk error code: " << result;
+      return false;
+    }
+  }
+
+  // headless images are only reused after the frame fence signals, so there is no acquire to wait on
+  frame.waitSemaphores.clear();
+  frame.waitStages.clear();
+  if (!isHeadless(data)) {
+    frame.waitSemaphores.push_back(frame.imageAvailableSemaphore);
+    frame.waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+  }
+
+  profiler.BeginCpuScope(kRecordCpuScope);
+  if ((result = recordVulkanCommandBuffer(data, frame, imageIndex)) != VK_SUCCESS) {
+
+    data.logger.Write(kErrorLogSeverity) << "Failed to record Vulkan command buffer with vk error code: " << result;
+    return false;
+  }
+  profiler.EndCpuScope(kRecordCpuScope);
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+  submitInfo.waitSemaphoreCount = static_cast<uint32_t>(frame.waitSemaphores.size());
+  submitInfo.pWaitSemaphores = frame.waitSemaphores.data();
+  submitInfo.pWaitDstStageMask = frame.waitStages.data();
+
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &frame.commandBuffer;
+
+  VkSemaphore signalSemaphores[] = { isHeadless(data) ? VK_NULL_HANDLE : data.renderFinishedSemaphores[imageIndex] };
+  submitInfo.signalSemaphoreCount = isHeadless(data) ? 0 : 1;
+  submitInfo.pSignalSemaphores = signalSemaphores;
+
+  vkResetFences(data.device, 1, &frame.inFlightFence);
+
+  profiler.BeginCpuScope(kSubmitCpuScope);
+  // has to be submitted first, the graphics submit below waits on its semaphore
+  if (frame.computeRecorded) {
+    VkSubmitInfo computeSubmitInfo = {};
+    computeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    computeSubmitInfo.commandBufferCount = 1;
+    computeSubmitInfo.pCommandBuffers = &frame.computeCommandBuffer;
+    computeSubmitInfo.signalSemaphoreCount = 1;
+    computeSubmitInfo.pSignalSemaphores = &frame.cullFinishedSemaphore;
+
+    if ((result = vkQueueSubmit(data.computeQueue, 1, &computeSubmitInfo, VK_NULL_HANDLE)) != VK_SUCCESS) {
+
+      data.logger.Write(kErrorLogSeverity) << "Failed to submit to Vulkan compute queue with vk error code: " << result;
+      return false;
+    }
+    data.indirectSceneVisibleToCompute = true;
+  }
+
+  if ((result = vkQueueSubmit(data.mainQueue, 1, &submitInfo, frame.inFlightFence)) != VK_SUCCESS) {
+
+    data.logger.Write(kErrorLogSeverity) << "Failed to submit to Vulkan queue with vk error code: " << result;
+    return false;
+  }
+  profiler.EndCpuScope(kSubmitCpuScope);
+
+  data.frameNumber++;
+  submitted = true;
+
+  if (isHeadless(data)) {
+    if (data.options.frameSubmissionMode == kSerializedFrameSubmission) {
+      vkQueueWaitIdle(data.mainQueue);
+    }
+
+    data.currentFrame = (data.currentFrame + 1) % data.frames.size();
+    return true;
+  }
+
+  VkPresentInfoKHR presentInfo = {};
+  presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+
+  presentInfo.waitSemaphoreCount = 1;
+  presentInfo.pWaitSemaphores = signalSemaphores;
+
+  VkSwapchainKHR swapChains[] = { data.swapChain };
+  presentInfo.swapchainCount = 1;
+  presentInfo.pSwapchains = swapChains;
+  presentInfo.pImageIndices = &imageIndex;
+
+  presentInfo.pResults = nullptr; // Optional
+
+  profiler.BeginCpuScope(kPresentCpuScope);
+  result = vkQueuePresentKHR(data.presentQueue, &presentInfo);
+  profiler.EndCpuScope(kPresentCpuScope);
+
+  recordVulkanFrameTime(data.inputLatencyStats, std::chrono::duration<double, std::milli>(
+    std::chrono::high_resolution_clock::now() - data.inputSampleTime).count());
+  if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+    data.swapChainNeedsRecreation = true;
+  }
+  else if (result != VK_SUCCESS) {
+    data.logger.Write(kErrorLogSeverity) << "Failed to present Vulkan swap chain image with vk error code: " << result;
+    return false;
+  }
+
+  if (data.options.frameSubmissionMode == kSerializedFrameSubmission) {
+    vkQueueWaitIdle(data.mainQueue);
+  }
+
+  data.currentFrame = (data.currentFrame + 1) % data.frames.size();
+
+  return true;
+}
+
+void printVulkanFrameTimeStats(const VulkanSquirrelData &data, std::ostream &out) {
+  const VulkanFrameTimeStats &stats = data.frameTimeStats;
+  if (stats.frameCount == 0) {
+    return;
+  }
+
+  out << "Frame time over " << stats.frameCount << " frames ";
+  if (data.options.frameSubmissionMode == kSerializedFrameSubmission) {
+    out << "(serialized)";
+  }
+  else {
+    out << "(" << data.frames.size() << " frames in flight)";
+  }
+
+  out
+    << ": avg " << stats.totalMilliseconds / stats.frameCount
+    << " ms, min " << stats.minMilliseconds
+    << " ms, max " << stats.maxMilliseconds << " ms" << std::endl;
+
+  const VulkanFrameTimeStats &latency = data.inputLatencyStats;
+  if (latency.frameCount > 0) {
+    out
+      << "Input to present latency (" << getVulkanPresentModeName(data.presentMode) << ")"
+      << ": avg " << latency.totalMilliseconds / latency.frameCount
+      << " ms, min " << latency.minMilliseconds
+      << " ms, max " << latency.maxMilliseconds << " ms" << std::endl;
+  }
+}
+
 void VulkanSquirrel::Run(const VulkanSquirrelOptions &options) {
 
   VulkanSquirrelData data;
 
   data.options = options;
 
-  tsk::TaskSequenceResult result = tsk::ExecuteTaskSequence<VulkanSquirrelData>(
+  data.logger.Start(std::cout, std::cerr);
+  data.logger.SetMinSeverity(options.logSeverity);
+  data.logger.SetRepeatLimit(options.logRepeatLimit);
+
+  if (options.hostAllocationTracking) {
+    data.hostAllocator.Init();
+    data.allocationCallbacks = data.hostAllocator.GetCallbacks();
+  }
+  else {
+    data.allocationCallbacks = options.hostAllocationCallbacks;
+  }
+
+  data.frames.resize(getVulkanFrameCount(options));
+  data.recordingWorkers.Start(options.recordingThreadCount);
+  data.cullingPath = GetFastestCullingPath();
+
+  // the default triangle, until something fills the draw list
+  data.drawList.Add({ 0.0f, 0.0f, 1.0f, 1.0f }, 0);
+
+  PopulateMovingScene(data.scene, options.sceneEntityCount, kSceneWorldExtent, 1);
+
+  // indices into the task graph below, used to declare dependencies
+  enum {
+    kInitGLFWWindow,
+    kProbeVulkanInstanceCapabilities,
+    kCheckVulkanExtensions,
+    kInitVulkanInstance,
+    kInitVulkanDebug,
+    kCreateVulkanSurface,
+    kPickVulkanPhysicalDevice,
+    kCreateVulkanLogicalDevice,
+    kCreateVulkanMemoryAllocator,
+    kCreateVulkanUploader,
+    kCreateVulkanDescriptorAllocator,
+    kCreateVulkanFrameUniforms,
+    kCreateVulkanPipelineCache,
+    kCheckVulkanSurfaceCapabilities,
+    kCreateVulkanSwapChain,
+    kCreateVulkanOffscreenImages,
+    kCreateVulkanSwapChainImageViews,
+    kCreateVulkanDefaultRenderPass,
+    kOpenAssetPack,
+    kReadVulkanDefaultShaders,
+    kCreateVulkanDefaultPipeline,
+    kCreateVulkanIndirectScene,
+    kCreateVulkanDefaultFramebuffers,
+    kCreateVulkanCommandPools,
+    kCreateVulkanCommandBuffers,
+    kCreateVulkanSyncObjects,
+    kCreateVulkanFrameProfiler,
+    kCreateVulkanRenderGraph,
+  };
+
+  tsk::TaskSequenceResult result = tsk::ExecuteTaskGraph<VulkanSquirrelData>(
     data,
     "Initialize GLFW and Vulkan",
     {
       {
         "Initialize GLFW Window",
-        taskInitGLFWWindow
+        taskInitGLFWWindow,
+        {},
+        true // GLFW window creation is only allowed on the main thread
+      }, {
+        // the loader doesn't need GLFW, so probing overlaps window creation
+        "Probe Vulkan Instance Capabilities",
+        taskProbeVulkanInstanceCapabilities
       }, {
         "Check Vulkan Extensions",
-        taskCheckVulkanExtensions
+        taskCheckVulkanExtensions,
+        { kInitGLFWWindow, kProbeVulkanInstanceCapabilities }
       }, {
         "Initialize Vulkan Instance",
-        taskInitVulkanInstance
+        taskInitVulkanInstance,
+        { kCheckVulkanExtensions }
       }, {
         "Initialize Vulkan Debug",
-        taskInitVulkanDebug
+        taskInitVulkanDebug,
+        { kInitVulkanInstance }
       }, {
         "Create Vulkan Surface",
-        taskCreateVulkanSurface
+        taskCreateVulkanSurface,
+        { kInitGLFWWindow, kInitVulkanInstance }
       },{
         "Pick Vulkan Physical Device",
-        taskPickVulkanPhysicalDevice
+        taskPickVulkanPhysicalDevice,
+        { kCreateVulkanSurface }
       }, {
         "Create Vulkan Logical Device",
-        taskCreateVulkanLogicalDevice
+        taskCreateVulkanLogicalDevice,
+        { kPickVulkanPhysicalDevice }
+      }, {
+        "Create Vulkan Memory Allocator",
+        taskCreateVulkanMemoryAllocator,
+        { kCreateVulkanLogicalDevice }
+      }, {
+        "Create Vulkan Uploader",
+        taskCreateVulkanUploader,
+        { kCreateVulkanMemoryAllocator }
+      }, {
+        "Create Vulkan Descriptor Allocator",
+        taskCreateVulkanDescriptorAllocator,
+        { kCreateVulkanLogicalDevice }
+      }, {
+        "Create Vulkan Frame Uniforms",
+        taskCreateVulkanFrameUniforms,
+        { kCreateVulkanMemoryAllocator, kCreateVulkanDescriptorAllocator }
+      }, {
+        "Create Vulkan Pipeline Cache",
+        taskCreateVulkanPipelineCache,
+        { kCreateVulkanLogicalDevice }
       }, {
         "Checking Vulkan Swap Chain Capabilities",
-        taskCheckVulkanSurfaceCapabilities
+        taskCheckVulkanSurfaceCapabilities,
+        { kPickVulkanPhysicalDevice }
       }, {
         "Create Vulkan Swap Chain",
-        taskCreateVulkanSwapChain
+        taskCreateVulkanSwapChain,
+        { kCreateVulkanLogicalDevice, kCheckVulkanSurfaceCapabilities }
+      }, {
+        "Create Vulkan Offscreen Images",
+        taskCreateVulkanOffscreenImages,
+        { kCreateVulkanMemoryAllocator }
       }, {
         "Create Vulkan Swap Chain Image Views",
-        taskCreateVulkanSwapChainImageViews
+        taskCreateVulkanSwapChainImageViews,
+        { kCreateVulkanSwapChain, kCreateVulkanOffscreenImages }
       }, {
         "Create Vulkan Render Pass",
-        taskCreateVulkanDefaultRenderPass
+        taskCreateVulkanDefaultRenderPass,
+        { kCreateVulkanSwapChain, kCreateVulkanOffscreenImages }
+      }, {
+        "Open Asset Pack",
+        taskOpenAssetPack
+      }, {
+        "Read Vulkan Default Shaders",
+        taskReadVulkanDefaultShaders,
+        { kOpenAssetPack }
       }, {
         "Create Vulkan Default Pipeline",
-        taskCreateVulkanDefaultPipeline
+        taskCreateVulkanDefaultPipeline,
+        { kCreateVulkanDefaultRenderPass, kReadVulkanDefaultShaders, kCreateVulkanPipelineCache, kCreateVulkanFrameUniforms }
+      }, {
+        "Create Vulkan Indirect Scene",
+        taskCreateVulkanIndirectScene,
+        { kCreateVulkanDefaultPipeline, kCreateVulkanUploader, kCreateVulkanDescriptorAllocator }
       }, {
         "Create Vulkan Default Framebuffers",
-        taskCreateVulkanDefaultFramebuffers
+        taskCreateVulkanDefaultFramebuffers,
+        { kCreateVulkanSwapChainImageViews, kCreateVulkanDefaultRenderPass }
       }, {
-        "Create Vulkan command pool",
-        taskCreateVulkanCommandPool
+        "Create Vulkan command pools",
+        taskCreateVulkanCommandPools,
+        { kCreateVulkanLogicalDevice }
       }, {
         "Create Vulkan command buffers",
-        taskCreateVulkanCommandBuffers
+        taskCreateVulkanCommandBuffers,
+        { kCreateVulkanCommandPools }
+      }, {
+        "Create Vulkan sync objects",
+        taskCreateVulkanSyncObjects,
+        { kCreateVulkanLogicalDevice }
       }, {
-        "Create Vulkan semaphores",
-        taskCreateVulkanSemaphores
+        "Create Vulkan frame profiler",
+        taskCreateVulkanFrameProfiler,
+        { kCreateVulkanLogicalDevice }
+      }, {
+        "Create Vulkan Render Graph",
+        taskCreateVulkanRenderGraph,
+        { kCreateVulkanIndirectScene, kCreateVulkanDefaultRenderPass, kCreateVulkanMemoryAllocator }
       }
-    }
+    },
+    std::thread::hardware_concurrency(),
+    [&](bool isError, const std::string &message) { data.logger.Log(isError ? kErrorLogSeverity : kInfoLogSeverity, message); }
   );
 
-  // THE LOOP!
-  while (!glfwWindowShouldClose(data.window)) {
-    glfwPollEvents();
-
-    uint32_t imageIndex;
-    vkAcquireNextImageKHR(data.device, data.swapChain, std::numeric_limits<uint64_t>::max(), data.imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+  logVulkanReport(data, [&](std::ostream &out) { tsk::PrintTaskTimingReport(result, "Initialize GLFW and Vulkan", out); });
+  if (!data.options.startupTracePath.empty()) {
+    if (tsk::WriteTaskTimingsChromeTrace(result, data.options.startupTracePath)) {
+      data.logger.Write(kInfoLogSeverity) << "Wrote startup trace to " << data.options.startupTracePath;
+    }
+    else {
+      data.logger.Write(kWarningLogSeverity) << "Failed to write startup trace to " << data.options.startupTracePath;
+    }
+  }
 
-    VkSubmitInfo submitInfo = {};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  if (result.success) {
+    logVulkanReport(data, [&](std::ostream &out) { printVulkanMemoryStats(data, out); });
+    if (data.options.hostAllocationTracking) {
+      logVulkanReport(data, [&](std::ostream &out) { data.hostAllocator.PrintStats(out); });
+    }
+  }
 
-    VkSemaphore waitSemaphores[] = { data.imageAvailableSemaphore };
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
+  // THE LOOP!
+  const auto shouldKeepRunning = [&]() -> bool {
+    if (isHeadless(data)) {
+      return data.frameTimeStats.frameCount < data.options.headlessFrameCount;
+    }
 
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &data.commandBuffers[imageIndex];
+    return !glfwWindowShouldClose(data.window);
+  };
 
-    VkSemaphore signalSemaphores[] = { data.renderFinishedSemaphore };
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
+  auto lastFrameTime = std::chrono::high_resolution_clock::now();
+  const auto loopStartTime = lastFrameTime;
+  if (data.options.presentPolicy == kCappedFrameRatePresentPolicy) {
+    data.frameLimiter.SetTargetRate(data.options.targetFrameRate);
+  }
 
-    VkResult result;
-    if ((result = vkQueueSubmit(data.mainQueue, 1, &submitInfo, VK_NULL_HANDLE)) != VK_SUCCESS) {
+  while (result.success && shouldKeepRunning()) {
+    // both block, so they go before sampling input, which is then as fresh as it gets when the frame is recorded
+    data.frameLimiter.Wait();
+    waitForVulkanFrameSlot(data);
 
-      std::cerr << "Failed to submit to Vulkan queue with vk error code: " << result;
-      break;
+    if (!isHeadless(data)) {
+      glfwPollEvents();
     }
+    data.inputSampleTime = std::chrono::high_resolution_clock::now();
 
-    VkPresentInfoKHR presentInfo = {};
-    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-
-    presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
-
-    VkSwapchainKHR swapChains[] = { data.swapChain };
-    presentInfo.swapchainCount = 1;
-    presentInfo.pSwapchains = swapChains;
-    presentInfo.pImageIndices = &imageIndex;
+    if (data.options.buildDrawList) {
+      data.drawList.Clear();
+      data.options.buildDrawList(data.drawList);
+    }
+    else if (data.scene.Size() > 0) {
+      const Frustum frustum = MakeViewFrustum(data.frameUniforms.view, 0.0f, 1.0f);
+      const float deltaSeconds = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - lastFrameTime).count();
+      data.scene.UpdateTransforms(deltaSeconds, kSceneWorldExtent, &data.recordingWorkers);
+      data.scene.Cull(frustum, data.cullingPath, data.visibleSceneRows, &data.recordingWorkers);
+      data.scene.BuildDrawList(data.visibleSceneRows, data.drawList, &data.recordingWorkers);
+      data.drawListCulled = true;
+    }
 
-    presentInfo.pResults = nullptr; // Optional
+    // pans across the stress scene so that the culling has something to do
+    if (data.options.stressSceneObjectCount > 0) {
+      double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - loopStartTime).count();
+      data.frameUniforms.view[0] = static_cast<float>(0.75 * std::sin(seconds * 0.5));
+      data.frameUniforms.view[1] = static_cast<float>(0.75 * std::cos(seconds * 0.3));
+    }
 
-    vkQueuePresentKHR(data.mainQueue, &presentInfo);
+    bool submitted;
+    if (!drawVulkanFrame(data, submitted)) {
+      break;
+    }
 
-    vkQueueWaitIdle(data.mainQueue);
+    // a skipped frame may have waited for seconds while minimized, so it restarts the interval instead of ending one
+    auto frameTime = std::chrono::high_resolution_clock::now();
+    if (submitted) {
+      recordVulkanFrameTime(data.frameTimeStats, std::chrono::duration<double, std::milli>(frameTime - lastFrameTime).count());
+    }
+    lastFrameTime = frameTime;
   } // the loop
 
+  logVulkanReport(data, [&](std::ostream &out) { printVulkanFrameTimeStats(data, out); });
+  logVulkanReport(data, [&](std::ostream &out) { data.frameProfiler.PrintSummary(out); });
+  if (data.frameProfiler.IsEnabled() && !data.options.frameProfilerTracePath.empty()) {
+    if (data.frameProfiler.WriteChromeTrace(data.options.frameProfilerTracePath)) {
+      data.logger.Write(kInfoLogSeverity) << "Wrote frame trace to " << data.options.frameProfilerTracePath;
+    }
+    else {
+      data.logger.Write(kWarningLogSeverity) << "Failed to write frame trace to " << data.options.frameProfilerTracePath;
+    }
+  }
+  data.recordingWorkers.Stop();
+
   if (data.device != VK_NULL_HANDLE) {
 
     vkDeviceWaitIdle(data.device);
 
+    // before anything its compile threads may still be using goes away
+    data.pipelineVariants.Destroy();
+
     if (data.fragShaderModule != VK_NULL_HANDLE) {
-      vkDestroyShaderModule(data.device, data.fragShaderModule, nullptr);
+      vkDestroyShaderModule(data.device, data.fragShaderModule, data.allocationCallbacks);
     }
 
     if (data.vertShaderModule != VK_NULL_HANDLE) {
-      vkDestroyShaderModule(data.device, data.vertShaderModule, nullptr);
+      vkDestroyShaderModule(data.device, data.vertShaderModule, data.allocationCallbacks);
     }
 
     if (data.swapChain != VK_NULL_HANDLE) {
-      vkDestroySwapchainKHR(data.device, data.swapChain, nullptr);
+      vkDestroySwapchainKHR(data.device, data.swapChain, data.allocationCallbacks);
+    }
+
+    for (auto &retired : data.retiredSwapChains) {
+      destroyVulkanRetiredSwapChain(data, retired);
     }
 
     for (size_t i = 0; i < data.swapChainFramebuffers.size(); i++) {
       if (data.swapChainFramebuffers[i] != VK_NULL_HANDLE) {
-        vkDestroyFramebuffer(data.device, data.swapChainFramebuffers[i], nullptr);
+        vkDestroyFramebuffer(data.device, data.swapChainFramebuffers[i], data.allocationCallbacks);
       }
     }
 
     for (size_t i = 0; i < data.swapChainImageViews.size(); i++) {
       if (data.swapChainImageViews[i] != VK_NULL_HANDLE) {
-        vkDestroyImageView(data.device, data.swapChainImageViews[i], nullptr);
+        vkDestroyImageView(data.device, data.swapChainImageViews[i], data.allocationCallbacks);
+      }
+    }
+
+    for (auto semaphore : data.renderFinishedSemaphores) {
+      if (semaphore != VK_NULL_HANDLE) {
+        vkDestroySemaphore(data.device, semaphore, data.allocationCallbacks);
       }
     }
 
+    for (size_t i = 0; i < data.offscreenImages.size(); i++) {
+      data.memoryAllocator.DestroyImage(data.offscreenImages[i], data.offscreenImageMemory[i]);
+    }
+
     if (data.defaultPipelineLayout != VK_NULL_HANDLE) {
-      vkDestroyPipelineLayout(data.device, data.defaultPipelineLayout, nullptr);
+      vkDestroyPipelineLayout(data.device, data.defaultPipelineLayout, data.allocationCallbacks);
     }
 
+    if (data.scenePipeline != VK_NULL_HANDLE) {
+      vkDestroyPipeline(data.device, data.scenePipeline, data.allocationCallbacks);
+    }
+
+    if (data.scenePipelineLayout != VK_NULL_HANDLE) {
+      vkDestroyPipelineLayout(data.device, data.scenePipelineLayout, data.allocationCallbacks);
+    }
+
+    if (data.sceneVertShaderModule != VK_NULL_HANDLE) {
+      vkDestroyShaderModule(data.device, data.sceneVertShaderModule, data.allocationCallbacks);
+    }
+
+    data.renderGraph.Destroy();
+    data.indirectScene.Destroy();
+
+    data.descriptorAllocator.Destroy();
+    data.descriptorLayoutCache.Destroy();
+
     if (data.defaultRenderPass != VK_NULL_HANDLE) {
-      vkDestroyRenderPass(data.device, data.defaultRenderPass, nullptr);
+      vkDestroyRenderPass(data.device, data.defaultRenderPass, data.allocationCallbacks);
     }
 
     if (data.defaultGraphicsPipeline != VK_NULL_HANDLE) {
-      vkDestroyPipeline(data.device, data.defaultGraphicsPipeline, nullptr);
+      vkDestroyPipeline(data.device, data.defaultGraphicsPipeline, data.allocationCallbacks);
     }
-    
-    if (data.commandPool != VK_NULL_HANDLE) {
-      vkDestroyCommandPool(data.device, data.commandPool, nullptr);
+
+    if (data.pipelineCache != VK_NULL_HANDLE) {
+      saveVulkanPipelineCache(data);
+      vkDestroyPipelineCache(data.device, data.pipelineCache, data.allocationCallbacks);
     }
+    
+    for (const auto &frame : data.frames) {
+      if (frame.commandPool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(data.device, frame.commandPool, data.allocationCallbacks);
+      }
 
-    if (data.renderFinishedSemaphore != VK_NULL_HANDLE) {
-      vkDestroySemaphore(data.device, data.renderFinishedSemaphore, nullptr);
+      for (auto recordingCommandPool : frame.recordingCommandPools) {
+        if (recordingCommandPool != VK_NULL_HANDLE) {
+          vkDestroyCommandPool(data.device, recordingCommandPool, data.allocationCallbacks);
+        }
+      }
+
+      if (frame.computeCommandPool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(data.device, frame.computeCommandPool, data.allocationCallbacks);
+      }
     }
 
-    if (data.imageAvailableSemaphore != VK_NULL_HANDLE) {
-      vkDestroySemaphore(data.device, data.imageAvailableSemaphore, nullptr);
+    for (const auto &frame : data.frames) {
+      if (frame.imageAvailableSemaphore != VK_NULL_HANDLE) {
+        vkDestroySemaphore(data.device, frame.imageAvailableSemaphore, data.allocationCallbacks);
+      }
+
+      if (frame.inFlightFence != VK_NULL_HANDLE) {
+        vkDestroyFence(data.device, frame.inFlightFence, data.allocationCallbacks);
+      }
+
+      if (frame.cullFinishedSemaphore != VK_NULL_HANDLE) {
+        vkDestroySemaphore(data.device, frame.cullFinishedSemaphore, data.allocationCallbacks);
+      }
     }
 
-    vkDestroyDevice(data.device, nullptr);
+    data.frameProfiler.Destroy();
+    data.uploader.Destroy();
+    data.uniformAllocator.Destroy();
+    data.memoryAllocator.Destroy();
+
+    vkDestroyDevice(data.device, data.allocationCallbacks);
   }
 
   if (data.instance != VK_NULL_HANDLE) {
 
     if (data.callbackDebugInstance != VK_NULL_HANDLE) {
-      DestroyVkDebugReportCallbackEXT(data.instance, data.callbackDebugInstance, nullptr);
+      DestroyVkDebugReportCallbackEXT(data.instance, data.callbackDebugInstance, data.allocationCallbacks);
     }
 
     if (data.surface != VK_NULL_HANDLE) {
-      vkDestroySurfaceKHR(data.instance, data.surface, nullptr);
+      vkDestroySurfaceKHR(data.instance, data.surface, data.allocationCallbacks);
     }
 
-    vkDestroyInstance(data.instance, nullptr);
+    vkDestroyInstance(data.instance, data.allocationCallbacks);
+  }
+
+  // anything still live here was leaked by the engine or the driver
+  if (data.options.hostAllocationTracking) {
+    logVulkanReport(data, [&](std::ostream &out) { data.hostAllocator.PrintStats(out); });
+    data.hostAllocator.Destroy();
   }
 
   if (data.window != nullptr) {
@@ -1161,6 +2741,8 @@ void VulkanSquirrel::Run(const VulkanSquirrelOptions &options) {
   }
 
   glfwTerminate();
+
+  data.logger.Stop();
 }
 
 } // namespace VKS
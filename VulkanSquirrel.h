@@ -1,10 +1,15 @@
 #pragma once
 
+#include <functional>
+#include <string>
 #include <vector>
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include "AsyncLogger.h"
+#include "DrawList.h"
+
 namespace vks {
 
 enum VulkanValidationLayerMode {
@@ -12,6 +17,30 @@ enum VulkanValidationLayerMode {
   kEnabledVulkanValidationLayers,
 };
 
+enum VulkanFrameSubmissionMode {
+  // waits for the queue to go idle after every present, CPU and GPU never overlap
+  kSerializedFrameSubmission = 0,
+  // records frame N+1 while the GPU is still executing up to framesInFlight previous frames
+  kFramesInFlightSubmission,
+};
+
+
+enum VulkanPresentationMode {
+  // renders into a GLFW window through a swap chain
+  kWindowedPresentation = 0,
+  // no window or surface, renders into a ring of offscreen images for a fixed number of frames
+  kHeadlessPresentation,
+};
+
+// which present mode the swap chain asks for, and how the render loop is paced
+enum VulkanPresentPolicy {
+  // MAILBOX, then IMMEDIATE, then FIFO, the newest frame reaches the screen as soon as possible
+  kLowLatencyPresentPolicy = 0,
+  // FIFO, frames wait for vertical blank and the loop runs no faster than the display
+  kPowerSavingPresentPolicy,
+  // MAILBOX, then FIFO, paced by a CPU side limiter to targetFrameRate that sleeps before input is sampled
+  kCappedFrameRatePresentPolicy,
+};
 
 struct VulkanSquirrelOptions {
   VulkanValidationLayerMode vulkanValidationLayersMode;
@@ -19,6 +48,48 @@ struct VulkanSquirrelOptions {
   std::vector<const char*> vulkanExtensions;
   int windowWidth;
   int windowHeight;
+  VulkanFrameSubmissionMode frameSubmissionMode = kFramesInFlightSubmission;
+  uint32_t framesInFlight = 2;
+  VulkanPresentationMode presentationMode = kWindowedPresentation;
+  uint64_t headlessFrameCount = 1000;
+  VulkanPresentPolicy presentPolicy = kLowLatencyPresentPolicy;
+  // frames per second kCappedFrameRatePresentPolicy paces to
+  double targetFrameRate = 60.0;
+  // snapshot of the loader's and devices' capabilities, written when startup had to probe them and reused by later
+  // launches with the same loader and drivers, empty always probes
+  std::string capabilityCachePath;
+  // pipeline cache blob loaded at startup and written back at shutdown, empty disables it
+  std::string pipelineCachePath;
+  // asset pack written by ProcessAssets.py --pack, assets missing from it or a missing pack fall back to loose files in ./Assets
+  std::string assetPackPath;
+  // threads recording draw commands each frame, including the render thread, 0 means one per hardware thread
+  uint32_t recordingThreadCount = 0;
+  // CPU and GPU timings of the render loop, summarized at shutdown
+  bool frameProfiling = false;
+  // number of frames the min/avg/p99 summary is computed over
+  uint32_t frameProfilerHistory = 256;
+  // Chrome trace_event JSON written at shutdown when profiling, empty disables it
+  std::string frameProfilerTracePath;
+  // Chrome trace_event JSON of the startup task timings, empty disables it
+  std::string startupTracePath;
+  // quads in the GPU culled, indirectly drawn stress scene, 0 disables it
+  uint32_t stressSceneObjectCount = 0;
+  // runs the stress scene's culling on a compute queue of its own when the GPU has one
+  bool asyncCompute = true;
+  // routes the driver's host allocations through a pooled allocator that accounts them per scope, printed at startup and exit
+  bool hostAllocationTracking = false;
+  // host allocation callbacks of the embedding application, used for every Vulkan object when tracking is off,
+  // they have to stay valid until Run returns
+  const VkAllocationCallbacks* hostAllocationCallbacks = nullptr;
+  // moving triangles in the CPU side scene store, drawn when buildDrawList isn't set, 0 keeps the default triangle
+  uint32_t sceneEntityCount = 0;
+  // messages below this severity are dropped before they reach the log ring
+  LogSeverity logSeverity = kInfoLogSeverity;
+  // times per second the same message is written before further repeats are only counted, 0 writes every one
+  uint32_t logRepeatLimit = AsyncLogger::kDefaultRepeatLimit;
+  // called once per frame with an empty draw list to fill, e.g. by a script host,
+  // when not set a single default triangle is drawn
+  std::function<void(DrawList&)> buildDrawList;
 };
 
 enum VulkanSquirrelErrorCodes {
@@ -41,8 +112,16 @@ enum VulkanSquirrelErrorCodes {
   kVKFailedToCreateDefaultVulkanFramebuffer = 2015,
   kVKFailedToCreateDefaultVulkanCommandPool = 2016,
   kVKFailedToCreateDefaultVulkanCommandBuffers = 2017,
-  kVKFailedToCreateDefaultVulkanCommandBuffer = 2018,
   kVKFailedToCreateDefaultVulkanSemaphore = 2019,
+  kVKFailedToCreateDefaultVulkanFence = 2020,
+  kVKFailedToCreateOffscreenImage = 2021,
+  kVKFailedToCreatePipelineCache = 2023,
+  kVKFailedToCreateTimestampQueryPool = 2024,
+  kVKFailedToCreateUploader = 2025,
+  kVKFailedToCreateFrameUniformBuffer = 2026,
+  kVKFailedToCreateFrameDescriptorSet = 2027,
+  kVKFailedToCreateIndirectScene = 2028,
+  kVKFailedToCreateRenderGraph = 2029,
 };
 
 class VulkanSquirrel
@@ -0,0 +1,81 @@
+#include "VulkanUniformAllocator.h"
+
+#include <algorithm>
+
+namespace vks {
+
+VkDeviceSize alignUniformSize(VkDeviceSize size, VkDeviceSize alignment) {
+  return (size + alignment - 1) & ~(alignment - 1);
+}
+
+VkResult VulkanUniformAllocator::Init(
+  VkPhysicalDevice physicalDevice,
+  VulkanMemoryAllocator &allocator,
+  uint32_t frameSlotCount,
+  VkDeviceSize frameSize,
+  VkDeviceSize bindingRange) {
+
+  allocator_ = &allocator;
+
+  // minUniformBufferOffsetAlignment is a power of two, and so is nonCoherentAtomSize should the memory ever not be coherent
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  alignment_ = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 16);
+
+  bindingRange_ = std::min<VkDeviceSize>(alignUniformSize(bindingRange, 16), properties.limits.maxUniformBufferRange);
+  frameSize_ = alignUniformSize(std::max(frameSize, bindingRange_), alignment_);
+
+  // the descriptor always covers bindingRange bytes from the dynamic offset, so the last
+  // partition is followed by enough padding for an allocation right at its end
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = frameSize_ * frameSlotCount + bindingRange_;
+  bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  VkResult result;
+  if ((result = allocator_->CreateBuffer(
+    bufferInfo,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    buffer_,
+    memory_)) != VK_SUCCESS) {
+    return result;
+  }
+
+  if (memory_.mappedData == nullptr) {
+    return VK_ERROR_MEMORY_MAP_FAILED;
+  }
+
+  return VK_SUCCESS;
+}
+
+void VulkanUniformAllocator::Destroy() {
+  if (buffer_ != VK_NULL_HANDLE) {
+    allocator_->DestroyBuffer(buffer_, memory_);
+  }
+}
+
+void VulkanUniformAllocator::BeginFrame(uint32_t frameSlot) {
+  frameStart_ = frameSlot * frameSize_;
+  head_.store(0, std::memory_order_relaxed);
+}
+
+void* VulkanUniformAllocator::Allocate(VkDeviceSize size, uint32_t &dynamicOffset) {
+
+  if (size > bindingRange_ || buffer_ == VK_NULL_HANDLE) {
+    return nullptr;
+  }
+
+  // every partition starts aligned and every allocation is a multiple of the alignment, so offsets stay aligned
+  VkDeviceSize alignedSize = alignUniformSize(std::max<VkDeviceSize>(size, 1), alignment_);
+  VkDeviceSize offset = head_.fetch_add(alignedSize, std::memory_order_relaxed);
+
+  if (offset + alignedSize > frameSize_) {
+    return nullptr;
+  }
+
+  dynamicOffset = static_cast<uint32_t>(frameStart_ + offset);
+  return static_cast<char*>(memory_.mappedData) + frameStart_ + offset;
+}
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#include <vulkan\vulkan.hpp>
+
+#include "VulkanMemoryAllocator.h"
+
+namespace vks {
+
+// Per frame uniform data out of one persistently mapped, host visible buffer split into a partition per frame
+// in flight. An allocation is an atomic bump inside the current frame's partition, the caller memcpys into
+// the returned pointer and binds the returned dynamic offset with a single UNIFORM_BUFFER_DYNAMIC descriptor
+// that covers bindingRange bytes, so no buffers or descriptors are created while recording.
+// Allocate and Push are thread safe so recording threads can use them directly, the rest belongs to the render thread.
+class VulkanUniformAllocator {
+  public:
+    static const VkDeviceSize kDefaultFrameSize = 4 * 1024 * 1024;
+    static const VkDeviceSize kDefaultBindingRange = 256;
+
+    // bindingRange is the largest single allocation and the range of the descriptor, clamped to maxUniformBufferRange
+    VkResult Init(
+      VkPhysicalDevice physicalDevice,
+      VulkanMemoryAllocator &allocator,
+      uint32_t frameSlotCount,
+      VkDeviceSize frameSize = kDefaultFrameSize,
+      VkDeviceSize bindingRange = kDefaultBindingRange);
+    // the device has to be idle
+    void Destroy();
+
+    // starts handing out the partition of frameSlot, whose previous frame must have finished on the GPU
+    void BeginFrame(uint32_t frameSlot);
+
+    // returns null when the frame's partition is full or size is larger than the binding range
+    void* Allocate(VkDeviceSize size, uint32_t &dynamicOffset);
+
+    template<typename T>
+    bool Push(const T &value, uint32_t &dynamicOffset) {
+      void* destination = Allocate(sizeof(T), dynamicOffset);
+      if (destination == nullptr) {
+        return false;
+      }
+      memcpy(destination, &value, sizeof(T));
+      return true;
+    }
+
+    VkBuffer GetBuffer() const { return buffer_; }
+    VkDeviceSize GetBindingRange() const { return bindingRange_; }
+    // bytes handed out so far in the current frame, including alignment padding
+    VkDeviceSize GetFrameBytesUsed() const { return std::min(head_.load(std::memory_order_relaxed), frameSize_); }
+
+  private:
+    VulkanMemoryAllocator* allocator_ = nullptr;
+    VkBuffer buffer_ = VK_NULL_HANDLE;
+    VulkanMemoryAllocation memory_;
+
+    VkDeviceSize alignment_ = 256;
+    VkDeviceSize frameSize_ = 0;
+    VkDeviceSize bindingRange_ = 0;
+
+    // start of the current frame's partition, and the bump offset inside it
+    VkDeviceSize frameStart_ = 0;
+    std::atomic<VkDeviceSize> head_{ 0 };
+};
+
+}
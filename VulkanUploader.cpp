@@ -0,0 +1,458 @@
+#include "VulkanUploader.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace vks {
+
+VkResult VulkanUploader::Init(
+  VkPhysicalDevice physicalDevice,
+  VkDevice device,
+  VulkanMemoryAllocator &allocator,
+  VkQueue transferQueue,
+  uint32_t transferQueueFamilyIndex,
+  uint32_t graphicsQueueFamilyIndex,
+  VkDeviceSize stagingSize,
+  const VkAllocationCallbacks* allocationCallbacks) {
+
+  device_ = device;
+  allocationCallbacks_ = allocationCallbacks;
+  allocator_ = &allocator;
+  transferQueue_ = transferQueue;
+  transferQueueFamilyIndex_ = transferQueueFamilyIndex;
+  graphicsQueueFamilyIndex_ = graphicsQueueFamilyIndex;
+  stagingSize_ = stagingSize;
+
+  // all of these are powers of two, and 16 covers the texel size of every uncompressed format
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  stagingAlignment_ = std::max<VkDeviceSize>(16, properties.limits.optimalBufferCopyOffsetAlignment);
+
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.queueFamilyIndex = transferQueueFamilyIndex_;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+  VkResult result;
+  if ((result = vkCreateCommandPool(device_, &poolInfo, allocationCallbacks_, &commandPool_)) != VK_SUCCESS) {
+    return result;
+  }
+
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = stagingSize_;
+  bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  if ((result = allocator_->CreateBuffer(
+    bufferInfo,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    stagingBuffer_,
+    stagingMemory_)) != VK_SUCCESS) {
+    return result;
+  }
+
+  if (stagingMemory_.mappedData == nullptr) {
+    return VK_ERROR_MEMORY_MAP_FAILED;
+  }
+
+  return VK_SUCCESS;
+}
+
+void VulkanUploader::Destroy() {
+
+  const auto destroyBatch = [&](Batch &batch) {
+    if (batch.fence != VK_NULL_HANDLE) {
+      vkDestroyFence(device_, batch.fence, allocationCallbacks_);
+    }
+    if (batch.semaphore != VK_NULL_HANDLE) {
+      vkDestroySemaphore(device_, batch.semaphore, allocationCallbacks_);
+    }
+  };
+
+  for (auto &batch : batches_) {
+    destroyBatch(batch);
+  }
+  for (auto &batch : freeBatches_) {
+    destroyBatch(batch);
+  }
+  batches_.clear();
+  freeBatches_.clear();
+
+  if (stagingBuffer_ != VK_NULL_HANDLE) {
+    allocator_->DestroyBuffer(stagingBuffer_, stagingMemory_);
+  }
+
+  // frees the batch command buffers too
+  if (commandPool_ != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(device_, commandPool_, allocationCallbacks_);
+    commandPool_ = VK_NULL_HANDLE;
+  }
+}
+
+VkResult VulkanUploader::UploadBuffer(
+  VkBuffer buffer,
+  VkDeviceSize offset,
+  const void* data,
+  VkDeviceSize size,
+  VkPipelineStageFlags dstStageMask,
+  VkAccessFlags dstAccessMask,
+  VkSharingMode sharingMode) {
+
+  if (size > stagingSize_) {
+    return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+  }
+
+  VkResult result;
+  if ((result = beginBatch()) != VK_SUCCESS) {
+    return result;
+  }
+
+  VkDeviceSize stagingOffset;
+  if (!allocateStaging(size, stagingOffset)) {
+    return VK_NOT_READY;
+  }
+
+  Batch &batch = batches_.back();
+  memcpy(static_cast<char*>(stagingMemory_.mappedData) + stagingOffset, data, static_cast<size_t>(size));
+
+  VkBufferCopy region = {};
+  region.srcOffset = stagingOffset;
+  region.dstOffset = offset;
+  region.size = size;
+  vkCmdCopyBuffer(batch.commandBuffer, stagingBuffer_, buffer, 1, &region);
+
+  VkBufferMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.buffer = buffer;
+  barrier.offset = offset;
+  barrier.size = size;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+  if (UsesDedicatedTransferQueue() && sharingMode == VK_SHARING_MODE_CONCURRENT) {
+    // no ownership to hand over, the semaphore the graphics submit waits on makes the copy visible at dstStageMask
+    batch.acquireStageMask |= dstStageMask;
+  }
+  else if (UsesDedicatedTransferQueue()) {
+    // release here, the acquire half with the real destination access goes into a graphics command buffer
+    barrier.dstAccessMask = 0;
+    barrier.srcQueueFamilyIndex = transferQueueFamilyIndex_;
+    barrier.dstQueueFamilyIndex = graphicsQueueFamilyIndex_;
+    vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dstAccessMask;
+    batch.acquireBufferBarriers.push_back(barrier);
+    batch.acquireStageMask |= dstStageMask;
+  }
+  else {
+    // same queue as rendering, so a barrier orders it against every later submission
+    barrier.dstAccessMask = dstAccessMask;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+  }
+
+  batch.hasCommands = true;
+  batch.stagingEnd = stagingHead_;
+
+  return VK_SUCCESS;
+}
+
+VkResult VulkanUploader::UploadImage(
+  VkImage image,
+  VkExtent3D extent,
+  const void* data,
+  VkDeviceSize size,
+  VkImageLayout finalLayout,
+  VkPipelineStageFlags dstStageMask,
+  VkAccessFlags dstAccessMask) {
+
+  if (size > stagingSize_) {
+    return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+  }
+
+  VkResult result;
+  if ((result = beginBatch()) != VK_SUCCESS) {
+    return result;
+  }
+
+  VkDeviceSize stagingOffset;
+  if (!allocateStaging(size, stagingOffset)) {
+    return VK_NOT_READY;
+  }
+
+  Batch &batch = batches_.back();
+  memcpy(static_cast<char*>(stagingMemory_.mappedData) + stagingOffset, data, static_cast<size_t>(size));
+
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = 1;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+  // old contents are discarded, so there is nothing to transfer ownership of yet
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+  VkBufferImageCopy region = {};
+  region.bufferOffset = stagingOffset;
+  region.bufferRowLength = 0;
+  region.bufferImageHeight = 0;
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.mipLevel = 0;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = 1;
+  region.imageOffset = { 0, 0, 0 };
+  region.imageExtent = extent;
+  vkCmdCopyBufferToImage(batch.commandBuffer, stagingBuffer_, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = finalLayout;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+  if (UsesDedicatedTransferQueue()) {
+    // the release and acquire barriers have to describe the same layout transition
+    barrier.dstAccessMask = 0;
+    barrier.srcQueueFamilyIndex = transferQueueFamilyIndex_;
+    barrier.dstQueueFamilyIndex = graphicsQueueFamilyIndex_;
+    vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dstAccessMask;
+    batch.acquireImageBarriers.push_back(barrier);
+    batch.acquireStageMask |= dstStageMask;
+  }
+  else {
+    barrier.dstAccessMask = dstAccessMask;
+    vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+  }
+
+  batch.hasCommands = true;
+  batch.stagingEnd = stagingHead_;
+
+  return VK_SUCCESS;
+}
+
+VkResult VulkanUploader::Flush(VulkanUploadTicket &ticket) {
+
+  ticket = nextTicket_ - 1;
+
+  if (batches_.empty() || batches_.back().state != kRecordingBatch || !batches_.back().hasCommands) {
+    return VK_SUCCESS;
+  }
+
+  Batch &batch = batches_.back();
+
+  VkResult result;
+  if ((result = vkEndCommandBuffer(batch.commandBuffer)) != VK_SUCCESS) {
+    return result;
+  }
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &batch.commandBuffer;
+  submitInfo.signalSemaphoreCount = batch.semaphore != VK_NULL_HANDLE ? 1 : 0;
+  submitInfo.pSignalSemaphores = &batch.semaphore;
+
+  if ((result = vkQueueSubmit(transferQueue_, 1, &submitInfo, batch.fence)) != VK_SUCCESS) {
+    return result;
+  }
+
+  batch.state = kSubmittedBatch;
+  batch.ticket = nextTicket_++;
+  ticket = batch.ticket;
+
+  return VK_SUCCESS;
+}
+
+void VulkanUploader::Update(uint64_t completedFrameCount) {
+
+  // batches finish in submission order on the one transfer queue
+  for (auto &batch : batches_) {
+    if (batch.state != kSubmittedBatch) {
+      if (batch.state == kRecordingBatch) break;
+      continue;
+    }
+
+    if (vkGetFenceStatus(device_, batch.fence) != VK_SUCCESS) {
+      break;
+    }
+
+    stagingTail_ = batch.stagingEnd;
+    // without an ownership transfer there is nothing left to do on the graphics queue
+    batch.state = UsesDedicatedTransferQueue() ? kTransferredBatch : kAcquiredBatch;
+  }
+
+  for (const auto &batch : batches_) {
+    if (batch.state != kAcquiredBatch) break;
+    completedTicket_ = batch.ticket;
+  }
+
+  while (!batches_.empty() && batches_.front().state == kAcquiredBatch && batches_.front().acquireFrameNumber < completedFrameCount) {
+    Batch batch = std::move(batches_.front());
+    batches_.pop_front();
+
+    vkResetFences(device_, 1, &batch.fence);
+    batch.state = kRecordingBatch;
+    batch.hasCommands = false;
+    batch.acquireFrameNumber = 0;
+    batch.acquireBufferBarriers.clear();
+    batch.acquireImageBarriers.clear();
+    batch.acquireStageMask = 0;
+    freeBatches_.push_back(std::move(batch));
+  }
+}
+
+void VulkanUploader::RecordPendingAcquires(
+  VkCommandBuffer commandBuffer,
+  uint64_t frameNumber,
+  std::vector<VkSemaphore> &waitSemaphores,
+  std::vector<VkPipelineStageFlags> &waitStages) {
+
+  for (auto &batch : batches_) {
+    if (batch.state != kTransferredBatch) {
+      continue;
+    }
+
+    // the semaphore wait and the barrier use the same stages so they chain into one dependency
+    vkCmdPipelineBarrier(
+      commandBuffer,
+      batch.acquireStageMask,
+      batch.acquireStageMask,
+      0,
+      0, nullptr,
+      static_cast<uint32_t>(batch.acquireBufferBarriers.size()), batch.acquireBufferBarriers.data(),
+      static_cast<uint32_t>(batch.acquireImageBarriers.size()), batch.acquireImageBarriers.data());
+
+    waitSemaphores.push_back(batch.semaphore);
+    waitStages.push_back(batch.acquireStageMask);
+
+    batch.state = kAcquiredBatch;
+    batch.acquireFrameNumber = frameNumber;
+    completedTicket_ = std::max(completedTicket_, batch.ticket);
+  }
+}
+
+VkResult VulkanUploader::WaitForTransfer(VulkanUploadTicket ticket, uint64_t timeout) {
+
+  for (auto &batch : batches_) {
+    if (batch.state == kRecordingBatch && batch.hasCommands) {
+      // never flushed, waiting would never end
+      return VK_NOT_READY;
+    }
+
+    if (batch.state == kSubmittedBatch && batch.ticket >= ticket) {
+      return vkWaitForFences(device_, 1, &batch.fence, VK_TRUE, timeout);
+    }
+  }
+
+  return VK_SUCCESS;
+}
+
+VkResult VulkanUploader::beginBatch() {
+
+  if (!batches_.empty() && batches_.back().state == kRecordingBatch) {
+    return VK_SUCCESS;
+  }
+
+  Batch batch;
+  if (!freeBatches_.empty()) {
+    batch = std::move(freeBatches_.back());
+    freeBatches_.pop_back();
+  }
+  else {
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPool_;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    VkResult result;
+    if ((result = vkAllocateCommandBuffers(device_, &allocInfo, &batch.commandBuffer)) != VK_SUCCESS) {
+      return result;
+    }
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if ((result = vkCreateFence(device_, &fenceInfo, allocationCallbacks_, &batch.fence)) != VK_SUCCESS) {
+      vkFreeCommandBuffers(device_, commandPool_, 1, &batch.commandBuffer);
+      return result;
+    }
+
+    if (UsesDedicatedTransferQueue()) {
+      VkSemaphoreCreateInfo semaphoreInfo = {};
+      semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+      if ((result = vkCreateSemaphore(device_, &semaphoreInfo, allocationCallbacks_, &batch.semaphore)) != VK_SUCCESS) {
+        vkDestroyFence(device_, batch.fence, allocationCallbacks_);
+        vkFreeCommandBuffers(device_, commandPool_, 1, &batch.commandBuffer);
+        return result;
+      }
+    }
+  }
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  VkResult result = vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+  if (result != VK_SUCCESS) {
+    freeBatches_.push_back(std::move(batch));
+    return result;
+  }
+
+  batches_.push_back(std::move(batch));
+  return VK_SUCCESS;
+}
+
+bool VulkanUploader::allocateStaging(VkDeviceSize size, VkDeviceSize &offset) {
+
+  bool inUse = false;
+  for (const auto &batch : batches_) {
+    if (batch.state == kSubmittedBatch || (batch.state == kRecordingBatch && batch.hasCommands)) {
+      inUse = true;
+      break;
+    }
+  }
+
+  if (!inUse) {
+    stagingHead_ = 0;
+    stagingTail_ = 0;
+  }
+
+  VkDeviceSize start = (stagingHead_ + stagingAlignment_ - 1) & ~(stagingAlignment_ - 1);
+
+  // head == tail while in use means the ring is exactly full
+  if (!inUse || stagingHead_ > stagingTail_) {
+    if (start + size > stagingSize_) {
+      // wrap around, the space between head and the end stays unused until the tail passes it
+      if (size > stagingTail_ && inUse) {
+        return false;
+      }
+      start = 0;
+    }
+  }
+  else if (stagingHead_ < stagingTail_) {
+    if (start + size > stagingTail_) {
+      return false;
+    }
+  }
+  else {
+    return false;
+  }
+
+  offset = start;
+  stagingHead_ = start + size;
+  return true;
+}
+
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <vulkan\vulkan.hpp>
+
+#include "VulkanMemoryAllocator.h"
+
+namespace vks {
+
+// identifies everything queued before the Flush that returned it, 0 is never handed out
+typedef uint64_t VulkanUploadTicket;
+
+// Copies buffer and image data to the GPU on the transfer queue, out of a persistently mapped staging ring.
+// Nothing here blocks: when the ring is full uploads return VK_NOT_READY and should be retried after Update.
+//
+// When the transfer queue comes from a different family than the graphics queue, each batch ends with
+// queue family release barriers, and the matching acquire barriers are recorded into the next frame by
+// RecordPendingAcquires, whose submit then has to wait on the returned semaphores.
+//
+// Not thread safe, meant to be driven by the render thread together with the frame loop.
+class VulkanUploader {
+  public:
+    static const VkDeviceSize kDefaultStagingSize = 32 * 1024 * 1024;
+
+    VkResult Init(
+      VkPhysicalDevice physicalDevice,
+      VkDevice device,
+      VulkanMemoryAllocator &allocator,
+      VkQueue transferQueue,
+      uint32_t transferQueueFamilyIndex,
+      uint32_t graphicsQueueFamilyIndex,
+      VkDeviceSize stagingSize = kDefaultStagingSize,
+      const VkAllocationCallbacks* allocationCallbacks = nullptr);
+    // the device has to be idle
+    void Destroy();
+
+    // After completion buffer is readable at dstStageMask/dstAccessMask on the graphics queue.
+    // sharingMode is the one buffer was created with, concurrent buffers have to include the transfer family
+    // and skip the queue family ownership transfer, the graphics submit still waits on the batch.
+    VkResult UploadBuffer(
+      VkBuffer buffer,
+      VkDeviceSize offset,
+      const void* data,
+      VkDeviceSize size,
+      VkPipelineStageFlags dstStageMask,
+      VkAccessFlags dstAccessMask,
+      VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE);
+
+    // Uploads mip 0, layer 0 of a color image from tightly packed texels, previous contents are discarded.
+    // After completion the image is in finalLayout and readable at dstStageMask/dstAccessMask on the graphics queue.
+    VkResult UploadImage(
+      VkImage image,
+      VkExtent3D extent,
+      const void* data,
+      VkDeviceSize size,
+      VkImageLayout finalLayout,
+      VkPipelineStageFlags dstStageMask,
+      VkAccessFlags dstAccessMask);
+
+    // Submits everything queued since the last Flush and returns its ticket. Returns the previous ticket if nothing was queued.
+    VkResult Flush(VulkanUploadTicket &ticket);
+
+    // Retires finished batches and frees their staging space. completedFrameCount is the number of frames
+    // known to have finished on the GPU, batches acquired by those frames are recycled.
+    void Update(uint64_t completedFrameCount);
+
+    // Records the acquire barriers of every submitted batch not acquired yet into commandBuffer, which has to
+    // be a graphics queue command buffer outside of a render pass, submitted as frame frameNumber (counting from 0).
+    // Appends the semaphores that submit has to wait on. Does nothing when the queue families match.
+    void RecordPendingAcquires(
+      VkCommandBuffer commandBuffer,
+      uint64_t frameNumber,
+      std::vector<VkSemaphore> &waitSemaphores,
+      std::vector<VkPipelineStageFlags> &waitStages);
+
+    // true once the data of ticket is visible to graphics work recorded from now on
+    bool IsComplete(VulkanUploadTicket ticket) const { return ticket <= completedTicket_; }
+    // blocks until the copies of ticket finished on the transfer queue, for loading screens and shutdown
+    VkResult WaitForTransfer(VulkanUploadTicket ticket, uint64_t timeout);
+
+    bool UsesDedicatedTransferQueue() const { return transferQueueFamilyIndex_ != graphicsQueueFamilyIndex_; }
+
+  private:
+    enum BatchState {
+      kRecordingBatch,
+      kSubmittedBatch,
+      // copies finished, waiting for RecordPendingAcquires
+      kTransferredBatch,
+      // acquire recorded into frame acquireFrameNumber
+      kAcquiredBatch,
+    };
+
+    struct Batch {
+      VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+      VkFence fence = VK_NULL_HANDLE;
+      VkSemaphore semaphore = VK_NULL_HANDLE;
+      BatchState state = kRecordingBatch;
+      VulkanUploadTicket ticket = 0;
+      // staging ring head after this batch's last allocation, the ring tail moves here once it finished
+      VkDeviceSize stagingEnd = 0;
+      bool hasCommands = false;
+      uint64_t acquireFrameNumber = 0;
+      std::vector<VkBufferMemoryBarrier> acquireBufferBarriers;
+      std::vector<VkImageMemoryBarrier> acquireImageBarriers;
+      VkPipelineStageFlags acquireStageMask = 0;
+    };
+
+    VkResult beginBatch();
+    bool allocateStaging(VkDeviceSize size, VkDeviceSize &offset);
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    const VkAllocationCallbacks* allocationCallbacks_ = nullptr;
+    VulkanMemoryAllocator* allocator_ = nullptr;
+    VkQueue transferQueue_ = VK_NULL_HANDLE;
+    uint32_t transferQueueFamilyIndex_ = 0;
+    uint32_t graphicsQueueFamilyIndex_ = 0;
+
+    VkCommandPool commandPool_ = VK_NULL_HANDLE;
+
+    VkBuffer stagingBuffer_ = VK_NULL_HANDLE;
+    VulkanMemoryAllocation stagingMemory_;
+    VkDeviceSize stagingSize_ = 0;
+    VkDeviceSize stagingAlignment_ = 16;
+    // allocations go at head and are freed from tail in submission order
+    VkDeviceSize stagingHead_ = 0;
+    VkDeviceSize stagingTail_ = 0;
+
+    // the batch being recorded is at the back once it has commands, all older ones are in flight
+    std::deque<Batch> batches_;
+    std::vector<Batch> freeBatches_;
+
+    VulkanUploadTicket nextTicket_ = 1;
+    VulkanUploadTicket completedTicket_ = 0;
+};
+
+}
@@ -1,7 +1,15 @@
 #include "VulkanUtils.h"
 
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <vector>
-#include <set>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
 
 #include <vulkan\vulkan.hpp>
 
@@ -17,43 +25,6 @@ std::vector<VkExtensionProperties> GetVkExtensions() {
   return extensions;
 }
 
-const VkExtensionProperties* FindVkExtension(std::vector<VkExtensionProperties> &availableVKExtensions, const char* neededExtension) {
-  for (const auto& availableExtension : availableVKExtensions) {
-
-    if (strcmp(availableExtension.extensionName, neededExtension) == 0) {
-      return &availableExtension;
-    }
-  }
-
-  return nullptr;
-}
-
-bool CheckVkValidationLayerSupport(const std::vector<const char*> &requestedLayers) {
-  uint32_t layerCount;
-  vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
-
-  std::vector<VkLayerProperties> availableLayers(layerCount);
-  vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
-
-  for (int i = 0; i < requestedLayers.size(); ++i) {
-    bool layerFound = false;
-
-    for (const auto& layerProperties : availableLayers) {
-      if (strcmp(requestedLayers[i], layerProperties.layerName) == 0) {
-        layerFound = true;
-        break;
-      }
-    }
-
-    if (!layerFound) {
-      return false;
-    }
-  }
-
-  return true;
-}
-
-
 VkResult CreateVkDebugReportCallbackEXT(VkInstance instance, const VkDebugReportCallbackCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugReportCallbackEXT* pCallback) {
   auto func = (PFN_vkCreateDebugReportCallbackEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugReportCallbackEXT");
   if (func != nullptr) {
@@ -82,32 +53,156 @@ std::vector<VkQueueFamilyProperties> GetVkFamiliesOfDevice(const VkPhysicalDevic
   return queueFamilies;
 }
 
-bool CheckVkExtensionSupport(const VkPhysicalDevice &device, const std::vector<const char*> &extensions) {
+bool FindVkMemoryType(const VkPhysicalDevice &device, uint32_t typeBits, VkMemoryPropertyFlags properties, uint32_t &output) {
 
-  uint32_t deviceExtensionCount;
-  vkEnumerateDeviceExtensionProperties(device, nullptr, &deviceExtensionCount, nullptr);
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
 
-  std::vector<VkExtensionProperties> deviceAvailableExtensions(deviceExtensionCount);
-  vkEnumerateDeviceExtensionProperties(device, nullptr, &deviceExtensionCount, deviceAvailableExtensions.data());
+  for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+    if ((typeBits & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+      output = i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// our own header in front of the driver blob, the driver version is not part of the Vulkan cache header
+struct VkPipelineCacheFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t vendorID;
+  uint32_t deviceID;
+  uint32_t driverVersion;
+  uint32_t checksum;
+  uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+  uint64_t dataSize;
+};
+
+const uint32_t kVkPipelineCacheFileMagic = 0x50534b56; // "VKSP"
+const uint32_t kVkPipelineCacheFileVersion = 1;
+
+// layout of VkPipelineCacheHeaderVersionOne at the start of every driver blob
+const size_t kVkPipelineCacheHeaderSize = 16 + VK_UUID_SIZE;
+
+uint32_t ComputeVkFileChecksum(const char* data, size_t size) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<uint8_t>(data[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
 
-  //making a std::string allows the comparison in .erase to work
-  std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
+bool ReadVkPipelineCacheFile(const std::string &path, const VkPhysicalDeviceProperties &properties, std::vector<char> &output) {
+  std::ifstream file(path, std::ios::ate | std::ios::binary);
 
-  for (const auto& extension : deviceAvailableExtensions) {
-    requiredExtensions.erase(extension.extensionName);
+  if (!file.is_open()) {
+    return false;
   }
 
-  return requiredExtensions.empty();
+  size_t fileSize = (size_t)file.tellg();
+  if (fileSize < sizeof(VkPipelineCacheFileHeader)) {
+    return false;
+  }
+
+  VkPipelineCacheFileHeader header;
+  file.seekg(0);
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+  if (
+    header.magic != kVkPipelineCacheFileMagic ||
+    header.version != kVkPipelineCacheFileVersion ||
+    header.vendorID != properties.vendorID ||
+    header.deviceID != properties.deviceID ||
+    header.driverVersion != properties.driverVersion ||
+    memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0 ||
+    header.dataSize != fileSize - sizeof(VkPipelineCacheFileHeader)
+    ) {
+    return false;
+  }
+
+  std::vector<char> cacheData((size_t)header.dataSize);
+  file.read(cacheData.data(), cacheData.size());
+
+  if (!file || ComputeVkFileChecksum(cacheData.data(), cacheData.size()) != header.checksum) {
+    return false;
+  }
+
+  // some drivers don't validate the blob themselves, so check the Vulkan header too
+  if (cacheData.size() < kVkPipelineCacheHeaderSize) {
+    return false;
+  }
+
+  uint32_t vkHeader[4];
+  memcpy(vkHeader, cacheData.data(), sizeof(vkHeader));
+  if (
+    vkHeader[0] < kVkPipelineCacheHeaderSize ||
+    vkHeader[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+    vkHeader[2] != properties.vendorID ||
+    vkHeader[3] != properties.deviceID ||
+    memcmp(cacheData.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0
+    ) {
+    return false;
+  }
+
+  output = std::move(cacheData);
+  return true;
+}
+
+bool ReplaceVkFile(const std::string &source, const std::string &destination) {
+#ifdef _WIN32
+  // std::rename fails on Windows when the destination exists, MoveFileEx replaces it in one step
+  return MoveFileExA(source.c_str(), destination.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+  return std::rename(source.c_str(), destination.c_str()) == 0;
+#endif
+}
+
+bool WriteVkPipelineCacheFile(const std::string &path, const VkPhysicalDeviceProperties &properties, const std::vector<char> &cacheData) {
+
+  VkPipelineCacheFileHeader header = {};
+  header.magic = kVkPipelineCacheFileMagic;
+  header.version = kVkPipelineCacheFileVersion;
+  header.vendorID = properties.vendorID;
+  header.deviceID = properties.deviceID;
+  header.driverVersion = properties.driverVersion;
+  header.checksum = ComputeVkFileChecksum(cacheData.data(), cacheData.size());
+  memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+  header.dataSize = cacheData.size();
+
+  // write next to the target and swap it in, so a crash mid-write never leaves a truncated cache behind
+  std::string temporaryPath = path + ".tmp";
+  {
+    std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(cacheData.data(), cacheData.size());
+
+    if (!file) {
+      return false;
+    }
+  }
+
+  return ReplaceVkFile(temporaryPath, path);
+}
+
+VkResult createVkShaderModule(const VkDevice &device, const std::vector<char>& code, const VkAllocationCallbacks* pAllocator, VkShaderModule &output) {
+  return createVkShaderModule(device, reinterpret_cast<const uint32_t*>(code.data()), code.size(), pAllocator, output);
 }
 
-VkResult createVkShaderModule(const VkDevice &device, const std::vector<char>& code, VkShaderModule &output) {
+VkResult createVkShaderModule(const VkDevice &device, const uint32_t* code, size_t codeSize, const VkAllocationCallbacks* pAllocator, VkShaderModule &output) {
 
   VkShaderModuleCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  createInfo.codeSize = code.size();
-  createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+  createInfo.codeSize = codeSize;
+  createInfo.pCode = code;
 
-  return vkCreateShaderModule(device, &createInfo, nullptr, &output);
+  return vkCreateShaderModule(device, &createInfo, pAllocator, &output);
 }
 
 } // namespace vks
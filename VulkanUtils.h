@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include <vector>
 
 #include <vulkan\vulkan.hpp>
@@ -7,9 +8,6 @@
 namespace vks {
 
 std::vector<VkExtensionProperties> GetVkExtensions();
-const VkExtensionProperties* FindVkExtension(std::vector<VkExtensionProperties> &availableVKExtensions, const char* neededExtension);
-
-bool CheckVkValidationLayerSupport(const std::vector<const char*> &requestedLayers);
 
 VkResult CreateVkDebugReportCallbackEXT(
   VkInstance instance,
@@ -21,8 +19,21 @@ void DestroyVkDebugReportCallbackEXT(VkInstance instance, VkDebugReportCallbackE
 
 std::vector<VkQueueFamilyProperties> GetVkFamiliesOfDevice(const VkPhysicalDevice &device);
 
-bool CheckVkExtensionSupport(const VkPhysicalDevice &device, const std::vector<const char*> &extensions);
+bool FindVkMemoryType(const VkPhysicalDevice &device, uint32_t typeBits, VkMemoryPropertyFlags properties, uint32_t &output);
+
+// FNV-1a, only meant to catch truncated or damaged files
+uint32_t ComputeVkFileChecksum(const char* data, size_t size);
+
+// Moves source over destination in one step, a crash never leaves destination missing or half written.
+bool ReplaceVkFile(const std::string &source, const std::string &destination);
+
+// Reads a pipeline cache blob written by WriteVkPipelineCacheFile. Returns false if the file is missing,
+// corrupt or was written for a different device or driver, in which case the cache should start empty.
+bool ReadVkPipelineCacheFile(const std::string &path, const VkPhysicalDeviceProperties &properties, std::vector<char> &output);
+bool WriteVkPipelineCacheFile(const std::string &path, const VkPhysicalDeviceProperties &properties, const std::vector<char> &cacheData);
 
-VkResult createVkShaderModule(const VkDevice &device, const std::vector<char>& code, VkShaderModule &output);
+VkResult createVkShaderModule(const VkDevice &device, const std::vector<char>& code, const VkAllocationCallbacks* pAllocator, VkShaderModule &output);
+// code has to be 4 byte aligned, codeSize is in bytes
+VkResult createVkShaderModule(const VkDevice &device, const uint32_t* code, size_t codeSize, const VkAllocationCallbacks* pAllocator, VkShaderModule &output);
 
 }
@@ -0,0 +1,101 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+namespace vks {
+
+WorkerPool::~WorkerPool() {
+  Stop();
+}
+
+void WorkerPool::Start(uint32_t threadCount) {
+
+  if (threadCount == 0) {
+    threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+
+  for (uint32_t i = 1; i < threadCount; ++i) {
+    threads_.emplace_back(&WorkerPool::workerLoop, this, i);
+  }
+}
+
+void WorkerPool::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wakeCondition_.notify_all();
+
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+
+  stopping_ = false;
+}
+
+void WorkerPool::ParallelFor(uint32_t itemCount, const std::function<void(uint32_t, uint32_t)> &func) {
+
+  if (itemCount == 0) {
+    return;
+  }
+
+  // not worth waking anyone up for a single item
+  if (itemCount == 1 || threads_.empty()) {
+    for (uint32_t i = 0; i < itemCount; ++i) {
+      func(i, 0);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobFunc_ = &func;
+    jobItemCount_ = itemCount;
+    nextItem_ = 0;
+    activeWorkers_ = static_cast<uint32_t>(threads_.size());
+    jobGeneration_++;
+  }
+  wakeCondition_.notify_all();
+
+  runItems(0);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  doneCondition_.wait(lock, [&]() { return activeWorkers_ == 0; });
+  jobFunc_ = nullptr;
+}
+
+void WorkerPool::workerLoop(uint32_t workerIndex) {
+
+  uint64_t seenGeneration = 0;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wakeCondition_.wait(lock, [&]() { return stopping_ || jobGeneration_ != seenGeneration; });
+
+      if (stopping_) {
+        return;
+      }
+
+      seenGeneration = jobGeneration_;
+    }
+
+    runItems(workerIndex);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      activeWorkers_--;
+    }
+    doneCondition_.notify_one();
+  }
+}
+
+void WorkerPool::runItems(uint32_t workerIndex) {
+  uint32_t item;
+  while ((item = nextItem_.fetch_add(1)) < jobItemCount_) {
+    (*jobFunc_)(item, workerIndex);
+  }
+}
+
+}
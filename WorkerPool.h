@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vks {
+
+// Long lived worker threads for per frame jobs, so we don't pay thread creation every frame.
+// The calling thread takes part in every job as worker 0.
+class WorkerPool {
+  public:
+    ~WorkerPool();
+
+    // threadCount includes the calling thread, 0 means one per hardware thread
+    void Start(uint32_t threadCount);
+    void Stop();
+
+    uint32_t ThreadCount() const { return static_cast<uint32_t>(threads_.size()) + 1; }
+
+    // calls func(itemIndex, workerIndex) for every itemIndex in [0, itemCount) and returns when all are done.
+    // workerIndex is in [0, ThreadCount()) and unique among concurrently running calls.
+    void ParallelFor(uint32_t itemCount, const std::function<void(uint32_t, uint32_t)> &func);
+
+  private:
+    void workerLoop(uint32_t workerIndex);
+    void runItems(uint32_t workerIndex);
+
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    std::condition_variable wakeCondition_;
+    std::condition_variable doneCondition_;
+    bool stopping_ = false;
+    uint64_t jobGeneration_ = 0;
+    uint32_t activeWorkers_ = 0;
+
+    const std::function<void(uint32_t, uint32_t)>* jobFunc_ = nullptr;
+    uint32_t jobItemCount_ = 0;
+    std::atomic<uint32_t> nextItem_{ 0 };
+};
+
+}
@@ -1,14 +1,230 @@
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <string>
 #include <vector>
 
+#include "FrustumCulling.h"
+#include "Scene.h"
+#include "VulkanRenderGraph.h"
+#include "VulkanMemoryAllocator.h"
 #include "VulkanSquirrel.h"
 
-int main() {
+#ifdef VKS_WITH_SQUIRREL
+#include "SquirrelDrawList.h"
+#endif
+
+namespace {
+
+// unlike std::stoul, bad input is reported instead of thrown, and signs, trailing characters and values that don't
+// fit into T are rejected
+template<typename T>
+bool parseCount(const char* text, T &value) {
+  if (!isdigit(static_cast<unsigned char>(text[0]))) {
+    return false;
+  }
+
+  errno = 0;
+  char* end = nullptr;
+  const unsigned long long parsed = strtoull(text, &end, 10);
+  if (errno != 0 || *end != '\0' || parsed > std::numeric_limits<T>::max()) {
+    return false;
+  }
+
+  value = static_cast<T>(parsed);
+  return true;
+}
+
+// the same for a positive, finite rate like 59.94
+bool parseRate(const char* text, double &value) {
+  if (!isdigit(static_cast<unsigned char>(text[0])) && text[0] != '.') {
+    return false;
+  }
+
+  errno = 0;
+  char* end = nullptr;
+  const double parsed = strtod(text, &end);
+  if (errno != 0 || *end != '\0' || !std::isfinite(parsed) || parsed <= 0.0) {
+    return false;
+  }
+
+  value = parsed;
+  return true;
+}
+
+}
+
+int main(int argc, char** argv) {
   vks::VulkanSquirrel app;
 
   struct vks::VulkanSquirrelOptions options;
   options.windowWidth = 800;
   options.windowHeight = 600;
+  options.frameSubmissionMode = vks::kFramesInFlightSubmission;
+  options.framesInFlight = 2;
+  options.presentationMode = vks::kWindowedPresentation;
+  options.headlessFrameCount = 1000;
+  options.pipelineCachePath = "./pipeline_cache.bin";
+  options.capabilityCachePath = "./vulkan_capabilities.bin";
+  options.assetPackPath = "./Assets.pack";
+  options.recordingThreadCount = 0;
+  options.frameProfiling = false;
+  options.frameProfilerHistory = 256;
+
+  // --headless [frameCount] renders offscreen without a window, e.g. on CI or render farm nodes
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--headless") == 0) {
+      options.presentationMode = vks::kHeadlessPresentation;
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        if (!parseCount(argv[++i], options.headlessFrameCount)) {
+          std::cerr << "Invalid frame count " << argv[i] << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+    }
+    // --profile [tracePath] prints frame timings at exit and optionally dumps a Chrome trace
+    else if (strcmp(argv[i], "--profile") == 0) {
+      options.frameProfiling = true;
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        options.frameProfilerTracePath = argv[++i];
+      }
+    }
+    // --present-policy low-latency|power-saving picks the swap chain's present mode, low-latency is the default
+    else if (strcmp(argv[i], "--present-policy") == 0 && i + 1 < argc) {
+      const char* policy = argv[++i];
+      if (strcmp(policy, "power-saving") == 0) {
+        options.presentPolicy = vks::kPowerSavingPresentPolicy;
+      }
+      else if (strcmp(policy, "low-latency") == 0) {
+        options.presentPolicy = vks::kLowLatencyPresentPolicy;
+      }
+      else {
+        std::cerr << "Unknown present policy " << policy << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+    // --fps-limit [framesPerSecond] caps the frame rate with the CPU side limiter, 60 by default
+    else if (strcmp(argv[i], "--fps-limit") == 0) {
+      options.presentPolicy = vks::kCappedFrameRatePresentPolicy;
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        if (!parseRate(argv[++i], options.targetFrameRate)) {
+          std::cerr << "Invalid frame rate " << argv[i] << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+    }
+    // --track-host-memory accounts the driver's host allocations per scope and prints them at startup and exit
+    else if (strcmp(argv[i], "--track-host-memory") == 0) {
+      options.hostAllocationTracking = true;
+    }
+    // --log-level debug|info|warning|error drops engine messages below the given severity, info is the default
+    else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+      const char* level = argv[++i];
+      if (strcmp(level, "debug") == 0) {
+        options.logSeverity = vks::kDebugLogSeverity;
+      }
+      else if (strcmp(level, "info") == 0) {
+        options.logSeverity = vks::kInfoLogSeverity;
+      }
+      else if (strcmp(level, "warning") == 0) {
+        options.logSeverity = vks::kWarningLogSeverity;
+      }
+      else if (strcmp(level, "error") == 0) {
+        options.logSeverity = vks::kErrorLogSeverity;
+      }
+      else {
+        std::cerr << "Unknown log level " << level << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+    // --stress-scene [objectCount] adds a GPU culled scene of quads drawn with a single indirect draw
+    else if (strcmp(argv[i], "--stress-scene") == 0) {
+      options.stressSceneObjectCount = 100000;
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        if (!parseCount(argv[++i], options.stressSceneObjectCount)) {
+          std::cerr << "Invalid object count " << argv[i] << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+    }
+    // --no-async-compute keeps the stress scene's culling on the graphics queue, for comparing against async compute
+    else if (strcmp(argv[i], "--no-async-compute") == 0) {
+      options.asyncCompute = false;
+    }
+    // --scene-entities [count] fills the scene store with moving triangles that replace the default triangle
+    else if (strcmp(argv[i], "--scene-entities") == 0) {
+      options.sceneEntityCount = 100000;
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        if (!parseCount(argv[++i], options.sceneEntityCount)) {
+          std::cerr << "Invalid entity count " << argv[i] << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+    }
+    // --startup-trace path dumps how long each init task took as a Chrome trace
+    else if (strcmp(argv[i], "--startup-trace") == 0 && i + 1 < argc) {
+      options.startupTracePath = argv[++i];
+    }
+    // --cull-benchmark [objectCount] times the scalar and SIMD frustum culling paths, checks they agree and exits
+    else if (strcmp(argv[i], "--cull-benchmark") == 0) {
+      uint32_t objectCount = 0;
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        if (!parseCount(argv[++i], objectCount)) {
+          std::cerr << "Invalid object count " << argv[i] << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+      return vks::RunFrustumCullingBenchmark(objectCount, 20) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    // --allocator-benchmark [operationCount] times random allocations and frees in the device memory sub-allocator and exits
+    else if (strcmp(argv[i], "--allocator-benchmark") == 0) {
+      uint32_t operationCount = 10000000;
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        if (!parseCount(argv[++i], operationCount)) {
+          std::cerr << "Invalid operation count " << argv[i] << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+      return vks::RunBuddyAllocatorBenchmark(operationCount) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    // --scene-benchmark [entityCount] times the scene systems single and multi threaded and exits
+    else if (strcmp(argv[i], "--scene-benchmark") == 0) {
+      uint32_t entityCount = 100000;
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        if (!parseCount(argv[++i], entityCount)) {
+          std::cerr << "Invalid entity count " << argv[i] << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+      return vks::RunSceneBenchmark(entityCount, 100) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    // --render-graph-check verifies the barriers the render graph derives for a few small graphs and exits
+    else if (strcmp(argv[i], "--render-graph-check") == 0) {
+      return vks::RunRenderGraphBarrierCheck() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+#ifdef VKS_WITH_SQUIRREL
+    // --script-benchmark [objectCount] compares per object script calls against the batched draw list and exits
+    else if (strcmp(argv[i], "--script-benchmark") == 0) {
+      uint32_t objectCount = 10000;
+      if (i + 1 < argc && argv[i + 1][0] != '-') {
+        if (!parseCount(argv[++i], objectCount)) {
+          std::cerr << "Invalid object count " << argv[i] << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+      return vks::RunSquirrelDrawListBenchmark(objectCount, 100) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+#else
+    else if (strcmp(argv[i], "--script-benchmark") == 0) {
+      std::cerr << "--script-benchmark needs a build with VKS_WITH_SQUIRREL, see README.md" << std::endl;
+      return EXIT_FAILURE;
+    }
+#endif
+  }
 
 #ifdef NODEBUG
   options.vulkanValidationLayersMode = vks::kNoVulkanValidationLayers;
@@ -20,9 +236,11 @@ int main() {
     "VK_LAYER_LUNARG_standard_validation"
   };
 
-  options.vulkanExtensions = {
-    VK_KHR_SWAPCHAIN_EXTENSION_NAME
-  };
+  if (options.presentationMode == vks::kWindowedPresentation) {
+    options.vulkanExtensions = {
+      VK_KHR_SWAPCHAIN_EXTENSION_NAME
+    };
+  }
 
   try {
     app.Run(options);